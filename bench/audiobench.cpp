@@ -0,0 +1,127 @@
+//audio microbenchmark
+//
+//fills sfx memory with notes covering every builtin waveform and effect,
+//starts a four channel song and times Audio::FillAudioBuffer in host sized
+//chunks. reports the time taken per second of audio per case.
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "Audio.h"
+#include "PicoRam.h"
+#include "audiobench.h"
+
+using namespace std;
+
+static const int AudioSampleRate = 22050;
+//a typical host callback size
+static const int ChunkSamples = 1024;
+
+struct AudioBenchCase {
+    const char* name;
+    //builtin waveform for every note, -1 cycles through all of them
+    int waveform;
+    //effect for every note, -1 cycles through all of them
+    int effect;
+    bool custom;
+};
+
+struct AudioBenchResult {
+    string name;
+    double msPerSecond = 0;
+    double realtime = 0;
+};
+
+static void fillSfx(PicoRam& ram, const AudioBenchCase& c) {
+    for (int s = 0; s < 64; s++) {
+        struct sfx& sfx = ram.sfx[s];
+        sfx.speed = 8 + (s % 4) * 4;
+        sfx.loopRangeStart = 0;
+        sfx.loopRangeEnd = 0;
+
+        for (int n = 0; n < 32; n++) {
+            note x;
+            x.setKey((uint8_t)(24 + (s * 7 + n * 5) % 36));
+            x.setVolume((uint8_t)(3 + n % 5));
+            x.setWaveform((uint8_t)(c.waveform < 0 ? (s + n) % 8 : c.waveform));
+            x.setEffect((uint8_t)(c.effect < 0 ? (s + n) % 8 : c.effect));
+            //custom instruments play sfx 0-7, keep those plain
+            x.setCustom(c.custom && s >= 8 && n % 2 == 0);
+            sfx.notes[n] = x;
+        }
+    }
+
+    //looping song over patterns 0-3 on all four channels
+    for (int p = 0; p < 64; p++) {
+        for (int ch = 0; ch < 4; ch++) {
+            ram.songs[p].data[ch] = (uint8_t)(8 + (p * 4 + ch) % 56);
+        }
+    }
+    ram.songs[0].data[2] |= 0x80;
+    ram.songs[3].data[1] |= 0x80;
+}
+
+static AudioBenchResult runCase(const AudioBenchCase& c, int seconds) {
+    PicoRam* ram = new PicoRam();
+    ram->Reset();
+    fillSfx(*ram, c);
+
+    Audio* audio = new Audio(ram);
+    audio->api_music(0, 0, 0xf);
+
+    vector<uint32_t> buffer(ChunkSamples);
+    int total = seconds * AudioSampleRate;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int done = 0; done < total; done += ChunkSamples) {
+        audio->FillAudioBuffer(buffer.data(), 0, ChunkSamples);
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    delete audio;
+    delete ram;
+
+    AudioBenchResult r;
+    r.name = c.name;
+    r.msPerSecond = ms / seconds;
+    r.realtime = r.msPerSecond > 0 ? 1000.0 / r.msPerSecond : 0;
+    return r;
+}
+
+int runAudioBench(int seconds, bool json) {
+    const AudioBenchCase cases[] = {
+        { "square", 3, 0, false },
+        { "waveforms", -1, 0, false },
+        { "effects", 2, -1, false },
+        { "mixed", -1, -1, false },
+        { "custom instruments", -1, -1, true },
+    };
+
+    vector<AudioBenchResult> results;
+    for (const AudioBenchCase& c : cases) {
+        results.push_back(runCase(c, seconds));
+    }
+
+    if (json) {
+        printf("[\n");
+        for (size_t i = 0; i < results.size(); i++) {
+            const AudioBenchResult& r = results[i];
+            printf("  {\"case\": \"%s\", \"seconds\": %d, \"ms_per_second\": %.4f, \"realtime\": %.1f}%s\n",
+                r.name.c_str(), seconds, r.msPerSecond, r.realtime, i + 1 < results.size() ? "," : "");
+        }
+        printf("]\n");
+        return 0;
+    }
+
+    printf("audio: %d seconds of 22050hz audio per case\n", seconds);
+    for (const AudioBenchResult& r : results) {
+        printf("  %-20s %8.3f ms per audio second  (%.0fx realtime)\n",
+            r.name.c_str(), r.msPerSecond, r.realtime);
+    }
+
+    return 0;
+}
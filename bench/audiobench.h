@@ -0,0 +1,5 @@
+#pragma once
+
+//audio microbenchmark: renders synthetic sfx and music through
+//Audio::FillAudioBuffer with no cart or vm involved
+int runAudioBench(int seconds, bool json);
@@ -0,0 +1,464 @@
+//headless frame benchmark runner
+//
+//loads each cart given on the command line through Vm::LoadCart, runs
+//Vm::UpdateAndDraw as fast as possible with the stub host (no frame pacing),
+//renders one frame worth of audio after each frame, and reports frame time
+//percentiles plus a lua / graphics / audio split.
+//
+//usage: fake08-bench [--frames N] [--warmup N] [--input trace.txt] [--cycle-cpu] [--json] cart.p8 [cart2.p8.png ...]
+//       fake08-bench --audio [--seconds N] [--json]
+//       fake08-bench --charset [--repeats N] [--json] [cart.p8 ...]
+//       fake08-bench --gfx [--frames N] [--json]
+//
+//--audio runs the audio microbenchmark (audiobench.cpp) instead of carts.
+//--charset runs the utf-8 conversion microbenchmark (charsetbench.cpp) over
+//the given text carts, or a generated one.
+//--gfx runs the sprite/map/fill microbenchmark (gfxbench.cpp), comparing
+//against the previous per pixel code.
+//carts/ has carts that each lean on one part of the api, e.g. carts/entities.p8
+//runs the table helpers (add/del/all/foreach/count) over 1000 entities a frame,
+//and carts/entities_lua.p8 runs the same loop with the bios lua versions defined
+//in the cart. build with NATIVE_TABLE_HELPERS=1 to time the C versions.
+//--cycle-cpu switches stat(1)/stat(2) to the deterministic lua instruction count
+//estimate, which makes the reported cpu numbers comparable across machines.
+//
+//input trace format: one "<frame> <buttons>" pair per line, '#' starts a comment.
+//buttons is the held button mask for player 1 (decimal or 0x hex, bit 0 = left ...
+//bit 5 = x, bit 6 = pause) and stays held until the next entry.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include "vm.h"
+#include "filehelpers.h"
+#include "profiler.h"
+#include "stubhost.h"
+#include "audiobench.h"
+#include "charsetbench.h"
+#include "gfxbench.h"
+
+using namespace std;
+
+static const int AudioSampleRate = 22050;
+
+struct InputEvent {
+    int frame;
+    uint8_t held;
+};
+
+struct BenchOptions {
+    int frames = 600;
+    int warmup = 30;
+    bool json = false;
+    bool cycleCpu = false;
+    bool audio = false;
+    int audioSeconds = 20;
+    bool charset = false;
+    int charsetRepeats = 200;
+    bool gfx = false;
+    string inputTrace;
+    vector<string> carts;
+};
+
+struct BenchResult {
+    string cart;
+    string error;
+    bool flipLoop = false;
+    int targetFps = 0;
+    int frames = 0;
+    double totalMs = 0;
+    double luaMs = 0;
+    double gfxMs = 0;
+    double audioMs = 0;
+    double meanMs = 0;
+    double p50Ms = 0;
+    double p90Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+    double fps = 0;
+    double cpuMean = 0;
+    double cpuMax = 0;
+};
+
+static double nanosToMs(uint64_t nanos) {
+    return nanos / 1000000.0;
+}
+
+static uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+static double percentile(const vector<uint64_t>& sorted, double pct) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t idx = (size_t)(pct / 100.0 * (sorted.size() - 1) + 0.5);
+    return nanosToMs(sorted[std::min(idx, sorted.size() - 1)]);
+}
+
+static bool loadInputTrace(string filename, vector<InputEvent>& events) {
+    std::ifstream file(filename);
+    if (!file.good()) {
+        return false;
+    }
+
+    string line;
+    while (std::getline(file, line)) {
+        size_t comment = line.find('#');
+        if (comment != string::npos) {
+            line = line.substr(0, comment);
+        }
+
+        std::istringstream s(line);
+        string frameStr, buttonStr;
+        if (!(s >> frameStr >> buttonStr)) {
+            continue;
+        }
+
+        InputEvent ev;
+        ev.frame = (int)strtol(frameStr.c_str(), nullptr, 0);
+        ev.held = (uint8_t)strtol(buttonStr.c_str(), nullptr, 0);
+        events.push_back(ev);
+    }
+
+    std::stable_sort(events.begin(), events.end(),
+        [](const InputEvent& a, const InputEvent& b) { return a.frame < b.frame; });
+
+    return true;
+}
+
+//applies the trace entries for this frame and returns the held mask
+static uint8_t heldForFrame(const vector<InputEvent>& events, size_t& nextEvent, int frame, uint8_t held) {
+    while (nextEvent < events.size() && events[nextEvent].frame <= frame) {
+        held = events[nextEvent].held;
+        nextEvent++;
+    }
+
+    return held;
+}
+
+static string absoluteCartPath(string path) {
+    if (isAbsolutePath(path)) {
+        return path;
+    }
+
+    char cwd[4096];
+    if (getcwd(cwd, sizeof(cwd)) == nullptr) {
+        return path;
+    }
+
+    return string(cwd) + "/" + path;
+}
+
+static BenchResult runCart(StubHost* host, string cartPath, const BenchOptions& options, const vector<InputEvent>& events) {
+    BenchResult result;
+    result.cart = cartPath;
+
+    Vm* vm = new Vm(host);
+    vm->setCpuCycleEstimate(options.cycleCpu);
+    vector<uint32_t> audioBuffer(AudioSampleRate / 30);
+
+    host->stubInput(0, 0);
+    //carts that never return from flip() would otherwise spin forever inside LoadCart
+    host->stubQuitAfterFrames(options.warmup + options.frames);
+
+    Profile_Reset();
+    auto loadStart = std::chrono::steady_clock::now();
+    vm->LoadCart(absoluteCartPath(cartPath), false);
+    uint64_t loadNanos = nanosSince(loadStart);
+
+    int flipFrames = host->stubDrawnFrames();
+    host->stubQuitAfterFrames(0);
+
+    if (flipFrames > 0) {
+        //the whole run happened inside the cart's own flip loop, so only
+        //an aggregate number is available
+        result.flipLoop = true;
+        result.targetFps = vm->GetTargetFps();
+        result.frames = flipFrames;
+        result.totalMs = nanosToMs(loadNanos);
+        result.gfxMs = nanosToMs(Profile_Nanos(PROFILE_GFX));
+        result.luaMs = result.totalMs - result.gfxMs;
+        result.meanMs = result.totalMs / flipFrames;
+        result.fps = flipFrames / (result.totalMs / 1000.0);
+        delete vm;
+        return result;
+    }
+
+    if (vm->GetBiosError() != "") {
+        result.error = vm->GetBiosError();
+        delete vm;
+        return result;
+    }
+
+    result.targetFps = vm->GetTargetFps();
+    size_t samplesPerFrame = AudioSampleRate / result.targetFps;
+    audioBuffer.resize(samplesPerFrame);
+
+    vector<uint64_t> frameNanos;
+    frameNanos.reserve(options.frames);
+    uint64_t luaNanos = 0;
+    uint64_t gfxNanos = 0;
+    uint64_t audioNanos = 0;
+    double cpuTotal = 0;
+
+    size_t nextEvent = 0;
+    uint8_t held = 0;
+    int totalFrames = options.warmup + options.frames;
+
+    for (int frame = 0; frame < totalFrames; frame++) {
+        uint8_t prevHeld = held;
+        held = heldForFrame(events, nextEvent, frame, held);
+        host->stubInput(held & ~prevHeld, held);
+
+        uint64_t gfxBefore = Profile_Nanos(PROFILE_GFX);
+
+        auto frameStart = std::chrono::steady_clock::now();
+        vm->UpdateAndDraw();
+        uint64_t updateNanos = nanosSince(frameStart);
+
+        auto audioStart = std::chrono::steady_clock::now();
+        vm->FillAudioBuffer(audioBuffer.data(), 0, samplesPerFrame);
+        uint64_t frameAudioNanos = nanosSince(audioStart);
+
+        if (vm->GetBiosError() != "") {
+            result.error = vm->GetBiosError();
+            break;
+        }
+
+        if (frame < options.warmup) {
+            continue;
+        }
+
+        uint64_t frameGfxNanos = Profile_Nanos(PROFILE_GFX) - gfxBefore;
+
+        frameNanos.push_back(updateNanos + frameAudioNanos);
+        gfxNanos += frameGfxNanos;
+        luaNanos += updateNanos - std::min(updateNanos, frameGfxNanos);
+        audioNanos += frameAudioNanos;
+
+        //what the cart saw from stat(1) at the end of the frame
+        double cpu = vm->getPrevFrameCpuUsage();
+        cpuTotal += cpu;
+        result.cpuMax = std::max(result.cpuMax, cpu);
+    }
+
+    delete vm;
+
+    result.frames = (int)frameNanos.size();
+    if (result.frames == 0) {
+        return result;
+    }
+
+    uint64_t totalNanos = 0;
+    for (auto n : frameNanos) {
+        totalNanos += n;
+    }
+
+    std::sort(frameNanos.begin(), frameNanos.end());
+
+    result.totalMs = nanosToMs(totalNanos);
+    result.luaMs = nanosToMs(luaNanos);
+    result.gfxMs = nanosToMs(gfxNanos);
+    result.audioMs = nanosToMs(audioNanos);
+    result.meanMs = result.totalMs / result.frames;
+    result.p50Ms = percentile(frameNanos, 50);
+    result.p90Ms = percentile(frameNanos, 90);
+    result.p99Ms = percentile(frameNanos, 99);
+    result.maxMs = nanosToMs(frameNanos.back());
+    result.fps = result.frames / (result.totalMs / 1000.0);
+    result.cpuMean = cpuTotal / result.frames;
+
+    return result;
+}
+
+static string jsonEscape(const string& str) {
+    string out;
+    for (char c : str) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                }
+                else {
+                    out += c;
+                }
+        }
+    }
+
+    return out;
+}
+
+static void printJson(const vector<BenchResult>& results) {
+    printf("[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        printf("  {\"cart\": \"%s\", \"error\": \"%s\", \"flip_loop\": %s, \"target_fps\": %d, \"frames\": %d,\n",
+            jsonEscape(r.cart).c_str(), jsonEscape(r.error).c_str(), r.flipLoop ? "true" : "false", r.targetFps, r.frames);
+        printf("   \"total_ms\": %.3f, \"lua_ms\": %.3f, \"gfx_ms\": %.3f, \"audio_ms\": %.3f,\n",
+            r.totalMs, r.luaMs, r.gfxMs, r.audioMs);
+        printf("   \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p90_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"fps\": %.1f,\n",
+            r.meanMs, r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs, r.fps);
+        printf("   \"cpu_mean\": %.4f, \"cpu_max\": %.4f}%s\n",
+            r.cpuMean, r.cpuMax, i + 1 < results.size() ? "," : "");
+    }
+    printf("]\n");
+}
+
+static void printText(const vector<BenchResult>& results) {
+    for (const BenchResult& r : results) {
+        printf("%s\n", r.cart.c_str());
+        if (r.error != "") {
+            printf("  error: %s\n", r.error.c_str());
+        }
+        if (r.frames == 0) {
+            continue;
+        }
+        if (r.flipLoop) {
+            printf("  flip() loop cart, aggregate only\n");
+        }
+        printf("  %d frames @ %d fps target, %.1f frames/sec\n", r.frames, r.targetFps, r.fps);
+        printf("  frame ms: mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+            r.meanMs, r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs);
+        double total = r.totalMs > 0 ? r.totalMs : 1;
+        printf("  split: lua %.1f%%  gfx %.1f%%  audio %.1f%%\n",
+            100.0 * r.luaMs / total, 100.0 * r.gfxMs / total, 100.0 * r.audioMs / total);
+        if (!r.flipLoop) {
+            printf("  stat(1) cpu: mean %.3f  max %.3f\n", r.cpuMean, r.cpuMax);
+        }
+    }
+}
+
+static void printUsage() {
+    fprintf(stderr,
+        "usage: fake08-bench [--frames N] [--warmup N] [--input trace.txt] [--cycle-cpu] [--json] cart [cart ...]\n"
+        "       fake08-bench --audio [--seconds N] [--json]\n"
+        "       fake08-bench --charset [--repeats N] [--json] [cart.p8 ...]\n"
+        "       fake08-bench --gfx [--frames N] [--json]\n");
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--frames" && hasValue) {
+            options.frames = atoi(argv[++i]);
+        }
+        else if (arg == "--warmup" && hasValue) {
+            options.warmup = atoi(argv[++i]);
+        }
+        else if (arg == "--input" && hasValue) {
+            options.inputTrace = argv[++i];
+        }
+        else if (arg == "--cycle-cpu") {
+            options.cycleCpu = true;
+        }
+        else if (arg == "--audio") {
+            options.audio = true;
+        }
+        else if (arg == "--seconds" && hasValue) {
+            options.audioSeconds = atoi(argv[++i]);
+        }
+        else if (arg == "--charset") {
+            options.charset = true;
+        }
+        else if (arg == "--gfx") {
+            options.gfx = true;
+        }
+        else if (arg == "--repeats" && hasValue) {
+            options.charsetRepeats = atoi(argv[++i]);
+        }
+        else if (arg == "--json") {
+            options.json = true;
+        }
+        else if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        }
+        else if (arg[0] == '-') {
+            printUsage();
+            return 1;
+        }
+        else {
+            options.carts.push_back(arg);
+        }
+    }
+
+    if (options.audio) {
+        if (options.audioSeconds <= 0) {
+            printUsage();
+            return 1;
+        }
+        return runAudioBench(options.audioSeconds, options.json);
+    }
+
+    if (options.charset) {
+        if (options.charsetRepeats <= 0) {
+            printUsage();
+            return 1;
+        }
+        return runCharsetBench(options.carts, options.charsetRepeats, options.json);
+    }
+
+    if (options.gfx) {
+        if (options.frames <= 0) {
+            printUsage();
+            return 1;
+        }
+        return runGfxBench(options.frames, options.json);
+    }
+
+    if (options.carts.empty() || options.frames <= 0 || options.warmup < 0) {
+        printUsage();
+        return 1;
+    }
+
+    vector<InputEvent> events;
+    if (options.inputTrace != "" && !loadInputTrace(options.inputTrace, events)) {
+        fprintf(stderr, "unable to read input trace %s\n", options.inputTrace.c_str());
+        return 1;
+    }
+
+    StubHost* host = new StubHost();
+    vector<BenchResult> results;
+
+    for (auto cart : options.carts) {
+        results.push_back(runCart(host, cart, options, events));
+    }
+
+    delete host;
+
+    if (options.json) {
+        printJson(results);
+    }
+    else {
+        printText(results);
+    }
+
+    bool anyErrors = false;
+    for (const BenchResult& r : results) {
+        anyErrors |= r.error != "";
+    }
+
+    return anyErrors ? 2 : 0;
+}
@@ -0,0 +1,122 @@
+//charset microbenchmark
+//
+//converts whole text carts from utf-8 to pico-8 characters the way
+//Cart::loadCartFromString does (line by line) and all at once, and reports
+//throughput in MB/s for each.
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <chrono>
+
+#include "emojiconversion.h"
+#include "filehelpers.h"
+#include "charsetbench.h"
+
+using namespace std;
+
+struct CharsetBenchResult {
+    string name;
+    size_t bytes = 0;
+    double lineMbPerSecond = 0;
+    double wholeMbPerSecond = 0;
+};
+
+//a 64k cart that is mostly plain lua with button glyphs and emoji in it
+static string generatedCart() {
+    string cart = "pico-8 cartridge // http://www.pico-8.com\nversion 41\n__lua__\n";
+    const char* lines[] = {
+        "function _update()\n",
+        "  if btn(⬅️) then x-=1 end\n",
+        "  if btn(➡️) then x+=1 end\n",
+        "  if btnp(\U0001f17e️) then sfx(0) end -- jump\n",
+        "  print(\"♥ lives: \"..lives, 2, 2, 8)\n",
+        "  ?\"あいうえお ★◆→\", 10, 10\n",
+        "end\n",
+    };
+
+    size_t i = 0;
+    while (cart.length() < 65536) {
+        cart += lines[i++ % (sizeof(lines) / sizeof(lines[0]))];
+    }
+    return cart;
+}
+
+static double mbPerSecond(size_t bytes, int repeats, double seconds) {
+    return seconds > 0 ? (double)bytes * repeats / (1024.0 * 1024.0) / seconds : 0;
+}
+
+static CharsetBenchResult runCase(const string& name, const string& text, int repeats) {
+    CharsetBenchResult r;
+    r.name = name;
+    r.bytes = text.length();
+
+    vector<string> lines;
+    std::istringstream s(text);
+    string line;
+    while (std::getline(s, line)) {
+        lines.push_back(line);
+    }
+
+    //keeps the conversions from being optimized away
+    size_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) {
+        for (const string& l : lines) {
+            sink += charset::utf8_to_pico8(l).length();
+        }
+    }
+    double lineSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) {
+        sink += charset::utf8_to_pico8(text).length();
+    }
+    double wholeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    r.lineMbPerSecond = mbPerSecond(r.bytes, repeats, lineSeconds);
+    r.wholeMbPerSecond = mbPerSecond(r.bytes, repeats, wholeSeconds);
+    if (sink == 0) {
+        r.lineMbPerSecond = 0;
+    }
+
+    return r;
+}
+
+int runCharsetBench(const vector<string>& carts, int repeats, bool json) {
+    vector<CharsetBenchResult> results;
+
+    if (carts.empty()) {
+        results.push_back(runCase("generated", generatedCart(), repeats));
+    }
+    for (const string& cart : carts) {
+        string text = get_file_contents(cart);
+        if (text.length() == 0) {
+            fprintf(stderr, "unable to read %s\n", cart.c_str());
+            return 1;
+        }
+        results.push_back(runCase(cart, text, repeats));
+    }
+
+    if (json) {
+        printf("[\n");
+        for (size_t i = 0; i < results.size(); i++) {
+            const CharsetBenchResult& r = results[i];
+            printf("  {\"cart\": \"%s\", \"bytes\": %zu, \"repeats\": %d, \"line_mb_per_second\": %.2f, \"whole_mb_per_second\": %.2f}%s\n",
+                r.name.c_str(), r.bytes, repeats, r.lineMbPerSecond, r.wholeMbPerSecond, i + 1 < results.size() ? "," : "");
+        }
+        printf("]\n");
+        return 0;
+    }
+
+    printf("charset: utf8_to_pico8, %d passes per cart\n", repeats);
+    for (const CharsetBenchResult& r : results) {
+        printf("  %-20s %7zu bytes  %8.2f MB/s by line  %8.2f MB/s whole\n",
+            r.name.c_str(), r.bytes, r.lineMbPerSecond, r.wholeMbPerSecond);
+    }
+
+    return 0;
+}
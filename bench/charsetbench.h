@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//charset microbenchmark: times charset::utf8_to_pico8 over the text of the
+//given .p8 carts, or a generated emoji heavy cart when none are given
+int runCharsetBench(const std::vector<std::string>& carts, int repeats, bool json);
@@ -0,0 +1,325 @@
+//graphics microbenchmark
+//
+//draws a frame's worth of sprites (or a full screen map) through Graphics::spr
+//and Graphics::map, then the same draws through the nibble at a time blitter
+//Graphics used before the word at a time one (kept here as legacyBlit), and
+//reports pixels per second for each plus whether both produced the same screen.
+//the fill pattern cases compare rectfill with pset for every pixel, which is
+//what rectfill did per pixel before it filled patterned rows a byte at a time.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "graphics.h"
+#include "fontdata.h"
+#include "nibblehelpers.h"
+#include "PicoRam.h"
+#include "gfxbench.h"
+
+using namespace std;
+
+//sprites drawn per frame in the spr cases
+static const int SpritesPerFrame = 256;
+
+struct GfxBenchCase {
+    const char* name;
+    //sprite size in 8x8 cells
+    int cells;
+    bool oddX;
+    bool flipX;
+    bool flipY;
+    //draws a 16x16 cell map instead of loose sprites
+    bool map;
+    //camera offset for the map, which draws 17x17 cells with clipped edges
+    int scroll;
+    //draws rectfills the size of the sprites with this fill pattern instead
+    bool fill = false;
+    uint16_t pattern = 0;
+    bool patternTransparent = false;
+};
+
+struct GfxBenchResult {
+    string name;
+    double mpxPerSecond = 0;
+    double legacyMpxPerSecond = 0;
+    bool match = false;
+};
+
+struct SprDraw {
+    int n;
+    int x;
+    int y;
+};
+
+//the blitter from before the word at a time version, minus dirty row tracking
+static void legacyBlit(
+    PicoRam* ram,
+    uint8_t* spritebuffer,
+    int scr_x,
+    int scr_y,
+    int spr_x,
+    int spr_y,
+    int spr_w,
+    int spr_h,
+    bool flip_x,
+    bool flip_y)
+{
+    int scr_w = spr_w;
+    int scr_h = spr_h;
+
+    auto &drawState = ram->drawState;
+    uint8_t *screenBuffer = ram->screenBuffer;
+
+    const uint8_t writeMask = ram->hwState.colorBitmask & 15;
+    const uint8_t readMask = ram->hwState.colorBitmask >> 4;
+
+    scr_x -= drawState.camera_x;
+    scr_y -= drawState.camera_y;
+
+    if (scr_x < drawState.clip_xb) {
+        int nclip = drawState.clip_xb - scr_x;
+        scr_x = drawState.clip_xb;
+        scr_w -= nclip;
+        if (!flip_x) {
+            spr_x += nclip;
+        } else {
+            spr_w -= nclip;
+        }
+    }
+    if (scr_x + scr_w > drawState.clip_xe) {
+        scr_w -= (scr_x + scr_w) - drawState.clip_xe;
+    }
+    if (scr_y < drawState.clip_yb) {
+        int nclip = drawState.clip_yb - scr_y;
+        scr_y = drawState.clip_yb;
+        scr_h -= nclip;
+        if (!flip_y) {
+            spr_y += nclip;
+        } else {
+            spr_h -= nclip;
+        }
+    }
+    if (scr_y + scr_h > drawState.clip_ye) {
+        scr_h -= (scr_y + scr_h) - drawState.clip_ye;
+    }
+
+    uint8_t lastScreenBuffByte = 0;
+    int lastScreenBuffIdx = -1;
+    bool startWithHalf = (spr_x & 1) != 0;
+
+    for (int y = 0; y < scr_h; y++) {
+        int x = 0;
+        while (x < scr_w) {
+            int abs_spr_x = spr_x + (flip_x ? spr_w - (x + 1) : x);
+            int abs_spr_y = spr_y + (flip_y ? spr_h - (y + 1) : y);
+            if (!IS_VALID_SPR_IDX(abs_spr_x, abs_spr_y)) {
+                ++x;
+                continue;
+            }
+            uint8_t bothPix = spritebuffer[COMBINED_IDX(abs_spr_x, abs_spr_y)];
+            uint8_t lc = bothPix & 0x0f;
+            uint8_t rc = bothPix >> 4;
+
+            const int finaly = scr_y + y;
+            int finalx = scr_x + (flip_x ? x + 1 : x);
+
+            if (x > 0 || !startWithHalf) {
+                if (!(drawState.drawPaletteMap[lc] >> 4)) {
+                    lc = drawState.drawPaletteMap[lc] & 0x0f;
+                    int screenPixelIdx = COMBINED_IDX(finalx, finaly);
+                    if (lastScreenBuffIdx != screenPixelIdx) {
+                        lastScreenBuffByte = screenBuffer[screenPixelIdx];
+                        lastScreenBuffIdx = screenPixelIdx;
+                    }
+                    uint8_t source = (finalx & 1) == 0 ? lastScreenBuffByte & 0x0f : lastScreenBuffByte >> 4;
+                    lc = (source & ~writeMask) | (lc & writeMask & readMask);
+                    setPixelNibble(finalx, finaly, lc, screenBuffer);
+                }
+                ++x;
+                if (flip_x) {
+                    --finalx;
+                }
+                else {
+                    ++finalx;
+                }
+            }
+
+            if (x < scr_w) {
+                if (!(drawState.drawPaletteMap[rc] >> 4)) {
+                    rc = drawState.drawPaletteMap[rc] & 0x0f;
+                    int screenPixelIdx = COMBINED_IDX(finalx, finaly);
+                    if (lastScreenBuffIdx != screenPixelIdx) {
+                        lastScreenBuffByte = screenBuffer[screenPixelIdx];
+                        lastScreenBuffIdx = screenPixelIdx;
+                    }
+                    uint8_t source = (finalx & 1) == 0 ? lastScreenBuffByte & 0x0f : lastScreenBuffByte >> 4;
+                    rc = (source & ~writeMask) | (rc & writeMask & readMask);
+                    setPixelNibble(finalx, finaly, rc, screenBuffer);
+                }
+                ++x;
+            }
+        }
+    }
+}
+
+static uint32_t benchRandom(uint32_t& seed) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static void drawFrame(Graphics& graphics, PicoRam& ram, const GfxBenchCase& c, const vector<SprDraw>& draws, bool legacy) {
+    if (c.map) {
+        int cells = c.scroll ? 17 : 16;
+        graphics.camera(c.scroll, c.scroll);
+        if (!legacy) {
+            graphics.map(0, 0, 0, 0, cells, cells);
+            return;
+        }
+        for (int y = 0; y < cells; y++) {
+            for (int x = 0; x < cells; x++) {
+                uint8_t cell = graphics.mget(x, y);
+                if (cell) {
+                    legacyBlit(&ram, ram.spriteSheetData, x * 8, y * 8, (cell % 16) * 8, (cell / 16) * 8, 8, 8, false, false);
+                }
+            }
+        }
+        return;
+    }
+
+    if (c.fill) {
+        int size = c.cells * 8;
+        for (const SprDraw& d : draws) {
+            uint8_t col = (uint8_t)(d.n | 0x11);
+            if (!legacy) {
+                graphics.rectfill(d.x, d.y, d.x + size - 1, d.y + size - 1, col);
+                continue;
+            }
+            for (int y = d.y; y < d.y + size; y++) {
+                for (int x = d.x; x < d.x + size; x++) {
+                    graphics.pset(x, y, col);
+                }
+            }
+        }
+        return;
+    }
+
+    for (const SprDraw& d : draws) {
+        if (legacy) {
+            legacyBlit(&ram, ram.spriteSheetData, d.x, d.y, (d.n % 16) * 8, (d.n / 16) * 8,
+                c.cells * 8, c.cells * 8, c.flipX, c.flipY);
+        }
+        else {
+            graphics.spr(d.n, d.x, d.y, c.cells, c.cells, c.flipX, c.flipY);
+        }
+    }
+}
+
+static double timeFrames(Graphics& graphics, PicoRam& ram, const GfxBenchCase& c, const vector<SprDraw>& draws, int frames, bool legacy) {
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        drawFrame(graphics, ram, c, draws, legacy);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static GfxBenchResult runCase(const GfxBenchCase& c, int frames) {
+    GfxBenchResult r;
+    r.name = c.name;
+
+    PicoRam ram;
+    ram.Reset();
+    Graphics graphics(get_font_data(), &ram);
+
+    ram.drawState.fillPattern[0] = c.pattern & 0xff;
+    ram.drawState.fillPattern[1] = c.pattern >> 8;
+    ram.drawState.fillPatternTransparencyBit = c.patternTransparent;
+
+    uint32_t seed = 8;
+    for (size_t i = 0; i < sizeof(ram.spriteSheetData); i++) {
+        ram.spriteSheetData[i] = (uint8_t)benchRandom(seed);
+    }
+    for (size_t i = 0; i < sizeof(ram.mapData); i++) {
+        ram.mapData[i] = (uint8_t)benchRandom(seed);
+    }
+
+    //sprites stay on screen so both blitters draw every pixel (the legacy one
+    //pairs flipped pixels up wrong when clipped by an odd amount)
+    vector<SprDraw> draws;
+    int range = 128 - c.cells * 8;
+    for (int i = 0; i < SpritesPerFrame; i++) {
+        SprDraw d;
+        d.n = benchRandom(seed) % 256;
+        d.x = (benchRandom(seed) % range) & ~1;
+        d.y = benchRandom(seed) % range;
+        if (c.oddX) {
+            d.x |= 1;
+        }
+        draws.push_back(d);
+    }
+
+    uint64_t pixels = c.map
+        ? 128 * 128
+        : (uint64_t)SpritesPerFrame * c.cells * 8 * c.cells * 8;
+    pixels *= frames;
+
+    graphics.cls();
+    drawFrame(graphics, ram, c, draws, false);
+    vector<uint8_t> screen(ram.screenBuffer, ram.screenBuffer + sizeof(ram.screenBuffer));
+    graphics.cls();
+    drawFrame(graphics, ram, c, draws, true);
+    r.match = memcmp(screen.data(), ram.screenBuffer, screen.size()) == 0;
+
+    double seconds = timeFrames(graphics, ram, c, draws, frames, false);
+    double legacySeconds = timeFrames(graphics, ram, c, draws, frames, true);
+
+    r.mpxPerSecond = seconds > 0 ? pixels / seconds / 1000000.0 : 0;
+    r.legacyMpxPerSecond = legacySeconds > 0 ? pixels / legacySeconds / 1000000.0 : 0;
+
+    return r;
+}
+
+int runGfxBench(int frames, bool json) {
+    const GfxBenchCase cases[] = {
+        {"spr 8x8", 1, false, false, false, false, 0},
+        {"spr 8x8 odd x", 1, true, false, false, false, 0},
+        {"spr 8x8 flip x", 1, false, true, false, false, 0},
+        {"spr 8x8 flip y", 1, true, false, true, false, 0},
+        {"spr 16x16", 2, false, false, false, false, 0},
+        {"spr 32x32 odd x", 4, true, false, false, false, 0},
+        {"map 16x16", 1, false, false, false, true, 0},
+        {"map 17x17 scrolled", 1, false, false, false, true, 3},
+        {"rectfill 32x32 fillp", 4, true, false, false, false, 0, true, 0x5a5a, false},
+        {"rectfill 32x32 fillp transparent", 4, true, false, false, false, 0, true, 0x33cc, true},
+    };
+
+    vector<GfxBenchResult> results;
+    for (const GfxBenchCase& c : cases) {
+        results.push_back(runCase(c, frames));
+    }
+
+    if (json) {
+        printf("[\n");
+        for (size_t i = 0; i < results.size(); i++) {
+            const GfxBenchResult& r = results[i];
+            printf("  {\"case\": \"%s\", \"frames\": %d, \"mpx_per_second\": %.2f, \"legacy_mpx_per_second\": %.2f, \"match\": %s}%s\n",
+                r.name.c_str(), frames, r.mpxPerSecond, r.legacyMpxPerSecond, r.match ? "true" : "false",
+                i + 1 < results.size() ? "," : "");
+        }
+        printf("]\n");
+        return 0;
+    }
+
+    printf("gfx: %d frames per case (%d sprites a frame)\n", frames, SpritesPerFrame);
+    for (const GfxBenchResult& r : results) {
+        printf("  %-32s %9.2f Mpx/s  legacy %9.2f Mpx/s  %5.2fx  %s\n",
+            r.name.c_str(), r.mpxPerSecond, r.legacyMpxPerSecond,
+            r.legacyMpxPerSecond > 0 ? r.mpxPerSecond / r.legacyMpxPerSecond : 0,
+            r.match ? "" : "(screens differ)");
+    }
+
+    return 0;
+}
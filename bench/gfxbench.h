@@ -0,0 +1,5 @@
+#pragma once
+
+//graphics microbenchmark: draws sprites, maps and patterned fills with Graphics
+//directly (no cart or vm involved) and the way they were drawn before, for comparison
+int runGfxBench(int frames, bool json);
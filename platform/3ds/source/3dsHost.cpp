@@ -16,9 +16,9 @@ using namespace std;
 
 #include "../../../source/host.h"
 #include "../../../source/hostVmShared.h"
-#include "../../../source/nibblehelpers.h"
 #include "../../../source/PicoRam.h"
 #include "../../../source/filehelpers.h"
+#include "../../../source/frameConverter.h"
 
 #define SCREEN_WIDTH 400;
 #define SCREEN_HEIGHT 240;
@@ -53,8 +53,6 @@ int touchLocationX;
 int touchLocationY;
 uint8_t mouseBtnState;
 
-uint16_t _rgb565Colors[144];
-uint32_t _rgba8Colors[144];
 Audio* _audio;
 
 u8 consoleModel = 0;
@@ -74,6 +72,8 @@ const GPU_TEXCOLOR texColor = GPU_RGB565;
 #define CLEAR_COLOR 0xFF000000
 #define BYTES_PER_PIXEL 2
 size_t pico_pixel_buffer_size = 128*128*BYTES_PER_PIXEL;
+//converted frame kept between frames so only dirty rows need redoing
+FrameConverter _frameConverter(FRAME_FORMAT_RGB565);
 
 
 int topXOffset = 0;
@@ -348,11 +348,6 @@ void Host::oneTimeSetup(Audio* audio){
     currKDown32 = 0;
     currKHeld32 = 0;
 
-    for(int i = 0; i < 144; i++){
-        _rgba8Colors[i] = 0xFF | (_paletteColors[i].Blue << 8) | (_paletteColors[i].Green << 16) | (_paletteColors[i].Red << 24);
-        _rgb565Colors[i] = (((_paletteColors[i].Red & 0xf8)<<8) + ((_paletteColors[i].Green & 0xfc)<<3)+(_paletteColors[i].Blue>>3));
-    }
-
     pico_tex = (C3D_Tex*)linearAlloc(sizeof(C3D_Tex));
 	//people on homebrew discord said should use this
 	C3D_TexInitVRAM(pico_tex, 128, 128, texColor);
@@ -514,10 +509,18 @@ void Host::waitForTargetFps(){
 
 
 void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
-    size_t pixIdx = 0;
-
-    for (pixIdx = 0; pixIdx < pico_pixel_buffer_size; pixIdx++){
-        pico_pixel_buffer[pixIdx] = _rgb565Colors[screenPaletteMap[getPixelNibble(pixIdx % 128, pixIdx / 128, picoFb)]];
+    _frameConverter.convert(
+        picoFb,
+        screenPaletteMap,
+        _altScreenPalette,
+        _paletteColors,
+        pico_pixel_buffer,
+        BYTES_PER_PIXEL * 128,
+        1,
+        _screenDirtyState);
+
+    if (_screenDirtyState != nullptr) {
+        resetScreenDirtyState(_screenDirtyState);
     }
 
     //not sure if this is necessary?
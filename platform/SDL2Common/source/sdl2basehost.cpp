@@ -10,9 +10,9 @@ using namespace std;
 
 #include "sdl2basehost.h"
 #include "../../../source/hostVmShared.h"
-#include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
 #include "../../../source/filehelpers.h"
+#include "../../../source/frameConverter.h"
 
 // sdl
 #include <SDL2/SDL.h>
@@ -54,9 +54,10 @@ SDL_Renderer *renderer;
 SDL_Texture *texture = NULL;
 SDL_AudioSpec want, have;
 SDL_AudioDeviceID dev;
-void *pixels;
-uint8_t *base;
-int pitch;
+//converted frame kept between frames so only dirty rows need redoing
+uint8_t stagingPixels[128 * 128 * 4];
+//the textures are SDL_PIXELFORMAT_ARGB8888
+FrameConverter _frameConverter(FRAME_FORMAT_XRGB8888);
 
 SDL_Rect DestR;
 SDL_Rect SrcR;
@@ -70,7 +71,6 @@ bool audioInitialized = false;
 
 void postFlipFunction(){
     // We're done rendering, so we end the frame here.
-    SDL_UnlockTexture(texture);
     SDL_RenderCopyEx(renderer, texture, &SrcR, &DestR, textureAngle, NULL, flip);
 
     SDL_RenderPresent(renderer);
@@ -217,6 +217,7 @@ void Host::oneTimeSetup(Audio* audio){
     atexit(SDL_Quit);
 
     _audio = audio;
+    _audio->setThreadedRendering(true);
     audioSetup();
 
     joystickCount = SDL_NumJoysticks();
@@ -328,89 +329,42 @@ void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMod
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
     SDL_RenderClear(renderer);
 
-    SDL_LockTexture(texture, NULL, &pixels, &pitch);
+    _frameConverter.convert(
+        picoFb,
+        screenPaletteMap,
+        _altScreenPalette,
+        _paletteColors,
+        stagingPixels,
+        4 * PicoScreenWidth,
+        1,
+        _screenDirtyState);
+
+    int firstDirty = PicoScreenHeight;
+    int lastDirty = -1;
 
     for (int y = 0; y < PicoScreenHeight; y ++){
-        for (int x = 0; x < PicoScreenWidth; x ++){
-            uint8_t c = getPixelNibble(x, y, picoFb);
-            Color col = _paletteColors[screenPaletteMap[c]];
-
-            base = ((Uint8 *)pixels) + (4 * ( y * PicoScreenHeight + x));
-            base[0] = col.Blue;
-            base[1] = col.Green;
-            base[2] = col.Red;
-            base[3] = col.Alpha;
+        if (_screenDirtyState == nullptr || isScreenRowDirty(_screenDirtyState, y)) {
+            firstDirty = y < firstDirty ? y : firstDirty;
+            lastDirty = y;
         }
     }
 
-    SrcR.x = 0;
-    SrcR.y = 0;
+    //only upload the band of rows that changed
+    if (lastDirty >= firstDirty) {
+        SDL_Rect dirtyRect = {0, firstDirty, PicoScreenWidth, lastDirty - firstDirty + 1};
+        SDL_UpdateTexture(
+            texture,
+            &dirtyRect,
+            stagingPixels + (4 * firstDirty * PicoScreenWidth),
+            4 * PicoScreenWidth);
+    }
 
-    switch(drawMode){
-        case 1:
-            SrcR.w = 64;
-            SrcR.h = PicoScreenHeight;
-            textureAngle = 0;
-            flip = SDL_FLIP_NONE;
-            break;
-        case 2:
-            SrcR.w = PicoScreenWidth;
-            SrcR.h = 64;
-            textureAngle = 0;
-            flip = SDL_FLIP_NONE;
-            break;
-        case 3:
-            SrcR.w = 64;
-            SrcR.h = 64;
-            textureAngle = 0;
-            flip = SDL_FLIP_NONE;
-            break;
-        //todo: mirroring
-        //case 4,6,7
-        case 129:
-            SrcR.w = PicoScreenWidth;
-            SrcR.h = PicoScreenHeight;
-            textureAngle = 0;
-            flip = SDL_FLIP_HORIZONTAL;
-            break;
-        case 130:
-            SrcR.w = PicoScreenWidth;
-            SrcR.h = PicoScreenHeight;
-            textureAngle = 0;
-            flip = SDL_FLIP_VERTICAL;
-            break;
-        case 131:
-            SrcR.w = PicoScreenWidth;
-            SrcR.h = PicoScreenHeight;
-            textureAngle = 0;
-            flip = (SDL_RendererFlip)(SDL_FLIP_HORIZONTAL | SDL_FLIP_VERTICAL);
-            break;
-        case 133:
-            SrcR.w = PicoScreenWidth;
-            SrcR.h = PicoScreenHeight;
-            textureAngle = 90;
-            flip = SDL_FLIP_NONE;
-            break;
-        case 134:
-            SrcR.w = PicoScreenWidth;
-            SrcR.h = PicoScreenHeight;
-            textureAngle = 180;
-            flip = SDL_FLIP_NONE;
-            break;
-        case 135:
-            SrcR.w = PicoScreenWidth;
-            SrcR.h = PicoScreenHeight;
-            textureAngle = 270;
-            flip = SDL_FLIP_NONE;
-            break;
-        default:
-            SrcR.w = PicoScreenWidth;
-            SrcR.h = PicoScreenHeight;
-            textureAngle = 0;
-            flip = SDL_FLIP_NONE;
-            break;
+    if (_screenDirtyState != nullptr) {
+        resetScreenDirtyState(_screenDirtyState);
     }
-    
+
+    //the vm hands over the presented buffer, so draw modes are already applied
+    //and the texture is always shown whole and unrotated
 
     postFlipFunction();
 }
@@ -10,8 +10,8 @@ using namespace std;
 
 #include "../../../source/host.h"
 #include "../../../source/hostVmShared.h"
-#include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
+#include "../../../source/frameConverter.h"
 
 // sdl
 #include <SDL/SDL.h>
@@ -40,13 +40,11 @@ SDL_Surface *window;
 SDL_Surface *texture;
 SDL_bool done = SDL_FALSE;
 SDL_AudioSpec want, have;
-void *pixels;
-uint16_t *base;
-int pitch;
 
 bool audioInitialized = false;
 
-uint16_t _mapped16BitColors[144];
+//texture is a 16 bit surface with default masks, which sdl makes 5:6:5
+FrameConverter _frameConverter(FRAME_FORMAT_RGB565);
 
 
 void postFlipFunction(){
@@ -120,6 +118,7 @@ void Host::oneTimeSetup(Color* paletteColors, Audio* audio){
     texture = SDL_CreateRGBSurface(flags, PicoScreenWidth, PicoScreenHeight, SCREEN_BPP, 0, 0, 0, 0);
 
     _audio = audio;
+    _audio->setThreadedRendering(true);
     audioSetup();
     
     last_time = 0;
@@ -128,12 +127,6 @@ void Host::oneTimeSetup(Color* paletteColors, Audio* audio){
     targetFrameTimeMs = 0;
 
     _paletteColors = paletteColors;
-
-    SDL_PixelFormat *f = window->format;
-
-    for(int i = 0; i < 144; i++){
-        _mapped16BitColors[i] = SDL_MapRGB(f, _paletteColors[i].Red, _paletteColors[i].Green, _paletteColors[i].Blue);
-    }
 }
 
 void Host::oneTimeCleanup(){
@@ -262,17 +255,18 @@ void set_pixel(SDL_Surface *surface, int x, int y, uint16_t pixel)
 */
 
 void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
-    
-    pixels = texture->pixels;
-
-    for (int y = 0; y < (PicoScreenHeight); y ++){
-        for (int x = 0; x < PicoScreenWidth; x ++){
-            uint8_t c = getPixelNibble(x, y, picoFb);
-            uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-            base = ((uint16_t *)pixels) + ( y * PicoScreenHeight + x);
-            base[0] = col;
-        }
+    _frameConverter.convert(
+        picoFb,
+        screenPaletteMap,
+        _altScreenPalette,
+        _paletteColors,
+        texture->pixels,
+        texture->pitch,
+        1,
+        _screenDirtyState);
+
+    if (_screenDirtyState != nullptr) {
+        resetScreenDirtyState(_screenDirtyState);
     }
 
     postFlipFunction();
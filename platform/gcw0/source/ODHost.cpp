@@ -13,8 +13,8 @@ using namespace std;
 
 #include "../../../source/host.h"
 #include "../../../source/hostVmShared.h"
-#include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
+#include "../../../source/frameConverter.h"
 #include "../../../source/filehelpers.h"
 
 // sdl
@@ -41,7 +41,6 @@ int _maxNoStretchHeight = 384;
 
 const int PicoScreenWidth = 128;
 const int PicoScreenHeight = 128;
-const int pixelBlocksPerLine = PicoScreenWidth / 8;
 
 
 StretchOption stretch;
@@ -60,21 +59,17 @@ SDL_Surface *window;
 SDL_Surface *texture;
 SDL_bool done = SDL_FALSE;
 SDL_AudioSpec want, have;
-void *pixels;
-uint16_t *base;
-int pitch;
 
 SDL_Rect SrcR;
 SDL_Rect DestR;
 
-int textureAngle;
-uint8_t flip; //0 none, 1 horizontal, 2 vertical - match SDL2's SDL_RendererFlip
 int drawModeScaleX = 1;
 int drawModeScaleY = 1;
 
 bool audioInitialized = false;
 
-uint16_t _mapped16BitColors[144];
+//texture is a 16 bit surface with default masks, which sdl makes 5:6:5
+FrameConverter _frameConverter(FRAME_FORMAT_RGB565);
 
 /*
  * Gameblabla 
@@ -179,9 +174,6 @@ void _changeStretch(StretchOption newStretch){
 
     _setSourceRect(xoffset, yoffset);
 
-    textureAngle = 0;
-    flip = 0;
-
     //clear the screen so nothing is left over behind current stretch
     SDL_FillRect(window, NULL, SDL_MapRGB(window->format, 0, 0, 0));
 }
@@ -232,6 +224,7 @@ void Host::oneTimeSetup(Audio* audio){
     #endif
 
     _audio = audio;
+    _audio->setThreadedRendering(true);
     audioSetup();
     
     last_time = 0;
@@ -239,11 +232,6 @@ void Host::oneTimeSetup(Audio* audio){
     frame_time = 0;
     targetFrameTimeMs = 0;
 
-    SDL_PixelFormat *f = window->format;
-
-    for(int i = 0; i < 144; i++){
-        _mapped16BitColors[i] = SDL_MapRGB(f, _paletteColors[i].Red, _paletteColors[i].Green, _paletteColors[i].Blue);
-    }
 
     const SDL_VideoInfo* info = SDL_GetVideoInfo();
     _windowWidth = info->current_w;
@@ -431,185 +419,34 @@ void set_pixel(SDL_Surface *surface, int x, int y, uint16_t pixel)
 
 void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
     #ifdef OPENDINGUX_IPU
-    pixels = window->pixels;
+    //the ipu scales the 128x128 video mode itself. its buffers are flipped,
+    //so every row is converted
+    _frameConverter.convert(
+        picoFb,
+        screenPaletteMap,
+        _altScreenPalette,
+        _paletteColors,
+        window->pixels,
+        window->pitch);
     #else
-	drawModeScaleX = 1;
-    drawModeScaleY = 1;
-    switch(drawMode){
-        case 1:
-            drawModeScaleX = 2;
-            textureAngle = 0;
-            flip = 0;
-            break;
-        case 2:
-            drawModeScaleY = 2;
-            textureAngle = 0;
-            flip = 0;
-            break;
-        case 3:
-            drawModeScaleX = 2;
-            drawModeScaleY = 2;
-            textureAngle = 0;
-            flip = 0;
-            break;
-        //todo: mirroring
-        //case 4,6,7
-        case 129:
-            textureAngle = 0;
-            flip = 1;
-            break;
-        case 130:
-            textureAngle = 0;
-            flip = 2;
-            break;
-        case 131:
-            textureAngle = 0;
-            flip = 3;
-            break;
-        case 133:
-            textureAngle = 90;
-            flip = 0;
-            break;
-        case 134:
-            textureAngle = 180;
-            flip = 0;
-            break;
-        case 135:
-            textureAngle = 270;
-            flip = 0;
-            break;
-        default:
-            
-            textureAngle = 0;
-            flip = 0;
-            break;
-    }
     int yoffset = stretch == StretchAndOverflow ? 4 / drawModeScaleX : 0;
 
     _setSourceRect(0, yoffset);
 
-    pixels = texture->pixels;
-
-    //horizontal flip
-    if (textureAngle == 0 && flip == 1) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ( y * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
-    }
-    //vertical flip
-    else if (textureAngle == 0 && flip == 2) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ((127 - y) * PicoScreenHeight + x);
-                base[0] = col;
-            }
-        }
-    }
-    //horizontal and vertical flip
-    else if (textureAngle == 0 && flip == 3) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
-    }
-    //rotated 90 degrees
-    else if (textureAngle == 90 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + (x * PicoScreenHeight + (127 - y));
-                base[0] = col;
-            }
-        }
-    }
-    //rotated 180 degrees
-    else if (textureAngle == 180 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
-    }
-    //rotated 270 degrees
-    else if (textureAngle == 270 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ((127 - x) * PicoScreenHeight + y);
-                base[0] = col;
-            }
-        }
-    }
-    else { //default
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < pixelBlocksPerLine; x ++){
-                int32_t eightPix = ((int32_t*)picoFb)[y * pixelBlocksPerLine + x];
-
-                int h = (eightPix >> 28) & 0x0f;
-                int g = (eightPix >> 24) & 0x0f;
-                int f = (eightPix >> 20) & 0x0f;
-                int e = (eightPix >> 16) & 0x0f;
-                int d = (eightPix >> 12) & 0x0f;
-                int c = (eightPix >>  8) & 0x0f;
-                int b = (eightPix >>  4) & 0x0f;
-                int a = (eightPix)       & 0x0f;
-
-                int32_t cola = _mapped16BitColors[screenPaletteMap[a]];
-                int32_t colb = _mapped16BitColors[screenPaletteMap[b]];
-                int32_t colc = _mapped16BitColors[screenPaletteMap[c]];
-                int32_t cold = _mapped16BitColors[screenPaletteMap[d]];
-                int32_t cole = _mapped16BitColors[screenPaletteMap[e]];
-                int32_t colf = _mapped16BitColors[screenPaletteMap[f]];
-                int32_t colg = _mapped16BitColors[screenPaletteMap[g]];
-                int32_t colh = _mapped16BitColors[screenPaletteMap[h]];
-
-                
-                base = ((uint16_t *)pixels + (y * PicoScreenHeight + x * 8));
-                base[0] = cola;
-                base[1] = colb;
-                base[2] = colc;
-                base[3] = cold;
-                base[4] = cole;
-                base[5] = colf;
-                base[6] = colg;
-                base[7] = colh;
-                
-
-                //----OR something like this for further optimization?
-                //not exactly this. its broken
-                /*
-                int32_t* base32 = ((int32_t *)pixels + (y * PicoScreenHeight + x * 8));
-                base32[0] = cola << 16 & colb;
-                base32[1] = colc << 16 & cold;
-                base32[2] = cole << 16 & colf;
-                base32[3] = colg << 16 & colh;
-                */
-                
-                
-            }
-        }
+    //the vm hands over the presented buffer, so draw modes are already applied.
+    //the surface is kept between frames, so only dirty rows are converted
+    _frameConverter.convert(
+        picoFb,
+        screenPaletteMap,
+        _altScreenPalette,
+        _paletteColors,
+        texture->pixels,
+        texture->pitch,
+        1,
+        _screenDirtyState);
+
+    if (_screenDirtyState != nullptr) {
+        resetScreenDirtyState(_screenDirtyState);
     }
     #endif
 
@@ -13,6 +13,8 @@
 #include "../../source/hostVmShared.h"
 #include "../../source/nibblehelpers.h"
 #include "../../source/filehelpers.h"
+#include "../../source/frameConverter.h"
+#include "../../source/audioResampler.h"
 #include "libretrohosthelpers.h"
 
 
@@ -31,21 +33,40 @@ static retro_log_printf_t log_cb;
 
 
 #define SAMPLERATE 22050
+//retro_run rate reported to the frontend. 30fps carts update every other call
+#define CORE_FPS 60
 #define SAMPLESPERFRAME (SAMPLERATE / 30)
 #define NUM_BUFFERS 2
 const size_t audioBufferSize = SAMPLESPERFRAME * NUM_BUFFERS;
 
 int16_t audioBuffer[audioBufferSize];
 
+#if !defined(SF2000)
+//SAMPLERATE / CORE_FPS isn't whole, so the remainder carries between calls
+//(367 and 368 alternate) and the core produces exactly SAMPLERATE a second
+static int audio_sample_remainder = 0;
+//rate handed to the frontend. anything but SAMPLERATE goes through _resampler
+static int audio_output_rate = SAMPLERATE;
+static AudioResampler _resampler;
+#define MAX_OUTPUT_RATE 48000
+//worst case for one retro_run worth of input, in int16 (stereo) samples
+const size_t resampledBufferSize = (MAX_OUTPUT_RATE / CORE_FPS + 8) * 2;
+int16_t resampledBuffer[resampledBufferSize];
+#endif
+
 const int PicoScreenWidth = 128;
 const int PicoScreenHeight = 128;
 const int BytesPerPixel = 2;
 
 static int scale = 1;
+//set when the output buffer no longer matches the pico screen (scale/crop changes, splash, state load)
+static bool forceFullRedraw = true;
 static int crop_h_left = 0;
 static int crop_h_right = 0;
 static int crop_v_top = 0;
 static int crop_v_bottom = 0;
+//0 is disabled
+static int audio_thread_ms = 0;
 
 const size_t screenBufferSize = PicoScreenWidth*PicoScreenHeight;
 uint16_t screenBuffer[screenBufferSize];
@@ -59,6 +80,7 @@ Vm* _vm;
 PicoRam* _memory;
 Audio* _audio;
 Host* _host;
+FrameConverter _frameConverter(FRAME_FORMAT_RGB565);
 
 bool audio_enabled = true;
 double prev_frame_time = 0;
@@ -470,6 +492,44 @@ static void check_variables(bool startup)
         }
     }
 
+    if (video_updated)
+    {
+        forceFullRedraw = true;
+    }
+
+#if !defined(SF2000)
+    var.key = "fake08_audio_thread";
+
+    if (enviro_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+    {
+        int newval = atoi(var.value);
+        if (newval != audio_thread_ms)
+        {
+            audio_thread_ms = newval;
+            if (audio_thread_ms > 0) {
+                _vm->StartAudioRenderThread(audio_thread_ms);
+            }
+            else {
+                _vm->StopAudioRenderThread();
+            }
+        }
+    }
+
+    var.key = "fake08_audio_rate";
+
+    if (enviro_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+    {
+        int newval = atoi(var.value);
+        if (newval != audio_output_rate && newval > 0 && newval <= MAX_OUTPUT_RATE)
+        {
+            if (newval == SAMPLERATE || _resampler.configure(SAMPLERATE, newval)) {
+                audio_output_rate = newval;
+                video_updated = 2;
+            }
+        }
+    }
+#endif
+
     if (video_updated && !startup)
    {
       struct retro_system_av_info av_info;
@@ -570,6 +630,7 @@ EXPORT void retro_deinit()
         log_cb(RETRO_LOG_INFO, "Retro deinit called. tearing down\n");
     }
     //delete things created in init
+    _vm->StopAudioRenderThread();
     _vm->CloseCart();
     _host->oneTimeCleanup();
     delete _vm;
@@ -605,7 +666,11 @@ EXPORT void retro_get_system_av_info(struct retro_system_av_info *info)
     info->geometry.max_height = PicoScreenHeight * scale;
     info->geometry.aspect_ratio = 1.0f;
     info->timing.fps = 60.f;
-    info->timing.sample_rate = 22050.f;
+#if defined(SF2000)
+    info->timing.sample_rate = SAMPLERATE;
+#else
+    info->timing.sample_rate = audio_output_rate;
+#endif
 
     retro_pixel_format pf = RETRO_PIXEL_FORMAT_RGB565;
     enviro_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &pf);
@@ -640,12 +705,6 @@ uint8_t mouseBtnState = 0;
 
 size_t frame = 0;
 
-uint8_t drawMode = 0;
-int drawModeScaleX = 1;
-int drawModeScaleY = 1;
-int textureAngle = 0;
-int flip = 0;
-
 EXPORT void retro_run()
 {
  bool updated  = false;
@@ -737,111 +796,72 @@ EXPORT void retro_run()
         kHeld = currKHeld;
         kDown = currKDown;
 
+#ifdef SF2000
         // Audio rendering - enable by default, allow SF2000 option to disable
         bool should_play_audio = true;
         if (should_play_audio) {
-#ifdef SF2000
             // SF2000 - process audio every frame but with decimated samples
-            _audio->FillAudioBuffer(&audioBuffer, 0, SAMPLESPERFRAME);
+            _vm->FillAudioBuffer(&audioBuffer, 0, SAMPLESPERFRAME);
             audio_batch_cb(audioBuffer, SAMPLESPERFRAME);
-#else
-            // Regular stereo optimization - every other frame
-            if (frame % 2 == 0) {
-                _audio->FillAudioBuffer(&audioBuffer, 0, SAMPLESPERFRAME);
-                audio_batch_cb(audioBuffer, SAMPLESPERFRAME);
-            }
-#endif
         }
+#endif
     }
 
-    uint8_t* picoFb = _vm->GetPicoInteralFb();
-    uint8_t* screenPaletteMap = _vm->GetScreenPaletteMap();
+#if !defined(SF2000)
+    //audio follows retro_run, not cart updates, so 30 and 60fps carts both
+    //hand the frontend exactly its reported rate with no drift
+    audio_sample_remainder += SAMPLERATE;
+    size_t audioFrames = audio_sample_remainder / CORE_FPS;
+    audio_sample_remainder %= CORE_FPS;
 
-    drawMode = _memory->drawState.drawMode;
-
-    drawModeScaleX = 1;
-    drawModeScaleY = 1;
-    switch(drawMode){
-        case 1:
-            drawModeScaleX = 2;
-            textureAngle = 0;
-            flip = 0;
-            break;
-        case 2:
-            drawModeScaleY = 2;
-            textureAngle = 0;
-            flip = 0;
-            break;
-        case 3:
-            drawModeScaleX = 2;
-            drawModeScaleY = 2;
-            textureAngle = 0;
-            flip = 0;
-            break;
-        //todo: mirroring
-        //case 4,6,7
-        case 129:
-            textureAngle = 0;
-            flip = 1;
-            break;
-        case 130:
-            textureAngle = 0;
-            flip = 2;
-            break;
-        case 131:
-            textureAngle = 0;
-            flip = 3;
-            break;
-        case 133:
-            textureAngle = 90;
-            flip = 0;
-            break;
-        case 134:
-            textureAngle = 180;
-            flip = 0;
-            break;
-        case 135:
-            textureAngle = 270;
-            flip = 0;
-            break;
-        default:
-            textureAngle = 0;
-            flip = 0;
-            break;
+    _vm->FillAudioBuffer(&audioBuffer, 0, audioFrames);
+    if (audio_output_rate == SAMPLERATE) {
+        audio_batch_cb(audioBuffer, audioFrames);
+    }
+    else {
+        size_t written = _resampler.process(audioBuffer, audioFrames, resampledBuffer);
+        audio_batch_cb(resampledBuffer, written);
     }
-    //TODO: handle rotation/flip/mirroring
+#endif
+
+    //draw modes (stretch, mirror, flip, rotate) are already applied by the core
+    uint8_t* picoFb = _vm->GetPresentedFrameBuffer();
+    uint8_t* screenPaletteMap = _vm->GetScreenPaletteMap();
+    AltScreenPalette_t* altScreenPalette = _vm->GetAltScreenPalette();
 
     unsigned width  = PicoScreenWidth;
     unsigned height = PicoScreenHeight;
     unsigned pitch  = width * sizeof(uint16_t);
 
+    //rows the cart didn't touch since the last frame are still correct in the output buffer
+    ScreenDirtyState_t* dirtyState = _vm->GetScreenDirtyState();
+    bool fullRedraw = forceFullRedraw;
+    forceFullRedraw = false;
+
     width  -= (crop_h_left + crop_h_right);
     height -= (crop_v_top + crop_v_bottom);
     pitch  -= (crop_h_left + crop_h_right) * sizeof(uint16_t);
 
     // Optimized video conversion - eliminate per-pixel function calls
     if (scale > 1) {
-        for(unsigned scry = 0; scry < height; scry++) {
-            for (unsigned scrx = 0; scrx < width; scrx++) {
-                int picox = (scrx + crop_h_left) / drawModeScaleX;
-                int picoy = (scry + crop_v_top) / drawModeScaleY;
-                
-                // Direct pixel access instead of function call
-                int pixelIdx = (picoy * 64) + (picox / 2);
-                uint8_t bothPix = picoFb[pixelIdx];
-                uint8_t pixel = (picox & 1) == 0 ? (bothPix & 0x0f) : (bothPix >> 4);
-                uint16_t color = _rgb565Colors[screenPaletteMap[pixel]];
-                
-                for (int y = 0; y < scale; y++) {
-                    for (int x = 0; x < scale; x++) {
-                        screenBuffer2x[(scry*scale+y)*width*scale+scrx*scale+x] = color;
-                    }
-                }
-            }
-        }
+        _frameConverter.convert(
+            picoFb,
+            screenPaletteMap,
+            altScreenPalette,
+            _host->GetPaletteColors(),
+            screenBuffer2x,
+            width * scale * sizeof(uint16_t),
+            scale,
+            fullRedraw ? nullptr : dirtyState,
+            crop_h_left,
+            crop_v_top,
+            width,
+            height);
 
         // Check for splash screen override
         if (splash_screen_active && splash_frame_counter < 90) {
+            forceFullRedraw = true;
+
             // Fill entire buffer with splash screen
             for (size_t i = 0; i < width * scale * height * scale; i++) {
                 screenBuffer2x[i] = _rgb565Colors[15]; // Peach background
@@ -867,21 +887,24 @@ EXPORT void retro_run()
         video_cb(&screenBuffer2x, width * scale, height * scale, pitch * scale);
     }
     else {
-        for(unsigned scry = 0; scry < height; scry++) {
-            for (unsigned scrx = 0; scrx < width; scrx++) {
-                int picox = (scrx + crop_h_left) / drawModeScaleX;
-                int picoy = (scry + crop_v_top) / drawModeScaleY;
-                
-                // Direct pixel access instead of function call
-                int pixelIdx = (picoy * 64) + (picox / 2);
-                uint8_t bothPix = picoFb[pixelIdx];
-                uint8_t pixel = (picox & 1) == 0 ? (bothPix & 0x0f) : (bothPix >> 4);
-                screenBuffer[scry*width+scrx] = _rgb565Colors[screenPaletteMap[pixel]];
-            }
-        }
+        _frameConverter.convert(
+            picoFb,
+            screenPaletteMap,
+            altScreenPalette,
+            _host->GetPaletteColors(),
+            screenBuffer,
+            width * sizeof(uint16_t),
+            1,
+            fullRedraw ? nullptr : dirtyState,
+            crop_h_left,
+            crop_v_top,
+            width,
+            height);
 
         // Check for splash screen override (1x buffer)
         if (splash_screen_active && splash_frame_counter < 90) {
+            forceFullRedraw = true;
+
             // Fill entire buffer with splash screen
             for (size_t i = 0; i < screenBufferSize; i++) {
                 screenBuffer[i] = _rgb565Colors[15]; // Peach background
@@ -907,6 +930,8 @@ EXPORT void retro_run()
         video_cb(&screenBuffer, width, height, pitch);
     }
 
+    _vm->ClearScreenDirtyState();
+
     frame++;
 }
 
@@ -930,6 +955,13 @@ EXPORT size_t retro_serialize_size()
 }
 
 #define SAVE_STATE_HEADER_SIZE 4
+//last header byte. native table helpers register __allnext, which shifts the
+//eris permanents table, so their states can't be loaded by other builds
+#ifdef FAKE08_NATIVE_TABLE_HELPERS
+#define SAVE_STATE_VERSION 2
+#else
+#define SAVE_STATE_VERSION 1
+#endif
 
 EXPORT bool retro_serialize(void *data, size_t size)
 {
@@ -951,7 +983,10 @@ EXPORT bool retro_serialize(void *data, size_t size)
     if (log_cb) {
         log_cb(RETRO_LOG_INFO, "setting up lua state buffer\n");
     }
-    char headerBuffer[SAVE_STATE_HEADER_SIZE] = {'f', '8', 0, 1};
+    //keep the audio thread out of the music state while it's copied
+    _vm->GetAudioRenderThread()->pause();
+
+    char headerBuffer[SAVE_STATE_HEADER_SIZE] = {'f', '8', 0, SAVE_STATE_VERSION};
     memcpy((char*)data, &headerBuffer, SAVE_STATE_HEADER_SIZE);
     
     memset(luaStateBuffer, 0, LUASTATEBUFFSIZE);
@@ -997,6 +1032,8 @@ EXPORT bool retro_serialize(void *data, size_t size)
     memcpy(((char*)data + offset), &_audio->getAudioState()->_musicChannel, sizeof(musicChannel));
     offset += sizeof(musicChannel);
 
+    _vm->GetAudioRenderThread()->resume();
+
     if (log_cb) {
         log_cb(RETRO_LOG_INFO, "returning true\n");
     }
@@ -1038,6 +1075,7 @@ bool deserialize_legacy(const void *data, size_t size) {
         log_cb(RETRO_LOG_INFO, "LEGACY deserializing lua state\n");
     }
     _vm->deserializeLuaState(luaStateBuffer, luaStateSize);
+    forceFullRedraw = true;
 
     if (log_cb) {
         log_cb(RETRO_LOG_INFO, "LEGACY copying pico 8 memory\n");
@@ -1079,8 +1117,25 @@ EXPORT bool retro_unserialize(const void *data, size_t size)
         legacy = false;
     }
 
+    if (!legacy && headerBuffer[3] != SAVE_STATE_VERSION) {
+        if (log_cb) {
+            log_cb(RETRO_LOG_ERROR, "save state version %d doesn't match %d\n", headerBuffer[3], SAVE_STATE_VERSION);
+        }
+        return false;
+    }
+
+    //buffered audio belongs to the state being replaced
+    AudioRenderThread* audioThread = _vm->GetAudioRenderThread();
+    audioThread->pause();
+    audioThread->flush();
+#if !defined(SF2000)
+    _resampler.reset();
+#endif
+
     if (legacy) {
-        return deserialize_legacy(data, size);
+        bool result = deserialize_legacy(data, size);
+        audioThread->resume();
+        return result;
     }
 
     size_t offset = SAVE_STATE_HEADER_SIZE;
@@ -1103,6 +1158,7 @@ EXPORT bool retro_unserialize(const void *data, size_t size)
         log_cb(RETRO_LOG_INFO, "deserializing lua state\n");
     }
     _vm->deserializeLuaState(luaStateBuffer, luaStateSize);
+    forceFullRedraw = true;
 
     if (log_cb) {
         log_cb(RETRO_LOG_INFO, "copying pico 8 memory\n");
@@ -1133,6 +1189,8 @@ EXPORT bool retro_unserialize(const void *data, size_t size)
 
     memcpy(&_audio->getAudioState()->_musicChannel, ((char*)data + offset), musicChannelSize);
     offset += musicChannelSize;
+
+    audioThread->resume();
     
     return true;
 }
@@ -116,6 +116,33 @@ struct retro_core_option_definition option_defs_us[] = {
       },
       "0",
    },
+#if !defined(SF2000)
+   {
+      "fake08_audio_thread",
+      "Audio Render Thread",
+      "Renders audio ahead of the frame on a separate thread, so slow frames don't crackle. Adds the lookahead as latency.",
+      {
+         { "disabled", NULL },
+         { "30",  "30ms" },
+         { "60",  "60ms" },
+         { "100",  "100ms" },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
+   {
+      "fake08_audio_rate",
+      "Audio Output Rate",
+      "Resamples the 22050hz PICO-8 audio inside the core, so the frontend doesn't need its own resampling pass.",
+      {
+         { "22050", "22050hz (native)" },
+         { "44100", "44100hz" },
+         { "48000", "48000hz" },
+         { NULL, NULL },
+      },
+      "48000",
+   },
+#endif
 #if defined(SF2000)
    {
       "fake08_audio",
@@ -13,8 +13,8 @@ using namespace std;
 
 #include "../../../source/host.h"
 #include "../../../source/hostVmShared.h"
-#include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
+#include "../../../source/frameConverter.h"
 #include "../../../source/filehelpers.h"
 
 #ifndef _DESKTOP
@@ -48,7 +48,6 @@ int _maxNoStretchHeight = 384;
 
 const int PicoScreenWidth = 128;
 const int PicoScreenHeight = 128;
-const int pixelBlocksPerLine = PicoScreenWidth / 8;
 
 
 StretchOption stretch;
@@ -67,21 +66,19 @@ SDL_Surface *window;
 SDL_Surface *texture;
 SDL_bool done = SDL_FALSE;
 SDL_AudioSpec want, have;
-void *pixels;
-uint32_t *base;
-int pitch;
 
 SDL_Rect SrcR;
 SDL_Rect DestR;
 
-int textureAngle;
-uint8_t flip; //0 none, 1 horizontal, 2 vertical - match SDL2's SDL_RendererFlip
 int drawModeScaleX = 1;
 int drawModeScaleY = 1;
 
 bool audioInitialized = false;
 
-uint32_t _mapped32BitColors[144];
+//texture is a 32 bit surface with default masks, which sdl makes 0x00rrggbb
+//converted frame kept between frames so only dirty rows need redoing
+uint32_t stagingPixels[128 * 128];
+FrameConverter _frameConverter(FRAME_FORMAT_XRGB8888);
 
 
 void postFlipFunction(){
@@ -201,9 +198,6 @@ void _changeStretch(StretchOption newStretch){
 
     _setSourceRect(xoffset, yoffset);
 
-    textureAngle = 0;
-    flip = 0;
-
     //clear the screen so nothing is left over behind current stretch
     SDL_FillRect(window, NULL, SDL_MapRGB(window->format, 0, 0, 0));
 }
@@ -254,6 +248,7 @@ void Host::oneTimeSetup(Audio* audio){
     texture = SDL_CreateRGBSurface(flags, PicoScreenWidth, PicoScreenHeight, SCREEN_BPP, 0, 0, 0, 0);
 
     _audio = audio;
+    _audio->setThreadedRendering(true);
     audioSetup();
     
     last_time = 0;
@@ -261,13 +256,6 @@ void Host::oneTimeSetup(Audio* audio){
     frame_time = 0;
     targetFrameTimeMs = 0;
 
-    SDL_PixelFormat *f = window->format;
-
-    for(int i = 0; i < 144; i++){
-        _mapped32BitColors[i] = SDL_MapRGB(f, _paletteColors[i].Red, _paletteColors[i].Green, _paletteColors[i].Blue);
-    }
-
-
     _windowWidth = SCREEN_SIZE_X;
     _windowHeight = SCREEN_SIZE_Y;
 
@@ -434,149 +422,49 @@ void set_pixel(SDL_Surface *surface, int x, int y, uint16_t pixel)
 */
 
 void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
-    drawModeScaleX = 1;
-    drawModeScaleY = 1;
-    switch(drawMode){
-        case 1:
-            drawModeScaleX = 2;
-            textureAngle = 0;
-            flip = 0;
-            break;
-        case 2:
-            drawModeScaleY = 2;
-            textureAngle = 0;
-            flip = 0;
-            break;
-        case 3:
-            drawModeScaleX = 2;
-            drawModeScaleY = 2;
-            textureAngle = 0;
-            flip = 0;
-            break;
-        //todo: mirroring
-        //case 4,6,7
-        case 129:
-            textureAngle = 0;
-            flip = 1;
-            break;
-        case 130:
-            textureAngle = 0;
-            flip = 2;
-            break;
-        case 131:
-            textureAngle = 0;
-            flip = 3;
-            break;
-        case 133:
-            textureAngle = 90;
-            flip = 0;
-            break;
-        case 134:
-            textureAngle = 180;
-            flip = 0;
-            break;
-        case 135:
-            textureAngle = 270;
-            flip = 0;
-            break;
-        default:
-            
-            textureAngle = 0;
-            flip = 0;
-            break;
-    }
     int yoffset = stretch == StretchAndOverflow ? 4 / drawModeScaleX : 0;
 
     _setSourceRect(0, yoffset);
 
-    pixels = texture->pixels;
-
-    //horizontal flip
-    if (textureAngle == 0 && flip == 1) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ( y * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
-    }
-    //vertical flip
-    else if (textureAngle == 0 && flip == 2) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ((127 - y) * PicoScreenHeight + x);
-                base[0] = col;
-            }
-        }
-    }
-    //horizontal and vertical flip
-    else if (textureAngle == 0 && flip == 3) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
-    }
-    //rotated 90 degrees
-    else if (textureAngle == 90 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + (x * PicoScreenHeight + (127 - y));
-                base[0] = col;
-            }
-        }
-    }
-    //rotated 180 degrees
-    else if (textureAngle == 180 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
+    //the vm hands over the presented buffer, so draw modes are already applied.
+    //the surface is kept between frames, so only dirty rows are converted
+    #ifdef _DESKTOP
+    _frameConverter.convert(
+        picoFb,
+        screenPaletteMap,
+        _altScreenPalette,
+        _paletteColors,
+        texture->pixels,
+        texture->pitch,
+        1,
+        _screenDirtyState);
+    #else
+    //the screen is mounted upside down, so rows are written back rotated 180 degrees
+    _frameConverter.convert(
+        picoFb,
+        screenPaletteMap,
+        _altScreenPalette,
+        _paletteColors,
+        stagingPixels,
+        4 * PicoScreenWidth,
+        1,
+        _screenDirtyState);
+
+    for (int y = 0; y < PicoScreenHeight; y ++){
+        if (_screenDirtyState != nullptr && !isScreenRowDirty(_screenDirtyState, y)) {
+            continue;
         }
-    }
-    //rotated 270 degrees
-    else if (textureAngle == 270 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ((127 - x) * PicoScreenHeight + y);
-                base[0] = col;
-            }
+
+        const uint32_t* src = stagingPixels + y * PicoScreenWidth;
+        uint32_t* dest = (uint32_t*)((uint8_t*)texture->pixels + (127 - y) * texture->pitch);
+        for (int x = 0; x < PicoScreenWidth; x ++){
+            dest[127 - x] = src[x];
         }
     }
-    else { //default
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                #ifdef _DESKTOP
-                base = ((uint32_t *)pixels) + (y * PicoScreenHeight + x);
-                #else
-                base = ((uint32_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                #endif
-                base[0] = col;
-            }
-        }
+    #endif
+
+    if (_screenDirtyState != nullptr) {
+        resetScreenDirtyState(_screenDirtyState);
     }
 
     postFlipFunction();
@@ -15,9 +15,9 @@ using namespace std;
 
 #include "../../../source/host.h"
 #include "../../../source/hostVmShared.h"
-#include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
 #include "../../../source/filehelpers.h"
+#include "../../../source/frameConverter.h"
 
 // sdl
 #include <SDL2/SDL.h>
@@ -75,8 +75,9 @@ SDL_RendererFlip flip;
 SDL_AudioSpec want, have;
 SDL_AudioDeviceID dev;
 void *pixels;
-uint8_t *base;
 int pitch;
+//the texture is SDL_PIXELFORMAT_RGBA8888
+FrameConverter _frameConverter(FRAME_FORMAT_RGBA8888);
 
 SDL_Point touchLocation = { 128 / 2, 128 / 2 };
 
@@ -240,6 +241,7 @@ void Host::oneTimeSetup(Audio* audio){
     DestR.h = SCREEN_SIZE_Y;
 
     _audio = audio;
+    _audio->setThreadedRendering(true);
     audioSetup();
 
     for (int i = 0; i < SDL_NumJoysticks(); i++) {
@@ -439,18 +441,14 @@ void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMod
 
     SDL_LockTexture(texture, NULL, &pixels, &pitch);
 
-    for (int y = 0; y < PicoScreenHeight; y ++){
-        for (int x = 0; x < PicoScreenWidth; x ++){
-            uint8_t c = getPixelNibble(x, y, picoFb);
-            Color col = _paletteColors[screenPaletteMap[c]];
-
-            base = ((Uint8 *)pixels) + (4 * ( y * PicoScreenHeight + x));
-            base[0] = col.Red;
-            base[1] = col.Green;
-            base[2] = col.Blue;
-            base[3] = col.Alpha;
-        }
-    }
+    //locked texture contents aren't kept, so every row is converted
+    _frameConverter.convert(
+        picoFb,
+        screenPaletteMap,
+        _altScreenPalette,
+        _paletteColors,
+        pixels,
+        pitch);
 
 
     SrcR.x = 0;
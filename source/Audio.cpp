@@ -3,6 +3,8 @@
 #include "hostVmShared.h"
 #include "mathhelpers.h"
 #include "audioOptimizations.h"
+#include "audioRenderThread.h"
+#include "logger.h"
 
 #include <cstdint>
 #include <string>
@@ -10,7 +12,19 @@
 #include <algorithm> // std::max
 #include <cmath>
 #include <float.h> // std::max
+#include <cstring>
+#include <chrono>
 
+#ifdef SF2000
+// Reduce audio quality for performance on SF2000 MIPS soft-FPU
+#define SAMPLES_PER_SECOND 11025
+#else
+#define SAMPLES_PER_SECOND 22050
+#endif
+
+// PICO-8 exports instruments with 183 samples per speed unit per note at 22050 Hz
+static const float SFX_OFFSETS_PER_SECOND = SAMPLES_PER_SECOND / 183.0f;
+static const float INV_SAMPLES_PER_SECOND = 1.0f / SAMPLES_PER_SECOND;
 
 
 //playback implemenation based on zetpo 8's
@@ -23,11 +37,128 @@ Audio::Audio(PicoRam* memory){
     PerformanceOptimizations::Initialize();
 #endif
     
-    resetAudioState();
+    _threadedRendering = false;
+
+    applyReset(NOISE_DEFAULT_SEED);
+    publishStats();
+}
+
+void Audio::setThreadedRendering(bool threaded) {
+    if (_threadedRendering && !threaded) {
+        //the renderer is gone, apply what it didn't get to so nothing is lost or reordered
+        processCommands();
+        publishStats();
+    }
+    _threadedRendering = threaded;
+}
+
+//resets and stops. losing one leaves the previous cart's or a stopped sound playing
+static bool mustDeliverCommand(const AudioCommand& command) {
+    switch (command.type) {
+        case AUDIO_CMD_RESET:
+            return true;
+        case AUDIO_CMD_SFX:
+            return command.args[0] < 0 || command.args[1] == -2;
+        case AUDIO_CMD_MUSIC:
+            return command.args[0] < 0;
+    }
+
+    return false;
+}
+
+void Audio::submitCommand(const AudioCommand& command) {
+    if (_threadedRendering) {
+        if (_commandQueue.push(command)) {
+            return;
+        }
+
+        //the renderer empties the queue every block, so a full queue only lasts
+        //until its next one. sfx/music starts are dropped rather than blocking
+        //the frame, but resets and stops wait for room. the wait is capped so a
+        //renderer that never runs (no audio device) can't hang the vm
+        if (mustDeliverCommand(command)) {
+            auto start = std::chrono::steady_clock::now();
+            while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(AUDIO_COMMAND_WAIT_MS)) {
+#if AUDIO_RENDER_THREAD_SUPPORTED
+                std::this_thread::yield();
+#endif
+                if (_commandQueue.push(command)) {
+                    return;
+                }
+            }
+        }
+
+        Logger_Write("audio command queue full, dropped command %d (%d, %d, %d)\n",
+            command.type, command.args[0], command.args[1], command.args[2]);
+        return;
+    }
+
+    //nothing renders concurrently, apply it now so stat() sees it straight away
+    switch (command.type) {
+        case AUDIO_CMD_SFX:
+            applySfx(command.args[0], command.args[1], command.args[2]);
+            break;
+        case AUDIO_CMD_MUSIC:
+            applyMusic(command.args[0], (int16_t)command.args[1], (int16_t)command.args[2]);
+            break;
+        case AUDIO_CMD_RESET:
+            applyReset((uint32_t)command.args[0]);
+            break;
+    }
+    publishStats();
+}
+
+void Audio::processCommands() {
+    AudioCommand command;
+    while (_commandQueue.pop(&command)) {
+        switch (command.type) {
+            case AUDIO_CMD_SFX:
+                applySfx(command.args[0], command.args[1], command.args[2]);
+                break;
+            case AUDIO_CMD_MUSIC:
+                applyMusic(command.args[0], (int16_t)command.args[1], (int16_t)command.args[2]);
+                break;
+            case AUDIO_CMD_RESET:
+                applyReset((uint32_t)command.args[0]);
+                break;
+        }
+    }
+}
+
+void Audio::publishStats() {
+    for (int i = 0; i < 4; i++) {
+        rawSfxChannel &channel = _audioState._sfxChannels[i];
+        _statSfxId[i].store(channel.sfxId, std::memory_order_relaxed);
+        _statNoteNumber[i].store(channel.sfxId < 0 ? -1 : (int)channel.offset, std::memory_order_relaxed);
+    }
+
+    _statMusic.store(_audioState._musicChannel.pattern, std::memory_order_relaxed);
+    _statMusicCount.store(_audioState._musicChannel.count, std::memory_order_relaxed);
+    _statMusicTicks.store(
+        (int16_t)(_audioState._musicChannel.offset * _audioState._musicChannel.speed),
+        std::memory_order_relaxed);
+}
+
+void Audio::resetAudioState(uint32_t noiseSeed) {
+    AudioCommand command = { AUDIO_CMD_RESET, { (int32_t)noiseSeed, 0, 0 } };
+    submitCommand(command);
 }
 
-void Audio::resetAudioState() {
+static void seedChannelNoise(rawSfxChannel &channel, uint32_t seed) {
+    z8::synth::seedNoise(channel.current_note.noise, seed);
+    z8::synth::seedNoise(channel.prev_note.noise, seed ^ 0x5bd1e995);
+}
+
+void Audio::applyReset(uint32_t noiseSeed) {
     for(int i = 0; i < 4; i++) {
+        resetChannelFx(&_channelFx[i]);
+
+        //distinct streams per channel, otherwise the same sfx on two channels cancels or doubles
+        uint32_t channelSeed = noiseSeed + 0x9e3779b9 * (uint32_t)(i + 1);
+        seedChannelNoise(_audioState._sfxChannels[i], channelSeed);
+        seedChannelNoise(_audioState._sfxChannels[i].customInstrumentChannel, channelSeed * 3);
+        seedChannelNoise(_audioState._sfxChannels[i].prevInstrumentChannel, channelSeed * 5);
+
         _audioState._sfxChannels[i].sfxId = -1;
         _audioState._sfxChannels[i].offset = 0;
         _audioState._sfxChannels[i].current_note.phi = 0;
@@ -51,6 +182,16 @@ audioState_t* Audio::getAudioState() {
 }
 
 void Audio::api_sfx(int sfx, int channel, int offset){
+    AudioCommand command = { AUDIO_CMD_SFX, { sfx, channel, offset } };
+    submitCommand(command);
+}
+
+void Audio::api_music(int pattern, int16_t fade_len, int16_t mask){
+    AudioCommand command = { AUDIO_CMD_MUSIC, { pattern, fade_len, mask } };
+    submitCommand(command);
+}
+
+void Audio::applySfx(int sfx, int channel, int offset){
 
     if (sfx < -2 || sfx > 63 || channel < -2 || channel > 3 || offset > 31) {
         return;
@@ -130,7 +271,7 @@ void Audio::api_sfx(int sfx, int channel, int offset){
     }      
 }
 
-void Audio::api_music(int pattern, int16_t fade_len, int16_t mask){
+void Audio::applyMusic(int pattern, int16_t fade_len, int16_t mask){
     if (pattern < -1 || pattern > 63) {
         return;
     }
@@ -237,6 +378,320 @@ void Audio::set_music_pattern(int pattern) {
     }
 }
 
+static float key_to_freq(float key)
+{
+#ifdef ENABLE_AUDIO_OPTIMIZATIONS
+    return key_to_freq_optimized(key);
+#else
+    using std::exp2;
+    return 440.f * exp2((key - 33.f) / 12.f);
+#endif
+}
+
+const float C2_FREQ = key_to_freq(24);
+
+void Audio::renderInterleaved(size_t index, int channelCount) {
+    uint8_t halfRate = _memory->hwState.half_rate;
+
+    for (int c = 0; c < channelCount; ++c) {
+        ChannelFxState &fx = _channelFx[c];
+        if (halfRate & (1 << c)) {
+            if (!fx.halfRateSkip) {
+                fx.halfRateHeld = this->getSampleForChannel(c);
+            }
+            fx.halfRateSkip = !fx.halfRateSkip;
+            _channelBlock[c][index] = fx.halfRateHeld;
+        }
+        else {
+            fx.halfRateSkip = false;
+            _channelBlock[c][index] = this->getSampleForChannel(c);
+        }
+    }
+}
+
+size_t Audio::advanceMusic(size_t count, int channelCount) {
+    musicChannel &music = _audioState._musicChannel;
+
+    //the master channel drives music, so it only advances if that channel is rendered
+    if (music.pattern == -1 || music.master < 0 || music.master >= channelCount) {
+        return count;
+    }
+
+    //fading changes the volume every sample; a finished fade in stays clamped at 1
+    if (music.volume_step < 0 || (music.volume_step > 0 && music.volume < 1.f)) {
+        return 0;
+    }
+    music.volume = clamp(music.volume, 0.f, 1.f);
+
+    float const offset_per_second = SAMPLES_PER_SECOND / (183.0f * music.speed);
+    float const offset_per_sample = offset_per_second / SAMPLES_PER_SECOND;
+
+    //same accumulation as getSampleForChannel, so the pattern ends on the same sample
+    float offset = music.offset;
+    size_t n = 0;
+    while (n < count) {
+        float next = offset + offset_per_sample;
+        if (next >= music.length) {
+            break;
+        }
+        offset = next;
+        n++;
+    }
+    music.offset = offset;
+
+    return n;
+}
+
+size_t Audio::renderNoteRun(rawSfxChannel &channel, int16_t *out, size_t count) {
+    if (channel.sfxId < 0 || channel.sfxId > 63) {
+        memset(out, 0, count * sizeof(int16_t));
+        return count;
+    }
+
+    size_t const m = fillNoteRun(channel, _run, count, NULL);
+
+    if (channel.is_music) {
+        float const music_volume = _audioState._musicChannel.volume;
+        for (size_t i = 0; i < m; ++i) {
+            out[i] = (int16_t) (32767.99f * (_run.volume[i] * _run.wave[i] * music_volume));
+        }
+    }
+    else {
+        for (size_t i = 0; i < m; ++i) {
+            out[i] = (int16_t) (32767.99f * (_run.volume[i] * _run.wave[i]));
+        }
+    }
+
+    return m;
+}
+
+size_t Audio::fillNoteRun(rawSfxChannel &channel, NoteRun &run, size_t count, const float *freqShift) {
+    using std::max;
+
+    if (channel.sfxId < 0 || channel.sfxId > 63) {
+        return 0;
+    }
+    struct sfx const &sfx = _memory->sfx[channel.sfxId];
+
+    int const speed = max(1, (int)sfx.speed);
+    float const offset_per_second = SFX_OFFSETS_PER_SECOND / speed;
+    float const offset_per_sample = offset_per_second * INV_SAMPLES_PER_SECOND;
+    float const fade_duration = offset_per_sample * 25;
+    float const loop_range = float(sfx.loopRangeEnd - sfx.loopRangeStart);
+
+    int const note_idx = fast_floor(channel.offset);
+    note const n = sfx.notes[note_idx];
+    rawSfxChannel *childChannel = channel.getChildChannel();
+    bool const custom = n.getCustom() && childChannel != NULL;
+
+    uint8_t len = sfx.loopRangeEnd == 0 ? 32 : sfx.loopRangeEnd;
+    bool lastNote = note_idx == len - 1;
+
+    //find how far the note runs without a crossfade, end fade or note change.
+    //offsets are stepped exactly like getSampleForSfx does
+    size_t m = 0;
+    float offset = channel.offset;
+    while (m < count) {
+        float offset_part = fast_fmod(offset, 1.f);
+        if (offset_part < fade_duration || (lastNote && 1.0f - offset_part < fade_duration)) {
+            break;
+        }
+
+        float next_offset = offset + offset_per_sample;
+        if (loop_range > 0.f && next_offset >= sfx.loopRangeStart && channel.can_loop) {
+            next_offset = fast_fmod(next_offset - sfx.loopRangeStart, loop_range)
+                        + sfx.loopRangeStart;
+        }
+        if (next_offset >= 32.f || fast_floor(next_offset) != note_idx) {
+            break;
+        }
+
+        run.offset[m++] = offset;
+        offset = next_offset;
+    }
+
+    if (m == 0) {
+        return 0;
+    }
+
+    channel.current_note.n = n;
+    channel.offset = offset;
+
+    //frequency and volume per sample, with the effect picked once for the run
+    float const freq = key_to_freq(n.getKey());
+    float const volume = fast_div7(n.getVolume());
+    note const prev_note = channel.prev_note.n;
+
+    switch (n.getEffect())
+    {
+        case FX_SLIDE:
+        {
+            float const prev_freq = key_to_freq(prev_note.getKey());
+            float const prev_volume = fast_div7(prev_note.getVolume());
+            bool const slide_volume = prev_note.getVolume() > 0;
+            for (size_t i = 0; i < m; ++i) {
+                float tmod = fast_fmod(run.offset[i], 1.f);
+                run.freq[i] = lerp(prev_freq, freq, tmod);
+                run.volume[i] = slide_volume ? lerp(prev_volume, volume, tmod) : volume;
+            }
+            break;
+        }
+        case FX_VIBRATO:
+            for (size_t i = 0; i < m; ++i) {
+                float tmod = fast_fmod(run.offset[i], 1.f);
+                float vibrato_phase = fast_fmod(7.5f * tmod / offset_per_second, 1.0f);
+                float t = fast_sine(vibrato_phase) * 0.25f;
+                run.freq[i] = lerp(freq, freq * 1.059463094359f, t);
+                run.volume[i] = volume;
+            }
+            break;
+        case FX_DROP:
+            for (size_t i = 0; i < m; ++i) {
+                run.freq[i] = freq * (1.0f - fast_fmod(run.offset[i], 1.0f));
+                run.volume[i] = volume;
+            }
+            break;
+        case FX_FADE_IN:
+            for (size_t i = 0; i < m; ++i) {
+                float tmod = fast_fmod(run.offset[i], 1.f);
+                run.freq[i] = freq;
+                run.volume[i] = volume * fast_min(1.0f, tmod);
+            }
+            break;
+        case FX_FADE_OUT:
+            for (size_t i = 0; i < m; ++i) {
+                float tmod = fast_fmod(run.offset[i], 1.f);
+                run.freq[i] = freq;
+                run.volume[i] = volume * fast_max(0.0f, 1.0f - tmod);
+            }
+            break;
+        case FX_ARP_FAST:
+        case FX_ARP_SLOW:
+        {
+            int const arp_m = (speed <= 8 ? 32 : 16) / (n.getEffect() == FX_ARP_FAST ? 4 : 8);
+            int arp_key = -1;
+            float arp_freq = 0;
+            for (size_t i = 0; i < m; ++i) {
+                int const arp_n = (int)(arp_m * 7.5f * run.offset[i] / offset_per_second);
+                int const arp_note = (note_idx & ~3) | (arp_n & 3);
+                int const key = sfx.notes[arp_note].getKey();
+                if (key != arp_key) {
+                    arp_key = key;
+                    arp_freq = key_to_freq(key);
+                }
+                run.freq[i] = arp_freq;
+                run.volume[i] = volume;
+            }
+            break;
+        }
+        default:
+            for (size_t i = 0; i < m; ++i) {
+                run.freq[i] = freq;
+                run.volume[i] = volume;
+            }
+            break;
+    }
+
+    if (freqShift != NULL) {
+        for (size_t i = 0; i < m; ++i) {
+            run.freq[i] *= freqShift[i];
+        }
+    }
+
+    float phi = channel.current_note.phi;
+    for (size_t i = 0; i < m; ++i) {
+        run.phase[i] = phi;
+        phi = phi + run.freq[i] / SAMPLES_PER_SECOND;
+    }
+    channel.current_note.phi = phi;
+
+    if (!custom) {
+        z8::synth::waveforms(n.getWaveform(), run.phase, run.wave, (int)m, channel.current_note.noise);
+        return m;
+    }
+
+    //custom instrument: the note's frequency shifts the instrument sfx, which is
+    //rendered in runs of its own. the child channel has no child, so this only nests once
+    for (size_t i = 0; i < m; ++i) {
+        run.shift[i] = run.freq[i] / C2_FREQ;
+    }
+    size_t i = 0;
+    while (i < m) {
+        if (childChannel->sfxId == -1) {
+            startCustomInstrument(*childChannel, n.getWaveform());
+        }
+        size_t k = fillNoteRun(*childChannel, _childRun, m - i, run.shift + i);
+        if (k == 0) {
+            run.wave[i] = this->getSampleForSfx(*childChannel, run.shift[i]);
+            k = 1;
+        }
+        else {
+            for (size_t j = 0; j < k; ++j) {
+                run.wave[i + j] = _childRun.volume[j] * _childRun.wave[j];
+            }
+        }
+        i += k;
+    }
+
+    return m;
+}
+
+void Audio::renderChannel(int channel, int16_t *out, size_t count) {
+    rawSfxChannel &sfxChannel = _audioState._sfxChannels[channel];
+
+    size_t i = 0;
+    while (i < count) {
+        i += renderNoteRun(sfxChannel, out + i, count - i);
+        //note changes and crossfades
+        if (i < count) {
+            out[i++] = (int16_t) (32767.99f * this->getSampleForSfx(sfxChannel));
+        }
+    }
+}
+
+void Audio::renderBlock(size_t count, int channelCount) {
+    processCommands();
+
+    uint8_t halfRate = _memory->hwState.half_rate & ((1 << channelCount) - 1);
+    if (!halfRate) {
+        for (int c = 0; c < channelCount; ++c) {
+            _channelFx[c].halfRateSkip = false;
+        }
+    }
+
+    size_t i = 0;
+    while (i < count) {
+        size_t run = halfRate ? 0 : advanceMusic(count - i, channelCount);
+        if (run > 0) {
+            for (int c = 0; c < channelCount; ++c) {
+                renderChannel(c, &_channelBlock[c][i], run);
+            }
+            i += run;
+        }
+        else {
+            //music pattern changes, fades and half rate go sample by sample in
+            //channel order, same as before blocks
+            renderInterleaved(i, channelCount);
+            i++;
+        }
+    }
+
+    uint8_t distort = _memory->hwState.distort;
+    uint8_t lowpass = _memory->hwState.lowpass;
+    uint8_t reverb = _memory->hwState.reverb;
+    for (int c = 0; c < channelCount; ++c) {
+        applyChannelFx(
+            &_channelFx[c],
+            _channelBlock[c],
+            count,
+            distort & (1 << c),
+            lowpass & (1 << c),
+            reverb & (1 << c));
+    }
+
+    publishStats();
+}
+
 void Audio::FillAudioBuffer(void *audioBuffer, size_t offset, size_t size){
     if (audioBuffer == nullptr) {
         return;
@@ -244,24 +699,28 @@ void Audio::FillAudioBuffer(void *audioBuffer, size_t offset, size_t size){
 
     uint32_t *buffer = (uint32_t *)audioBuffer;
 
-    for (size_t i = 0; i < size; ++i){
-        int32_t sample = 0;
-
 #ifdef SF2000
-        // Process only 3 channels instead of 4 for better performance
-        for (int c = 0; c < 3; ++c) {
-            sample += this->getSampleForChannel(c);
-        }
+    // Process only 3 channels instead of 4 for better performance
+    int const channelCount = 3;
 #else
-        for (int c = 0; c < 4; ++c) {
-            sample += this->getSampleForChannel(c);
-        }
+    int const channelCount = 4;
 #endif
 
-	    if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
+    for (size_t start = 0; start < size; start += AUDIO_FX_BLOCK_SIZE) {
+        size_t count = std::min((size_t)AUDIO_FX_BLOCK_SIZE, size - start);
+        renderBlock(count, channelCount);
 
-        //buffer is stereo, so just send the mono sample to both channels
-        buffer[i] = (sample<<16) | (sample & 0xffff);
+        for (size_t i = 0; i < count; ++i){
+            int32_t sample = 0;
+            for (int c = 0; c < channelCount; ++c) {
+                sample += _channelBlock[c][i];
+            }
+
+            if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
+
+            //buffer is stereo, so just send the mono sample to both channels
+            buffer[start + i] = (sample<<16) | (sample & 0xffff);
+        }
     }
 }
 
@@ -273,71 +732,46 @@ void Audio::FillMonoAudioBuffer(void *audioBuffer, size_t offset, size_t size){
 
     int16_t *buffer = (int16_t *)audioBuffer;
 
-#ifdef SF2000
-    // Clean mono audio for SF2000 - proper quality with moderate optimization
-    for (size_t i = 0; i < size; ++i){
-        int32_t sample = 0;
-        
-        // Use all 4 channels for proper audio quality
-        for (int c = 0; c < 4; ++c) {
-            sample += this->getSampleForChannel(c);
-        }
-        
-        // Reasonable volume boost and clamp
-        sample = sample * 2;
-        if (sample > 0x7fff) sample = 0x7fff; 
-        else if (sample < -0x8000) sample = -0x8000;
-        
-        buffer[i] = sample;
-    }
-#else
-    // Original high-quality audio for other platforms
-    for (size_t i = 0; i < size; ++i){
-        int32_t sample = 0;
+    for (size_t start = 0; start < size; start += AUDIO_FX_BLOCK_SIZE) {
+        size_t count = std::min((size_t)AUDIO_FX_BLOCK_SIZE, size - start);
+        renderBlock(count, 4);
 
-        for (int c = 0; c < 4; ++c) {
-            sample += this->getSampleForChannel(c);
-        }
-
-	    if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
+        for (size_t i = 0; i < count; ++i){
+            int32_t sample = 0;
+            for (int c = 0; c < 4; ++c) {
+                sample += _channelBlock[c][i];
+            }
 
-        buffer[i] = sample;
-    }
+#ifdef SF2000
+            // Clean mono audio for SF2000 - reasonable volume boost
+            sample = sample * 2;
 #endif
-}
+            if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
 
-static float key_to_freq(float key)
-{
-#ifdef ENABLE_AUDIO_OPTIMIZATIONS
-    return key_to_freq_optimized(key);
-#else
-    using std::exp2;
-    return 440.f * exp2((key - 33.f) / 12.f);
-#endif
+            buffer[start + i] = sample;
+        }
+    }
 }
 
-const float C2_FREQ = key_to_freq(24);
 
 int16_t Audio::getCurrentSfxId(int channel){
-    return _audioState._sfxChannels[channel].sfxId;
+    return _statSfxId[channel].load(std::memory_order_relaxed);
 }
 
 int Audio::getCurrentNoteNumber(int channel){
-    return _audioState._sfxChannels[channel].sfxId < 0 
-        ? -1
-        : _audioState._sfxChannels[channel].offset;
+    return _statNoteNumber[channel].load(std::memory_order_relaxed);
 }
 
 int16_t Audio::getCurrentMusic(){
-    return _audioState._musicChannel.pattern;
+    return _statMusic.load(std::memory_order_relaxed);
 }
 
 int16_t Audio::getMusicPatternCount(){
-    return _audioState._musicChannel.count;
+    return _statMusicCount.load(std::memory_order_relaxed);
 }
 
 int16_t Audio::getMusicTickCount(){
-    return _audioState._musicChannel.offset * _audioState._musicChannel.speed;
+    return _statMusicTicks.load(std::memory_order_relaxed);
 }
 
 float Audio::getSampleForSfx(rawSfxChannel &channel, float freqShift) {
@@ -422,7 +856,7 @@ float Audio::getSampleForSfx(rawSfxChannel &channel, float freqShift) {
     float waveform = this->getSampleForNote(channel.current_note, channel, channel.getChildChannel(), channel.prev_note.n, freqShift, false);
     if (crossfade > 0) {
       waveform *= (1.0f-crossfade);
-      note dummyNote;
+      note dummyNote = {};
       waveform+= crossfade * this->getSampleForNote(channel.prev_note, channel, channel.getPrevChildChannel(), dummyNote, freqShift, true);
     }
     uint8_t len = sfx.loopRangeEnd == 0 ? 32 : sfx.loopRangeEnd;
@@ -463,6 +897,17 @@ float Audio::getSampleForSfx(rawSfxChannel &channel, float freqShift) {
 
 }
 
+void Audio::startCustomInstrument(rawSfxChannel &childChannel, int sfx) {
+    childChannel.sfxId = sfx;
+    childChannel.offset = 0;
+    childChannel.current_note.phi = 0;
+    childChannel.can_loop = true;
+    // don't want to double lower volume for music subchannel
+    childChannel.is_music = false;
+    childChannel.prev_note.n.setKey(0);
+    childChannel.prev_note.n.setVolume(0);
+}
+
 float Audio::getSampleForNote(noteChannel &channel, rawSfxChannel &parentChannel, rawSfxChannel *childChannel, note prev_note, float freqShift, bool forceRemainder) {
     using std::max;
     float offset = parentChannel.offset;
@@ -477,15 +922,12 @@ float Audio::getSampleForNote(noteChannel &channel, rawSfxChannel &parentChannel
     uint8_t key = channel.n.getKey();
     float volume = fast_div7(channel.n.getVolume());
     
-    // Cache frequency calculation - only recalculate when key changes
-    static uint8_t cached_key = 255; // Invalid initial value
-    static float cached_freq = 440.0f;
-    float freq;
-    if (key != cached_key) {
-        cached_key = key;
-        cached_freq = key_to_freq(key);
+    // Cache frequency calculation per channel - only recalculate when key changes
+    if (key != channel.freqKey) {
+        channel.freqKey = key;
+        channel.freq = key_to_freq(key);
     }
-    freq = cached_freq;
+    float freq = channel.freq;
 
     struct sfx const &sfx = _memory->sfx[parentChannel.sfxId];
 
@@ -555,19 +997,11 @@ float Audio::getSampleForNote(noteChannel &channel, rawSfxChannel &parentChannel
     float waveform;
     if (custom) {
       if (childChannel->sfxId == -1) {
-        // initialize child channel
-        childChannel->sfxId = channel.n.getWaveform();
-        childChannel->offset = 0;
-        childChannel->current_note.phi = 0;
-        childChannel->can_loop = true;
-        // don't want to double lower volume for music subchannel
-        childChannel->is_music = false;
-        childChannel->prev_note.n.setKey(0);
-        childChannel->prev_note.n.setVolume(0);
+        startCustomInstrument(*childChannel, channel.n.getWaveform());
       }
       waveform = volume * this->getSampleForSfx(*childChannel, freq/C2_FREQ);
     } else {
-      waveform = volume * z8::synth::waveform(channel.n.getWaveform(), channel.phi);
+      waveform = volume * z8::synth::waveform(channel.n.getWaveform(), channel.phi, channel.noise);
     }
     channel.phi = channel.phi + freq / samples_per_second;
     return waveform;
@@ -635,9 +1069,6 @@ int16_t Audio::getSampleForChannel(int channel){
 
     sample = (int16_t) (32767.99f * this->getSampleForSfx(_audioState._sfxChannels[channel]));
 
-    // TODO: Apply hardware effects
-    if (_memory->hwState.distort & (1 << channel)) {
-        sample = sample / 0x1000 * 0x1249;
-    }
+    //hardware effects are applied per block in renderBlock
     return sample;
 }
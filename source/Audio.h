@@ -1,8 +1,11 @@
 #pragma once
 
 #include "PicoRam.h"
+#include "audioEffects.h"
+#include "audioCommandQueue.h"
 
 #include <string>
+#include <atomic>
 
 #define MAX_SFX = 64
 #define BYTES_PER_SFX = 68;
@@ -90,7 +93,61 @@ class Audio {
     PicoRam* _memory;
     audioState_t _audioState;
 
+    AudioCommandQueue _commandQueue;
+    bool _threadedRendering;
+
+    //stat(16..26) values, published by the renderer so the lua thread
+    //never reads _audioState while it is being rendered
+    std::atomic<int> _statSfxId[4];
+    std::atomic<int> _statNoteNumber[4];
+    std::atomic<int> _statMusic;
+    std::atomic<int> _statMusicCount;
+    std::atomic<int> _statMusicTicks;
+
+    ChannelFxState _channelFx[4];
+    int16_t _channelBlock[4][AUDIO_FX_BLOCK_SIZE];
+
+    //scratch for one run of a note, one entry per sample
+    struct NoteRun {
+        float offset[AUDIO_FX_BLOCK_SIZE];
+        float freq[AUDIO_FX_BLOCK_SIZE];
+        float volume[AUDIO_FX_BLOCK_SIZE];
+        float phase[AUDIO_FX_BLOCK_SIZE];
+        float wave[AUDIO_FX_BLOCK_SIZE];
+        //frequency shift handed to a custom instrument's channel
+        float shift[AUDIO_FX_BLOCK_SIZE];
+    };
+    NoteRun _run;
+    //the custom instrument channel playing under the current run
+    NoteRun _childRun;
+
+    void submitCommand(const AudioCommand& command);
+    //applies queued commands; called by the renderer at block boundaries
+    void processCommands();
+    void applySfx(int sfx, int channel, int offset);
+    void applyMusic(int pattern, int16_t fade_len, int16_t mask);
+    void applyReset(uint32_t noiseSeed);
+    void publishStats();
+
     void set_music_pattern(int pattern);
+    //renders count (<= AUDIO_FX_BLOCK_SIZE) samples of each channel into
+    //_channelBlock with the hardware effects applied
+    void renderBlock(size_t count, int channelCount);
+    //one sample of every channel through getSampleForChannel
+    void renderInterleaved(size_t index, int channelCount);
+    //advances music by up to count samples, stopping before the sample that
+    //needs the per sample path (pattern change, fade). returns samples advanced
+    size_t advanceMusic(size_t count, int channelCount);
+    void renderChannel(int channel, int16_t* out, size_t count);
+    //renders the part of the current note that has no crossfade or pattern
+    //boundary in it. returns samples written, 0 if the next sample needs getSampleForSfx
+    size_t renderNoteRun(rawSfxChannel &channel, int16_t* out, size_t count);
+    //fills run with the volume and waveform of up to count samples of the
+    //current note, the same way getSampleForSfx would. freqShift is per sample
+    //and may be NULL. returns samples filled
+    size_t fillNoteRun(rawSfxChannel &channel, NoteRun &run, size_t count, const float* freqShift);
+    //points a custom instrument's child channel at the start of instrument sfx
+    void startCustomInstrument(rawSfxChannel &childChannel, int sfx);
     
     public:
     float getSampleForSfx(rawSfxChannel &channel, float freqShift = 1.0f);
@@ -100,7 +157,15 @@ class Audio {
     public:
     Audio(PicoRam* memory);
 
-    void resetAudioState();
+    //hosts that call FillAudioBuffer from an audio callback thread turn this
+    //on before starting the device. sfx(), music() and resets are then queued
+    //and applied by the renderer instead of touching the channels directly.
+    //turning it off applies anything still queued; nothing may be rendering then
+    void setThreadedRendering(bool threaded);
+
+    //noiseSeed seeds every channel's noise prng, so a given cart always
+    //renders the same samples
+    void resetAudioState(uint32_t noiseSeed = NOISE_DEFAULT_SEED);
     audioState_t* getAudioState();
 
     void api_sfx(int sfx, int channel, int offset);
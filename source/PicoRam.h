@@ -131,9 +131,24 @@ struct musicChannel {
 	uint8_t length = 0;
 };
 
+//xorshift state and brown noise filter for INST_NOISE. kept per note so
+//channels (and the two notes of a crossfade) don't disturb each other
+#define NOISE_DEFAULT_SEED 0x2545f491
+
+struct noiseState {
+    uint32_t rng = NOISE_DEFAULT_SEED;
+    float lastadvance = 0;
+    float sample = 0;
+    float lsample = 0;
+};
+
 struct noteChannel {
     float phi = 0;
-    note n;
+    note n = {};
+    noiseState noise;
+    //key_to_freq of freqKey, only recalculated when the key changes
+    uint8_t freqKey = 255;
+    float freq = 440.f;
 };
 
 struct rawSfxChannel {
@@ -0,0 +1,36 @@
+#include "audioCommandQueue.h"
+
+AudioCommandQueue::AudioCommandQueue() {
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+}
+
+bool AudioCommandQueue::push(const AudioCommand& command) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+
+    if (head - tail >= AUDIO_COMMAND_QUEUE_SIZE) {
+        return false;
+    }
+
+    _commands[head & (AUDIO_COMMAND_QUEUE_SIZE - 1)] = command;
+    //publishes the slot contents along with the new head
+    _head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool AudioCommandQueue::pop(AudioCommand* command) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t head = _head.load(std::memory_order_acquire);
+
+    if (tail == head) {
+        return false;
+    }
+
+    *command = _commands[tail & (AUDIO_COMMAND_QUEUE_SIZE - 1)];
+    //hands the slot back to the producer once it has been copied out
+    _tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+//sfx()/music() calls from the lua thread to the audio renderer. single
+//producer, single consumer and lock free, so the audio callback never waits
+
+//must be a power of two
+#define AUDIO_COMMAND_QUEUE_SIZE 256
+//how long a reset or stop waits for room in a full queue before it is dropped
+#define AUDIO_COMMAND_WAIT_MS 250
+
+enum AudioCommandType {
+    AUDIO_CMD_SFX = 0,
+    AUDIO_CMD_MUSIC,
+    AUDIO_CMD_RESET
+};
+
+struct AudioCommand {
+    uint8_t type;
+    //sfx: sfx, channel, offset. music: pattern, fade_len, mask
+    int32_t args[3];
+};
+
+class AudioCommandQueue {
+    AudioCommand _commands[AUDIO_COMMAND_QUEUE_SIZE];
+    //only written by the producer
+    std::atomic<uint32_t> _head;
+    //only written by the consumer
+    std::atomic<uint32_t> _tail;
+
+    public:
+    AudioCommandQueue();
+
+    //producer side. returns false (and drops the command) when full
+    bool push(const AudioCommand& command);
+    //consumer side. returns false when empty
+    bool pop(AudioCommand* command);
+};
@@ -0,0 +1,99 @@
+#include <string.h>
+
+#include "audioEffects.h"
+
+//one pole lowpass at roughly 2khz for 22050hz output: 1 - exp(-2 * pi * 2000 / 22050)
+#define LOWPASS_COEFF 0.434f
+
+void resetChannelFx(ChannelFxState* state) {
+    memset(state, 0, sizeof(ChannelFxState));
+}
+
+static inline int16_t clampSample(int32_t sample) {
+    if (sample > 0x7fff) return 0x7fff;
+    if (sample < -0x8000) return -0x8000;
+    return (int16_t)sample;
+}
+
+//drops the sample to a handful of levels and scales it back up, same as the old inline version
+static void applyDistort(int16_t* samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = clampSample(samples[i] / 0x1000 * 0x1249);
+    }
+}
+
+static void applyLowpass(ChannelFxState* state, int16_t* samples, size_t count) {
+#ifdef ENABLE_AUDIO_OPTIMIZATIONS
+    static const fixed_t coeff = FLOAT_TO_FIXED(LOWPASS_COEFF);
+    fixed_t y = state->lowpassState;
+    for (size_t i = 0; i < count; i++) {
+        //a full scale step is 65535 << 16, which doesn't fit in 32 bits
+        int64_t diff = (int64_t)samples[i] * FIXED_POINT_ONE - y;
+        y += (fixed_t)((diff * coeff) >> FIXED_POINT_SHIFT);
+        samples[i] = (int16_t)FIXED_TO_INT(y);
+    }
+#else
+    float y = state->lowpassState;
+    for (size_t i = 0; i < count; i++) {
+        y += (samples[i] - y) * LOWPASS_COEFF;
+        samples[i] = (int16_t)y;
+    }
+#endif
+    state->lowpassState = y;
+}
+
+//feedback comb: out = in + delayed / 2, and out goes back into the delay line
+static void applyReverb(ChannelFxState* state, int16_t* samples, size_t count) {
+    int pos = state->reverbPos;
+    for (size_t i = 0; i < count; i++) {
+        int16_t delayed = state->reverbLine[pos];
+#ifdef ENABLE_AUDIO_OPTIMIZATIONS
+        int16_t out = clampSample(samples[i] + (delayed >> 1));
+#else
+        int16_t out = clampSample((int32_t)(samples[i] + delayed * 0.5f));
+#endif
+        state->reverbLine[pos] = out;
+        samples[i] = out;
+
+        if (++pos == AUDIO_FX_REVERB_DELAY) {
+            pos = 0;
+        }
+    }
+    state->reverbPos = pos;
+}
+
+void applyChannelFx(
+    ChannelFxState* state,
+    int16_t* samples,
+    size_t count,
+    bool distort,
+    bool lowpass,
+    bool reverb)
+{
+    if (distort) {
+        applyDistort(samples, count);
+    }
+
+    if (lowpass) {
+        applyLowpass(state, samples, count);
+    }
+    else if (count > 0) {
+        //keep the filter following the signal so turning it on doesn't click
+#ifdef ENABLE_AUDIO_OPTIMIZATIONS
+        state->lowpassState = INT_TO_FIXED(samples[count - 1]);
+#else
+        state->lowpassState = samples[count - 1];
+#endif
+    }
+
+    if (reverb) {
+        applyReverb(state, samples, count);
+        state->reverbActive = true;
+    }
+    else if (state->reverbActive) {
+        //drop the tail so re-enabling reverb doesn't replay stale audio
+        memset(state->reverbLine, 0, sizeof(state->reverbLine));
+        state->reverbPos = 0;
+        state->reverbActive = false;
+    }
+}
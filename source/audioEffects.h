@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "audioOptimizations.h"
+
+//hardware effects from 0x5f40..0x5f43, each a 4 bit channel mask.
+//the Audio class renders channels in blocks and runs these over each block
+
+//samples rendered per channel before effects and mixing
+#define AUDIO_FX_BLOCK_SIZE 256
+
+//comb filter delay; two sfx speed units at 22050hz
+#define AUDIO_FX_REVERB_DELAY 366
+
+struct ChannelFxState {
+    int16_t reverbLine[AUDIO_FX_REVERB_DELAY];
+    int reverbPos;
+    bool reverbActive;
+
+#ifdef ENABLE_AUDIO_OPTIMIZATIONS
+    //Q16.16, so soft float MIPS builds stay in integer math
+    fixed_t lowpassState;
+#else
+    float lowpassState;
+#endif
+
+    //half rate: every generated sample is played twice
+    int16_t halfRateHeld;
+    bool halfRateSkip;
+};
+
+void resetChannelFx(ChannelFxState* state);
+
+//distortion, lowpass and reverb applied in place, in that order
+void applyChannelFx(
+    ChannelFxState* state,
+    int16_t* samples,
+    size_t count,
+    bool distort,
+    bool lowpass,
+    bool reverb);
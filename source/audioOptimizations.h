@@ -93,7 +93,7 @@ public:
     // Fast fmod for values in range [0, 1] with 0.01 precision
     static inline float FastFmod1(float x) {
         if (!s_initialized) Initialize();
-        if (x < 0.0f || x > 1.0f) return fmod(x, 1.0f); // fallback
+        if (x < 0.0f || x > 1.0f) return fast_fmod_1(x); // exact, same as fmod(x, 1.0f)
         int index = (int)(x * 100.0f);
         if (index >= 101) index = 100;
         return s_fmodLUT[index];
@@ -225,17 +225,28 @@ inline float key_to_freq_optimized(float key) {
 
 #else
 // Basic optimizations even without full optimization suite
+
+// fmod(x, 1) and floor(x) without the libm calls. both are exact, so
+// they give the same results as the calls they replace
+inline float fast_fmod_1(float x) {
+    return x - (int)x;
+}
+
+inline int fast_floor_int(float x) {
+    return (int)x - (x < (int)x ? 1 : 0);
+}
+
 #define key_to_freq_optimized(key) (440.0f * std::pow(2.0f, ((key) - 33.0f) / 12.0f))
 #define FAST_MOD_2(x) ((x) & 1)
 #define FAST_MOD_4(x) ((x) & 3) 
 #define FAST_MOD_8(x) ((x) & 7)
 #define FAST_MOD_16(x) ((x) & 15)
-#define fast_fmod(x, y) fmod(x, y)
+#define fast_fmod(x, y) ((y) == 1.0f ? fast_fmod_1(x) : fmod(x, y))
 #define fast_fabs(x) fabs(x)
 #define fast_div7(volume) ((volume) / 7.0f)
 #define fast_div183(speed) ((speed) / 183.0f)
 #define fast_sine(x) sin((x) * 2.0f * M_PI)
-#define fast_floor(x) floor(x)
+#define fast_floor(x) fast_floor_int(x)
 #define fast_mul2(x) ((x) * 2.0f)
 #define fast_mul4(x) ((x) * 4.0f)
 #define fast_div2(x) ((x) * 0.5f)
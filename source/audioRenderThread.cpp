@@ -0,0 +1,200 @@
+#include <string.h>
+
+#include <chrono>
+
+#include "audioRenderThread.h"
+#include "Audio.h"
+
+//the renderer's own block size, so every render is one processCommands/effects pass
+#define RENDER_CHUNK AUDIO_FX_BLOCK_SIZE
+
+AudioRenderThread::AudioRenderThread(Audio* audio, int sampleRate) {
+    _audio = audio;
+    _sampleRate = sampleRate;
+
+    _ring = nullptr;
+    _capacity = 0;
+    _target = 0;
+    _lookaheadMs = 0;
+
+    _written.store(0);
+    _read.store(0);
+    _running.store(false);
+    _paused.store(false);
+    _rendering.store(false);
+    _underruns.store(0);
+    _overruns.store(0);
+}
+
+AudioRenderThread::~AudioRenderThread() {
+    stop();
+
+    if (_ring != nullptr) {
+        delete[] _ring;
+    }
+}
+
+bool AudioRenderThread::start(int lookaheadMs) {
+#if AUDIO_RENDER_THREAD_SUPPORTED
+    stop();
+
+    uint32_t target = (uint32_t)(_sampleRate * lookaheadMs / 1000);
+    if (target < RENDER_CHUNK * 2) {
+        target = RENDER_CHUNK * 2;
+    }
+
+    uint32_t capacity = RENDER_CHUNK;
+    while (capacity < target + RENDER_CHUNK) {
+        capacity <<= 1;
+    }
+
+    if (capacity != _capacity) {
+        if (_ring != nullptr) {
+            delete[] _ring;
+        }
+        _ring = new uint32_t[capacity];
+        _capacity = capacity;
+    }
+    _target = target;
+    _lookaheadMs = lookaheadMs;
+
+    _written.store(0);
+    _read.store(0);
+    _underruns.store(0);
+    _overruns.store(0);
+    _paused.store(false);
+
+    //sfx()/music() have to go through the command queue while another thread renders
+    _audio->setThreadedRendering(true);
+
+    _running.store(true);
+    _thread = std::thread(&AudioRenderThread::run, this);
+
+    return true;
+#else
+    (void)lookaheadMs;
+    return false;
+#endif
+}
+
+void AudioRenderThread::stop() {
+#if AUDIO_RENDER_THREAD_SUPPORTED
+    if (!_running.load()) {
+        return;
+    }
+
+    _running.store(false);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+
+    //nothing renders concurrently any more, sfx()/music() can apply directly again
+    _audio->setThreadedRendering(false);
+#endif
+}
+
+bool AudioRenderThread::isRunning() {
+    return _running.load();
+}
+
+void AudioRenderThread::pause() {
+    //seq_cst on both flags: either the worker sees _paused before it starts a
+    //chunk, or we see _rendering and wait until the chunk is in the ring
+    _paused.store(true);
+    while (_rendering.load()) {
+#if AUDIO_RENDER_THREAD_SUPPORTED
+        std::this_thread::yield();
+#endif
+    }
+}
+
+void AudioRenderThread::resume() {
+    _paused.store(false);
+}
+
+void AudioRenderThread::flush() {
+    _read.store(_written.load());
+}
+
+size_t AudioRenderThread::read(void* dest, size_t samples) {
+    uint32_t* out = (uint32_t*)dest;
+
+    uint32_t readPos = _read.load(std::memory_order_relaxed);
+    uint32_t available = _written.load(std::memory_order_acquire) - readPos;
+    size_t count = samples < available ? samples : available;
+
+    for (size_t i = 0; i < count; i++) {
+        out[i] = _ring[(readPos + i) & (_capacity - 1)];
+    }
+    _read.store(readPos + (uint32_t)count, std::memory_order_release);
+
+    if (count < samples) {
+        memset(out + count, 0, (samples - count) * sizeof(uint32_t));
+        _underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return count;
+}
+
+uint32_t AudioRenderThread::getUnderruns() {
+    return _underruns.load(std::memory_order_relaxed);
+}
+
+uint32_t AudioRenderThread::getOverruns() {
+    return _overruns.load(std::memory_order_relaxed);
+}
+
+uint32_t AudioRenderThread::getBufferedSamples() {
+    return _written.load(std::memory_order_relaxed) - _read.load(std::memory_order_relaxed);
+}
+
+int AudioRenderThread::getLookaheadMs() {
+    return _lookaheadMs;
+}
+
+void AudioRenderThread::run() {
+#if AUDIO_RENDER_THREAD_SUPPORTED
+    uint32_t chunk[RENDER_CHUNK];
+
+    //stall tracking for the overrun counter
+    uint32_t idleReadPos = 0;
+    bool idle = false;
+    auto idleSince = std::chrono::steady_clock::now();
+
+    while (_running.load(std::memory_order_relaxed)) {
+        uint32_t writePos = _written.load(std::memory_order_relaxed);
+        uint32_t readPos = _read.load(std::memory_order_acquire);
+
+        if (writePos - readPos + RENDER_CHUNK > _target || _paused.load()) {
+            if (!idle || readPos != idleReadPos) {
+                idle = true;
+                idleReadPos = readPos;
+                idleSince = std::chrono::steady_clock::now();
+            }
+            else if (std::chrono::steady_clock::now() - idleSince >= std::chrono::milliseconds(_lookaheadMs)) {
+                _overruns.fetch_add(1, std::memory_order_relaxed);
+                idleSince = std::chrono::steady_clock::now();
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        idle = false;
+
+        _rendering.store(true);
+        if (_paused.load()) {
+            _rendering.store(false);
+            continue;
+        }
+        _audio->FillAudioBuffer(chunk, 0, RENDER_CHUNK);
+
+        for (uint32_t i = 0; i < RENDER_CHUNK; i++) {
+            _ring[(writePos + i) & (_capacity - 1)] = chunk[i];
+        }
+        //publishes the samples along with the new count
+        _written.store(writePos + RENDER_CHUNK, std::memory_order_release);
+        //only now, so a flush() after pause() can't miss this chunk
+        _rendering.store(false);
+    }
+#endif
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#if !defined(SF2000) && !defined(FAKE08_NO_THREADS)
+#define AUDIO_RENDER_THREAD_SUPPORTED 1
+#include <thread>
+#endif
+
+class Audio;
+
+//renders Audio output on a worker thread into a lock free ring, a set number
+//of milliseconds ahead of the frame loop. for hosts that push audio from the
+//frame (Vm::GameLoop's shouldFillAudioBuff path, libretro), so a long _draw
+//eats into the lookahead instead of turning straight into an underrun.
+//samples are stereo, packed the same way Audio::FillAudioBuffer writes them
+class AudioRenderThread {
+    Audio* _audio;
+    int _sampleRate;
+
+    uint32_t* _ring;
+    //power of two
+    uint32_t _capacity;
+    //samples the worker keeps buffered
+    uint32_t _target;
+    int _lookaheadMs;
+
+    //running sample counts; written - read is what is buffered
+    std::atomic<uint32_t> _written;
+    std::atomic<uint32_t> _read;
+
+    std::atomic<bool> _running;
+    std::atomic<bool> _paused;
+    std::atomic<bool> _rendering;
+
+    std::atomic<uint32_t> _underruns;
+    std::atomic<uint32_t> _overruns;
+
+#if AUDIO_RENDER_THREAD_SUPPORTED
+    std::thread _thread;
+#endif
+
+    void run();
+
+    public:
+    AudioRenderThread(Audio* audio, int sampleRate);
+    ~AudioRenderThread();
+
+    //false if threads aren't available on this platform
+    bool start(int lookaheadMs);
+    //also turns Audio's threaded rendering back off
+    void stop();
+    bool isRunning();
+
+    //waits until the worker is outside the renderer and has published what it
+    //rendered. Audio state can be read or written from the calling thread until resume()
+    void pause();
+    void resume();
+    //drops everything buffered, e.g. after loading a state. only while paused
+    void flush();
+
+    //copies out up to samples stereo samples; a short ring is padded with
+    //silence and counted as an underrun. returns the samples that were real audio
+    size_t read(void* dest, size_t samples);
+
+    //reads that ran dry (raise the lookahead)
+    uint32_t getUnderruns();
+    //lookahead windows the frame loop went without reading anything, e.g. a
+    //stalled or paused host. audio read after one is at least that stale
+    uint32_t getOverruns();
+    uint32_t getBufferedSamples();
+    int getLookaheadMs();
+};
@@ -0,0 +1,153 @@
+#include <math.h>
+#include <string.h>
+
+#include "audioResampler.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define HISTORY_FRAMES (AUDIO_RESAMPLER_TAPS - 1)
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double sinc(double x) {
+    if (fabs(x) < 1e-9) {
+        return 1.0;
+    }
+    return sin(M_PI * x) / (M_PI * x);
+}
+
+//blackman, x in -1..1
+static double window(double x) {
+    return 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2 * M_PI * x);
+}
+
+AudioResampler::AudioResampler() {
+    _inputRate = 0;
+    _outputRate = 0;
+    _phases = 1;
+    _step = 1;
+    _pos = 0;
+    _phase = 0;
+}
+
+bool AudioResampler::configure(int inputRate, int outputRate) {
+    if (inputRate <= 0 || outputRate <= 0) {
+        return false;
+    }
+
+    uint32_t divisor = gcd((uint32_t)inputRate, (uint32_t)outputRate);
+    uint32_t phases = (uint32_t)outputRate / divisor;
+    if (phases > AUDIO_RESAMPLER_MAX_PHASES) {
+        return false;
+    }
+
+    _inputRate = inputRate;
+    _outputRate = outputRate;
+    _phases = phases;
+    _step = (uint32_t)inputRate / divisor;
+
+    //cutoff a bit under the lower nyquist so the transition band stays out of the images
+    double cutoff = 0.42 * (outputRate < inputRate ? (double)outputRate / inputRate : 1.0);
+
+    _filter.assign(_phases * AUDIO_RESAMPLER_TAPS, 0.0f);
+    for (uint32_t p = 0; p < _phases; p++) {
+        float* row = &_filter[p * AUDIO_RESAMPLER_TAPS];
+        double frac = (double)p / _phases;
+        double sum = 0;
+
+        for (int k = 0; k < AUDIO_RESAMPLER_TAPS; k++) {
+            //distance from the output position to this tap
+            double d = k - (AUDIO_RESAMPLER_HALF_TAPS - 1) - frac;
+            double h = 2 * cutoff * sinc(2 * cutoff * d) * window(d / AUDIO_RESAMPLER_HALF_TAPS);
+            row[k] = (float)h;
+            sum += h;
+        }
+
+        //unity gain at dc for every phase, otherwise the phases beat against each other
+        for (int k = 0; k < AUDIO_RESAMPLER_TAPS; k++) {
+            row[k] = (float)(row[k] / sum);
+        }
+    }
+
+    reset();
+
+    return true;
+}
+
+void AudioResampler::reset() {
+    _work.assign(HISTORY_FRAMES * 2, 0.0f);
+    _pos = 0;
+    _phase = 0;
+}
+
+int AudioResampler::getInputRate() {
+    return _inputRate;
+}
+
+int AudioResampler::getOutputRate() {
+    return _outputRate;
+}
+
+size_t AudioResampler::maxOutputFrames(size_t inputFrames) {
+    return (inputFrames * _phases + _step - 1) / _step + 1;
+}
+
+size_t AudioResampler::process(const int16_t* input, size_t inputFrames, int16_t* output) {
+    if (_filter.empty()) {
+        return 0;
+    }
+
+    _work.resize((HISTORY_FRAMES + inputFrames) * 2);
+    float* work = _work.data();
+    for (size_t i = 0; i < inputFrames * 2; i++) {
+        work[HISTORY_FRAMES * 2 + i] = input[i];
+    }
+
+    //frame index in work that lines up with input frame 0
+    const int base = HISTORY_FRAMES;
+    //last position whose taps are all inside the input
+    const int last = (int)inputFrames - AUDIO_RESAMPLER_HALF_TAPS - 1;
+    size_t written = 0;
+
+    while (_pos <= last) {
+        const float* row = &_filter[_phase * AUDIO_RESAMPLER_TAPS];
+        const float* src = work + (base + _pos - (AUDIO_RESAMPLER_HALF_TAPS - 1)) * 2;
+
+        float left = 0;
+        float right = 0;
+        for (int k = 0; k < AUDIO_RESAMPLER_TAPS; k++) {
+            left += src[k * 2] * row[k];
+            right += src[k * 2 + 1] * row[k];
+        }
+
+        int32_t l = (int32_t)lrintf(left);
+        int32_t r = (int32_t)lrintf(right);
+        if (l > 0x7fff) l = 0x7fff; else if (l < -0x8000) l = -0x8000;
+        if (r > 0x7fff) r = 0x7fff; else if (r < -0x8000) r = -0x8000;
+        output[written * 2] = (int16_t)l;
+        output[written * 2 + 1] = (int16_t)r;
+        written++;
+
+        _phase += _step;
+        while (_phase >= _phases) {
+            _phase -= _phases;
+            _pos++;
+        }
+    }
+
+    //keep the tail as history for the next call
+    memmove(work, work + inputFrames * 2, HISTORY_FRAMES * 2 * sizeof(float));
+    _work.resize(HISTORY_FRAMES * 2);
+    _pos -= (int)inputFrames;
+
+    return written;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+//polyphase windowed sinc resampler for stereo int16 frames, used by hosts
+//that want to hand their frontend a standard rate instead of 22050hz.
+//works on exact rational ratios, so no drift between the two clocks
+
+#define AUDIO_RESAMPLER_HALF_TAPS 16
+#define AUDIO_RESAMPLER_TAPS (AUDIO_RESAMPLER_HALF_TAPS * 2)
+//phases = output rate / gcd(input rate, output rate); 22050 -> 48000 needs 320
+#define AUDIO_RESAMPLER_MAX_PHASES 1024
+
+class AudioResampler {
+    int _inputRate;
+    int _outputRate;
+
+    //each output advances _step / _phases input frames
+    uint32_t _phases;
+    uint32_t _step;
+    //_phases rows of AUDIO_RESAMPLER_TAPS coefficients
+    std::vector<float> _filter;
+
+    //interleaved stereo: AUDIO_RESAMPLER_TAPS - 1 history frames, then the input
+    std::vector<float> _work;
+    //next output position, in input frames relative to the start of the next input
+    int _pos;
+    uint32_t _phase;
+
+    public:
+    AudioResampler();
+
+    //false if the ratio needs more than AUDIO_RESAMPLER_MAX_PHASES
+    bool configure(int inputRate, int outputRate);
+    //clears the history, e.g. after a state load
+    void reset();
+
+    int getInputRate();
+    int getOutputRate();
+
+    //upper bound on what one process() call can write for inputFrames
+    size_t maxOutputFrames(size_t inputFrames);
+    //returns output frames written. output lags input by about AUDIO_RESAMPLER_HALF_TAPS input frames
+    size_t process(const int16_t* input, size_t inputFrames, int16_t* output);
+};
@@ -1,5 +1,4 @@
 #include <string>
-#include <sstream>
 #include <cstring>
 #include <vector>
 #include <stack>
@@ -10,6 +9,8 @@
 #include "lodepng.h"
 
 #include "cart.h"
+#include "cartCache.h"
+#include "pngCartDecoder.h"
 #include "filehelpers.h"
 
 #include "stringToDataHelpers.h"
@@ -150,59 +151,15 @@ static std::string pxa_decompress(uint8_t const *input)
 
 #define HEADERLEN 8
 
-bool Cart::loadCartFromPng(std::vector<unsigned char> image) {
-        //160x205 == 32800 == 0x8020
-    //0x8000 is actual used data size
-    size_t imageBytes = image.size();
-
-    uint8_t version = 0;
-
-    for(size_t i = 0; i < imageBytes; i += 4) {
-        //get argb values
-        uint8_t r = image[i];
-        uint8_t g = image[i + 1];
-        uint8_t b = image[i + 2];
-        uint8_t a = image[i + 3];
-
-        //get lower bits where pico data is encoded
-        a = a & 0x0003;
-        r = r & 0x0003;
-		g = g & 0x0003;
-		b = b & 0x0003;
-
-        uint8_t extractedByte = (a << 6) + (r << 4) + (g << 2) + b;
-
-        //TODO: write this all to one array, then memcpy to picoram?
-        //store extracted byte in correct place
-        size_t picoDataIdx = i / 4;
-        if (picoDataIdx < 0x2000) {
-            CartRom.SpriteSheetData[picoDataIdx] = extractedByte;
-        }
-        else if (picoDataIdx < 0x3000) {
-            CartRom.MapData[picoDataIdx - 0x2000] = extractedByte;
-        }
-        else if (picoDataIdx < 0x3100) {
-            CartRom.SpriteFlagsData[picoDataIdx - 0x3000] = extractedByte;
-        }
-        else if (picoDataIdx < 0x3200) {
-            size_t offset = picoDataIdx - 0x3100;
-            size_t songIdx = offset / sizeof(song);
-            size_t channelIdx = offset % sizeof(song);
-            CartRom.SongData[songIdx].data[channelIdx] = extractedByte;
-        }
-        else if (picoDataIdx < 0x4300) {
-            size_t offset = picoDataIdx - 0x3200;
-            size_t sfxIdx = offset / sizeof(sfx);
-            size_t byteIdx = offset % sizeof(sfx);
-            CartRom.SfxData[sfxIdx].data[byteIdx] = extractedByte;
-        }
-        else if (picoDataIdx < 0x8000) {
-            CartLuaData[picoDataIdx - 0x4300] = extractedByte;
-        }
-        else if (picoDataIdx == 0x8000) {
-            version = extractedByte;
-        }
-    }
+static_assert(sizeof(CartRomData) == 0x4300, "png cart data is copied straight into the rom struct");
+
+bool Cart::loadCartFromPngData(const uint8_t* data) {
+    //160x205 == 32800 == 0x8020
+    //0x8000 is actual used data size. the rom struct has the same layout as
+    //the start of the data, and the code follows it
+    memcpy(CartRom.data, data, sizeof(CartRom.data));
+    memcpy(CartLuaData, data + sizeof(CartRom.data), 0x8000 - sizeof(CartRom.data));
+    uint8_t version = data[0x8000];
 
     uint8_t compression = 0;
 
@@ -276,6 +233,14 @@ bool Cart::loadCartFromPng(std::vector<unsigned char> image) {
 }
 
 bool Cart::loadCartFromPng(const unsigned char* cartData, size_t size){
+    std::vector<uint8_t> data(PNG_CART_DATA_SIZE);
+
+    if (decodePngCartData(cartData, size, data.data())) {
+        return loadCartFromPngData(data.data());
+    }
+
+    //not a png the streaming decoder handles (or not a valid one). let lodepng
+    //sort it out and report any errors
     std::vector<unsigned char> image; //the raw pixels
     unsigned width, height;
 
@@ -289,65 +254,108 @@ bool Cart::loadCartFromPng(const unsigned char* cartData, size_t size){
         return false;
     }
 
-    if (width != 160 || height != 205) {
+    if (width != PNG_CART_WIDTH || height != PNG_CART_HEIGHT) {
         LoadError = "Invalid png dimensions";
         Logger_Write("invalid dimensions\n");
         return false;
     }
 
-    return loadCartFromPng(image);
+    extractPngCartBytes(image.data(), PNG_CART_DATA_SIZE, data.data());
+
+    return loadCartFromPngData(data.data());
 }
 
 
 bool Cart::loadCartFromPng(std::string filename){
-    std::vector<unsigned char> image; //the raw pixels
-    unsigned width, height;
+    std::vector<char> contents = get_file_as_buffer(filename);
 
-    //decode
-    unsigned error = lodepng::decode(image, width, height, filename);
-    //the pixels are now in the vector "image", 4 bytes per pixel, ordered RGBARGBA..., use it as texture, draw it,
+    return loadCartFromPng(reinterpret_cast<const unsigned char*>(contents.data()), contents.size());
+}
 
-    //if there's an error, display it
-    if(error) {
-        LoadError = "png decoder error " + std::string(lodepng_error_text(error));
-        Logger_Write("%s%s", LoadError.c_str(), "\n");
+//next line of text starting at pos, without its line ending. false at the end of text
+static bool nextLine(std::string_view text, size_t& pos, std::string_view& line) {
+    if (pos >= text.length()) {
         return false;
     }
 
-    if (width != 160 || height != 205) {
-        LoadError = "Invalid png dimensions";
-        Logger_Write("invalid dimensions\n");
-        return false;
+    size_t eol = text.find('\n', pos);
+    if (eol == std::string_view::npos) {
+        eol = text.length();
     }
 
-    return loadCartFromPng(image);
+    line = text.substr(pos, eol - pos);
+    pos = eol + 1;
+    return true;
 }
 
-bool Cart::loadCartFromString(std::string cartStr) {
-    fullCartText = cartStr;
+static std::string_view trimLineEnd(std::string_view line) {
+    size_t last = line.find_last_not_of(" \n\r");
+    return last == std::string_view::npos ? std::string_view() : line.substr(0, last + 1);
+}
 
-    std::istringstream s(cartStr);
-    std::string line;
-    std::string currSec = "";
+bool Cart::loadCartFromString(std::string cartStr) {
+    fullCartText = std::move(cartStr);
+    std::string_view text(fullCartText);
+
+    //one pass over the text finding section boundaries. data sections are
+    //decoded straight out of the text, only lua gets copied
+    std::string_view currSec;
+    size_t sectionStart = 0;
+    size_t pos = 0;
+    size_t lineStart = 0;
+    std::string_view line;
+    std::string lua;
     std::smatch sm;
-    
-    while (std::getline(s, line)) {
-        line = utils::trimright(line, " \n\r");
-        line = charset::utf8_to_pico8(line);
-        //line = convert_emojis(line);
+
+    auto endSection = [&](size_t sectionEnd) {
+        std::string_view body = text.substr(sectionStart, sectionEnd - sectionStart);
+
+        if (currSec == "__gfx__"){
+            SpriteSheetString = body;
+        }
+        else if (currSec == "__gff__"){
+            SpriteFlagsString = body;
+        }
+        else if (currSec == "__map__"){
+            MapString = body;
+        }
+        else if (currSec == "__sfx__"){
+            SfxString = body;
+        }
+        else if (currSec == "__music__"){
+            MusicString = body;
+        }
+        else if (currSec == "__label__"){
+            LabelString = body;
+        }
+    };
+
+    while (nextLine(text, pos, line)) {
+        line = trimLineEnd(line);
 
         if (line.length() > 2 && line[0] == '_' && line[1] == '_') {
+            endSection(lineStart);
             currSec = line;
+            sectionStart = std::min(pos, text.length());
         }
         else if (currSec == "__lua__"){
-            if (std::regex_match(line, sm, _includeRegex)) {
+            //sm points into lineStr, so it has to outlive the match
+            std::string lineStr;
+            bool isInclude = false;
+            if (line.find("#include") != std::string_view::npos) {
+                lineStr = std::string(line);
+                isInclude = std::regex_match(lineStr, sm, _includeRegex);
+            }
+
+            if (isInclude) {
                 auto dir = getDirectory(FullCartPath);
                 auto fullPath = dir + "/" + sm[1].str();
 
                 auto includeContents = get_file_contents(fullPath);
+                _cacheable = false;
                 if (includeContents.length() > 0){
-                    includeContents = charset::utf8_to_pico8(includeContents);
-                    LuaString += includeContents + "\n";
+                    lua += includeContents;
+                    lua += '\n';
                 }
                 else{
                     //todo: report error
@@ -357,28 +365,18 @@ bool Cart::loadCartFromString(std::string cartStr) {
                 }
             }
             else {
-                LuaString += line + "\n";
+                lua += line;
+                lua += '\n';
             }
         }
-        else if (currSec == "__gfx__"){
-            SpriteSheetString += line + "\n";
-        }
-        else if (currSec == "__gff__"){
-            SpriteFlagsString += line + "\n";
-        }
-        else if (currSec == "__map__"){
-            MapString += line + "\n";
-        }
-        else if (currSec == "__sfx__"){
-            SfxString += line + "\n";
-        }
-        else if (currSec == "__music__"){
-            MusicString += line + "\n";
-        }
-        else if (currSec == "__label__"){
-            LabelString += line + "\n";
-        }
+
+        lineStart = std::min(pos, text.length());
     }
+    endSection(text.length());
+
+    //glyphs never span a line break, so converting the whole section at once
+    //gives the same result as converting line by line
+    LuaString = charset::utf8_to_pico8(lua);
 
     Logger_Write("Setting cart graphics rom data from strings\n");
     setSpriteSheet(SpriteSheetString);
@@ -392,7 +390,36 @@ bool Cart::loadCartFromString(std::string cartStr) {
     return true;
 }
 
+bool Cart::loadCartFromCache(const unsigned char* cartData, size_t size){
+    if (getCartCacheDirectory().length() == 0 || size == 0) {
+        return false;
+    }
+
+    _contentHash = hashCartContents(cartData, size);
+    if (readCartCache(_contentHash, &CartRom, &LuaString, &fullCartText)) {
+        LabelString = fullCartText;
+        Logger_Write("loaded cart from cart cache\n");
+        return true;
+    }
+
+    _cacheable = true;
+    return false;
+}
+
+void Cart::saveCartToCache(){
+    if (!_cacheable || LuaString.length() == 0) {
+        return;
+    }
+
+    if (!writeCartCache(_contentHash, CartRom, LuaString, LabelString)) {
+        Logger_Write("could not write cart cache entry\n");
+    }
+}
+
 Cart::Cart (const unsigned char* cartData, size_t size){
+    _contentHash = 0;
+    _cacheable = false;
+
     if (size < 5) {
         LoadError = "Invalid cart. Less than 5 bytes";
         return;
@@ -403,6 +430,10 @@ Cart::Cart (const unsigned char* cartData, size_t size){
         (char)cartData[1] == 'P' && 
         (char)cartData[2] == 'N' && 
         (char)cartData[3] == 'G') {
+        if (loadCartFromCache(cartData, size)) {
+            return;
+        }
+
         bool success = loadCartFromPng(cartData, size);
 
         if (!success){
@@ -410,20 +441,26 @@ Cart::Cart (const unsigned char* cartData, size_t size){
         }
         LoadError = "";
         Logger_Write("got valid png cart\n");
+        saveCartToCache();
     }
     else if((char)cartData[0] == 'p' &&
          (char)cartData[1] == 'i' && 
          (char)cartData[2] == 'c' && 
          (char)cartData[3] == 'o') {
+        if (loadCartFromCache(cartData, size)) {
+            return;
+        }
+
         std::string strContents(reinterpret_cast<const char*>(cartData), size);
 
-        bool success = loadCartFromString(strContents);
+        bool success = loadCartFromString(std::move(strContents));
 
         if (!success){
             return;
         }
         LoadError = "";
         Logger_Write("got valid p8 cart\n");
+        saveCartToCache();
     }
     else {
         LoadError = "unknown cart file format";
@@ -431,8 +468,7 @@ Cart::Cart (const unsigned char* cartData, size_t size){
 
 }
 
-//tac08 based cart parsing and stripping of emoji
-Cart::Cart(std::string filename, std::string cartDirectory){
+std::string resolveCartPath(std::string filename, std::string cartDirectory){
     //the leading # indicates it is the BBS key. In the future, it would be nice to fetch them,
     //but for now expect the user to supply the carts
     if (filename.length() > 0 && filename[0] == '#') {
@@ -444,19 +480,34 @@ Cart::Cart(std::string filename, std::string cartDirectory){
     }
 
     if (cartDirectory.length() > 0 && ! isAbsolutePath(filename)) {
-        FullCartPath = cartDirectory + "/" + filename;
-    }
-    else {
-        FullCartPath = filename;
+        return cartDirectory + "/" + filename;
     }
+
+    return filename;
+}
+
+//tac08 based cart parsing and stripping of emoji
+Cart::Cart(std::string filename, std::string cartDirectory){
+    _contentHash = 0;
+    _cacheable = false;
+
+    FullCartPath = resolveCartPath(filename, cartDirectory);
     //zero out cart rom so no garbage is left over
     initCartRom();
 
     Logger_Write("getting file contents\n");
 
+    bool builtIn = FullCartPath == "__FAKE08-BIOS.p8" || FullCartPath == "__FAKE08-SETTINGS.p8";
+    if (!builtIn && getCartCacheDirectory().length() > 0) {
+        std::vector<char> contents = get_file_as_buffer(FullCartPath);
+        if (loadCartFromCache(reinterpret_cast<const unsigned char*>(contents.data()), contents.size())) {
+            return;
+        }
+    }
+
     std::string firstFourChars = get_first_four_chars(FullCartPath);
     
-    if (FullCartPath == "__FAKE08-BIOS.p8" || FullCartPath == "__FAKE08-SETTINGS.p8" || firstFourChars == "pico"){
+    if (builtIn || firstFourChars == "pico"){
         std::string cartStr; 
 
         if (FullCartPath == "__FAKE08-BIOS.p8") {
@@ -470,11 +521,12 @@ Cart::Cart(std::string filename, std::string cartDirectory){
         }
         Logger_Write("Got file contents... parsing cart\n");
 
-        bool success = loadCartFromString(cartStr);
+        bool success = loadCartFromString(std::move(cartStr));
 
         if (!success){
             return;
         }
+        saveCartToCache();
     }
     else if (firstFourChars == "\x89PNG") {
         bool success = loadCartFromPng(FullCartPath);
@@ -485,6 +537,7 @@ Cart::Cart(std::string filename, std::string cartDirectory){
 
         LoadError = "";
         Logger_Write("got valid png cart\n");
+        saveCartToCache();
     }
     else {
         return;
@@ -514,56 +567,55 @@ void Cart::initCartRom(){
     }
 }
 
-void Cart::setSpriteSheet(std::string spritesheetstring){
+void Cart::setSpriteSheet(std::string_view spritesheetstring){
 	Logger_Write("Copying data to spritesheet\n");
 	copy_string_to_sprite_memory(CartRom.SpriteSheetData, spritesheetstring);
 }
 
-void Cart::setSpriteFlags(std::string spriteFlagsstring){
+void Cart::setSpriteFlags(std::string_view spriteFlagsstring){
 	Logger_Write("Copying data to sprite flags\n");
-	copy_string_to_memory(CartRom.SpriteFlagsData, spriteFlagsstring);
+	copy_string_to_memory(CartRom.SpriteFlagsData, spriteFlagsstring, sizeof(CartRom.SpriteFlagsData));
 }
 
-void Cart::setMapData(std::string mapDataString){
+void Cart::setMapData(std::string_view mapDataString){
 	Logger_Write("Copying data to map data\n");
-	copy_string_to_memory(CartRom.MapData, mapDataString);
+	copy_string_to_memory(CartRom.MapData, mapDataString, sizeof(CartRom.MapData));
+}
+
+//hex byte at line[i], line[i + 1]. past the end of the line reads as empty
+static uint8_t hexByteAt(std::string_view line, size_t i) {
+    char hi = i < line.length() ? line[i] : '\0';
+    char lo = i + 1 < line.length() ? line[i + 1] : '\0';
+    return hex_pair_value(hi, lo);
 }
 
-void Cart::setMusic(std::string musicString){
-    std::istringstream s(musicString);
-    std::string line;
-    char buf[3] = {0};
+static uint8_t hexNibbleAt(std::string_view line, size_t i) {
+    int val = i < line.length() ? hex_digit_value(line[i]) : -1;
+    return val < 0 ? 0 : (uint8_t)val;
+}
+
+void Cart::setMusic(std::string_view musicString){
+    std::string_view line;
+    size_t pos = 0;
     int musicIdx = 0;
     
-    while (std::getline(s, line)) {
+    while (nextLine(musicString, pos, line)) {
+        line = trimLineEnd(line);
         if (line.length() < 11){
             continue;
         }
 
-        buf[0] = line[0];
-        buf[1] = line[1];
-        uint8_t flagByte = (uint8_t)strtol(buf, NULL, 16);
+        uint8_t flagByte = hexByteAt(line, 0);
 
         uint8_t mode = (flagByte & 8) >> 3;
         uint8_t fstop = (flagByte & 4) >> 2;
         uint8_t frepeat = (flagByte & 2) >> 1;
         uint8_t fnext = flagByte & 1;
 
-        buf[0] = line[3];
-        buf[1] = line[4];
-        uint8_t channel1byte = (uint8_t)strtol(buf, NULL, 16);
-
-        buf[0] = line[5];
-        buf[1] = line[6];
-        uint8_t channel2byte = (uint8_t)strtol(buf, NULL, 16);
-
-        buf[0] = line[7];
-        buf[1] = line[8];
-        uint8_t channel3byte = (uint8_t)strtol(buf, NULL, 16);
-
-        buf[0] = line[9];
-        buf[1] = line[10];
-        uint8_t channel4byte = (uint8_t)strtol(buf, NULL, 16);
+        uint8_t channel1byte = hexByteAt(line, 3);
+        uint8_t channel2byte = hexByteAt(line, 5);
+        uint8_t channel3byte = hexByteAt(line, 7);
+        uint8_t channel4byte = hexByteAt(line, 9);
 
         CartRom.SongData[musicIdx].data[0] = channel1byte | fnext << 7;
         CartRom.SongData[musicIdx].data[1] = channel2byte | frepeat << 7;
@@ -578,10 +630,9 @@ void Cart::setMusic(std::string musicString){
 
 }
 
-void Cart::setSfx(std::string sfxString) {
-    std::istringstream s(sfxString);
-    std::string line;
-    char buf[3] = {0};
+void Cart::setSfx(std::string_view sfxString) {
+    std::string_view line;
+    size_t pos = 0;
     int sfxIdx = 0;
 
     //SFX speed defaults to 16. Everything else should be zeroed out
@@ -589,22 +640,13 @@ void Cart::setSfx(std::string sfxString) {
         CartRom.SfxData[i].speed = 16;
     }
     
-    while (std::getline(s, line)) {
-        buf[0] = line[0];
-        buf[1] = line[1];
-        uint8_t editorMode = (uint8_t)strtol(buf, NULL, 16);
-
-        buf[0] = line[2];
-        buf[1] = line[3];
-        uint8_t noteDuration = (uint8_t)strtol(buf, NULL, 16);
+    while (sfxIdx < 64 && nextLine(sfxString, pos, line)) {
+        line = trimLineEnd(line);
 
-        buf[0] = line[4];
-        buf[1] = line[5];
-        uint8_t loopRangeStart = (uint8_t)strtol(buf, NULL, 16);
-
-        buf[0] = line[6];
-        buf[1] = line[7];
-        uint8_t loopRangeEnd = (uint8_t)strtol(buf, NULL, 16);
+        uint8_t editorMode = hexByteAt(line, 0);
+        uint8_t noteDuration = hexByteAt(line, 2);
+        uint8_t loopRangeStart = hexByteAt(line, 4);
+        uint8_t loopRangeEnd = hexByteAt(line, 6);
 
         CartRom.SfxData[sfxIdx].editorMode = editorMode;
         CartRom.SfxData[sfxIdx].speed = noteDuration;
@@ -613,24 +655,12 @@ void Cart::setSfx(std::string sfxString) {
 
         //32 notes, 5 chars each
         int noteIdx = 0;
-        for (int i = 8; i < 168; i+=5) {
-            buf[0] = line[i];
-            buf[1] = line[i + 1];
-            uint8_t key = (uint8_t)strtol(buf, NULL, 16);
-            
-
-            buf[0] = '0';
-            buf[1] = line[i + 2];
-            uint8_t waveform = (uint8_t)strtol(buf, NULL, 16);
+        for (size_t i = 8; i < 168; i+=5) {
+            uint8_t key = hexByteAt(line, i);
+            uint8_t waveform = hexNibbleAt(line, i + 2);
             uint8_t custom = waveform > 7 ? 1 : 0;
-
-            buf[0] = '0';
-            buf[1] = line[i + 3];
-            uint8_t volume = (uint8_t)strtol(buf, NULL, 16);
-
-            buf[0] = '0';
-            buf[1] = line[i + 4];
-            uint8_t effect = (uint8_t)strtol(buf, NULL, 16);
+            uint8_t volume = hexNibbleAt(line, i + 3);
+            uint8_t effect = hexNibbleAt(line, i + 4);
 
             CartRom.SfxData[sfxIdx].notes[noteIdx].setKey(key);
             CartRom.SfxData[sfxIdx].notes[noteIdx].setWaveform(waveform);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "graphics.h"
@@ -23,41 +24,61 @@ struct CartRomData
     };
 };
 
+//the path Cart(filename, cartDirectory) reads from
+std::string resolveCartPath(std::string filename, std::string cartDirectory);
+
 class Cart {
+    //backing storage for the section views below
     std::string fullCartText;
 
+    //hash of the file contents, set when the cart cache is enabled
+    uint64_t _contentHash;
+    //false when the parsed result depends on more than the cart file (#include)
+    bool _cacheable;
+
     void initCartRom();
 
-    void setSpriteSheet(std::string spriteSheetString);
-	void setSpriteFlags(std::string spriteFlagsString);
-	void setMapData(std::string mapString);
+    void setSpriteSheet(std::string_view spriteSheetString);
+	void setSpriteFlags(std::string_view spriteFlagsString);
+	void setMapData(std::string_view mapString);
 
-    void setSfx(std::string sfxString);
-    void setMusic(std::string musicString);
+    void setSfx(std::string_view sfxString);
+    void setMusic(std::string_view musicString);
 
     bool loadCartFromPng(std::string filename);
     bool loadCartFromPng(const unsigned char* cartData, size_t size);
-    bool loadCartFromPng(std::vector<unsigned char> image);
+    //PNG_CART_DATA_SIZE bytes pulled out of a png cart
+    bool loadCartFromPngData(const uint8_t* data);
 
     bool loadCartFromString(std::string cartStr);
+
+    //true if the cart came out of the cart cache. otherwise remembers the
+    //hash so saveCartToCache can store the parsed result
+    bool loadCartFromCache(const unsigned char* cartData, size_t size);
+    void saveCartToCache();
 	
     public:
     Cart (std::string filename, std::string cartDirectory);
     Cart (const unsigned char* cartData, size_t size);
     ~Cart();
 
+    //the section views would point into the other cart's text
+    Cart(const Cart&) = delete;
+    Cart& operator=(const Cart&) = delete;
+
     std::string FullCartPath;
 
     std::string LuaString;
 
     std::string LoadError;
 
-    std::string SpriteSheetString;
-    std::string SpriteFlagsString;
-    std::string MapString;
-    std::string SfxString;
-    std::string MusicString;
-    std::string LabelString;
+    //raw section text of a .p8 cart, pointing into fullCartText
+    std::string_view SpriteSheetString;
+    std::string_view SpriteFlagsString;
+    std::string_view MapString;
+    std::string_view SfxString;
+    std::string_view MusicString;
+    std::string_view LabelString;
 
     CartRomData CartRom;
     
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cartCache.h"
+#include "logger.h"
+
+struct CartCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t hash;
+    uint32_t romSize;
+    uint32_t luaLength;
+    uint32_t labelLength;
+};
+
+static std::string _cartCacheDirectory = "";
+
+void setCartCacheDirectory(std::string directory) {
+    if (directory.length() > 0 && directory[directory.length() - 1] != '/') {
+        directory += "/";
+    }
+    _cartCacheDirectory = directory;
+}
+
+std::string getCartCacheDirectory() {
+    return _cartCacheDirectory;
+}
+
+uint64_t hashCartContents(const unsigned char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string cartCachePath(uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.f8c", (unsigned long long)hash);
+    return _cartCacheDirectory + name;
+}
+
+bool readCartCache(uint64_t hash, CartRomData* rom, std::string* luaString, std::string* labelString) {
+    if (_cartCacheDirectory.length() == 0) {
+        return false;
+    }
+
+    FILE* file = fopen(cartCachePath(hash).c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    CartCacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, "F8CC", 4) == 0 &&
+        header.version == CART_CACHE_VERSION &&
+        header.hash == hash &&
+        header.romSize == sizeof(CartRomData);
+
+    //check the lengths against what's actually in the file before allocating,
+    //so a corrupted header can't ask for gigabytes
+    valid = valid &&
+        fileSize >= 0 &&
+        (uint64_t)fileSize == sizeof(header) + sizeof(CartRomData) + (uint64_t)header.luaLength + header.labelLength;
+
+    if (valid) {
+        luaString->resize(header.luaLength);
+        labelString->resize(header.labelLength);
+
+        //one read per section, nothing left to parse
+        valid = fread(rom->data, sizeof(rom->data), 1, file) == 1 &&
+            (header.luaLength == 0 || fread(&(*luaString)[0], header.luaLength, 1, file) == 1) &&
+            (header.labelLength == 0 || fread(&(*labelString)[0], header.labelLength, 1, file) == 1);
+    }
+
+    fclose(file);
+
+    if (!valid) {
+        Logger_Write("ignoring invalid cart cache entry\n");
+        luaString->clear();
+        labelString->clear();
+    }
+
+    return valid;
+}
+
+bool writeCartCache(uint64_t hash, const CartRomData& rom, const std::string& luaString, std::string_view labelString) {
+    if (_cartCacheDirectory.length() == 0) {
+        return false;
+    }
+
+    //written to a temp file and renamed into place, so an interrupted write
+    //never leaves a half written entry under the real name
+    std::string path = cartCachePath(hash);
+    std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == NULL) {
+        return false;
+    }
+
+    //zeroed so the struct padding isn't written out as stack garbage
+    CartCacheHeader header = {};
+    memcpy(header.magic, "F8CC", 4);
+    header.version = CART_CACHE_VERSION;
+    header.hash = hash;
+    header.romSize = sizeof(CartRomData);
+    header.luaLength = (uint32_t)luaString.length();
+    header.labelLength = (uint32_t)labelString.length();
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(rom.data, sizeof(rom.data), 1, file) == 1 &&
+        (luaString.length() == 0 || fwrite(luaString.data(), luaString.length(), 1, file) == 1) &&
+        (labelString.length() == 0 || fwrite(labelString.data(), labelString.length(), 1, file) == 1);
+
+    success = fclose(file) == 0 && success;
+
+    if (success && rename(tempPath.c_str(), path.c_str()) != 0) {
+        //windows won't rename over an existing file
+        remove(path.c_str());
+        success = rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+
+    if (!success) {
+        remove(tempPath.c_str());
+    }
+
+    return success;
+}
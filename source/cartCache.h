@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <string_view>
+
+#include "cart.h"
+
+//on disk cache of parsed carts, so loading a cart again skips png decoding,
+//code decompression and the text parser. files are keyed by a hash of the
+//cart file's contents; bump the version whenever parsing changes its output
+#define CART_CACHE_VERSION 1
+
+//"" (the default) disables the cache. the directory must already exist
+void setCartCacheDirectory(std::string directory);
+std::string getCartCacheDirectory();
+
+//fnv-1a 64
+uint64_t hashCartContents(const unsigned char* data, size_t size);
+
+//false if there is no valid entry for hash
+bool readCartCache(uint64_t hash, CartRomData* rom, std::string* luaString, std::string* labelString);
+bool writeCartCache(uint64_t hash, const CartRomData& rom, const std::string& luaString, std::string_view labelString);
@@ -0,0 +1,84 @@
+#include <string.h>
+
+#include "cartRomCache.h"
+
+CartRomCache::CartRomCache(size_t budgetBytes) {
+    _budget = budgetBytes;
+    _hits = 0;
+    _misses = 0;
+}
+
+void CartRomCache::evictToBudget() {
+    while (!_entries.empty() && _entries.size() * sizeof(CartRomData) > _budget) {
+        _entries.pop_back();
+    }
+}
+
+void CartRomCache::setBudget(size_t budgetBytes) {
+    _budget = budgetBytes;
+    evictToBudget();
+}
+
+size_t CartRomCache::getBudget() {
+    return _budget;
+}
+
+const CartRomData* CartRomCache::get(const std::string& path, int64_t mtime) {
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+        if (it->path != path) {
+            continue;
+        }
+
+        if (it->mtime != mtime) {
+            //stale, the cart was saved again
+            _entries.erase(it);
+            break;
+        }
+
+        _entries.splice(_entries.begin(), _entries, it);
+        _hits++;
+
+        return &it->rom;
+    }
+
+    _misses++;
+
+    return nullptr;
+}
+
+void CartRomCache::put(const std::string& path, int64_t mtime, const CartRomData& rom) {
+    if (sizeof(CartRomData) > _budget) {
+        return;
+    }
+
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+        if (it->path == path) {
+            _entries.erase(it);
+            break;
+        }
+    }
+
+    _entries.emplace_front();
+    Entry& entry = _entries.front();
+    entry.path = path;
+    entry.mtime = mtime;
+    memcpy(entry.rom.data, rom.data, sizeof(entry.rom.data));
+
+    evictToBudget();
+}
+
+void CartRomCache::clear() {
+    _entries.clear();
+}
+
+size_t CartRomCache::getEntryCount() {
+    return _entries.size();
+}
+
+size_t CartRomCache::getHits() {
+    return _hits;
+}
+
+size_t CartRomCache::getMisses() {
+    return _misses;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <list>
+
+#include "cart.h"
+
+//default budget: room for a typical multicart's data carts
+#define CART_ROM_CACHE_DEFAULT_BUDGET (16 * sizeof(CartRomData))
+
+//decoded rom of carts read through reload(..., filename), keyed by resolved
+//path and modification time. multicarts that stream a level from another
+//cart on every room change only pay for the file read and decode once
+class CartRomCache {
+    struct Entry {
+        std::string path;
+        int64_t mtime;
+        CartRomData rom;
+    };
+
+    //most recently used first
+    std::list<Entry> _entries;
+    size_t _budget;
+
+    size_t _hits;
+    size_t _misses;
+
+    void evictToBudget();
+
+    public:
+    CartRomCache(size_t budgetBytes = CART_ROM_CACHE_DEFAULT_BUDGET);
+
+    //0 disables the cache. shrinking evicts least recently used entries
+    void setBudget(size_t budgetBytes);
+    size_t getBudget();
+
+    //the cached rom for path, or nullptr if there is none or the file has been
+    //modified since it was cached. valid until the next put/clear/setBudget
+    const CartRomData* get(const std::string& path, int64_t mtime);
+    void put(const std::string& path, int64_t mtime, const CartRomData& rom);
+    void clear();
+
+    size_t getEntryCount();
+    size_t getHits();
+    size_t getMisses();
+};
@@ -22,7 +22,6 @@
 #include <string>
 #include <codecvt>
 #include <cstring>
-#include <regex>
 #include <string_view>
 #include <map>
 
@@ -32,11 +31,49 @@
 std::string_view charset::to_utf8[256];
 std::u32string_view charset::to_utf32[256];
 
-static uint8_t multibyte_start[256];
-static std::map<std::string, uint8_t> to_pico8;
-std::regex charset::utf8_regex = charset::static_init();
+// Trie over the UTF-8 bytes of every multibyte PICO-8 glyph. Node 0 means
+// "no node"; trie_root maps a start byte to its node. Bytes after the first
+// are almost always continuation bytes, so children are indexed by the low
+// 6 bits and trie_byte holds the exact byte a node was entered with (the
+// U+FE0F selector starts with 0xef, which shares its low bits with 0xaf)
+#define TRIE_MAX_NODES 256
 
-std::regex charset::static_init()
+static uint8_t trie_root[256];
+static uint8_t trie_next[TRIE_MAX_NODES][64];
+static uint8_t trie_byte[TRIE_MAX_NODES];
+// PICO-8 character for a complete glyph, -1 for a prefix
+static int16_t trie_value[TRIE_MAX_NODES];
+static int trie_node_count = 1;
+
+bool charset::initialized = charset::static_init();
+
+static void trie_insert(std::string_view glyph, uint8_t ch)
+{
+    int node = 0;
+    for (size_t i = 0; i < glyph.length(); ++i)
+    {
+        uint8_t byte = (uint8_t)glyph[i];
+        uint8_t *slot = i == 0 ? &trie_root[byte] : &trie_next[node][byte & 0x3f];
+        if (*slot == 0)
+        {
+            if (trie_node_count >= TRIE_MAX_NODES)
+                return;
+            *slot = (uint8_t)trie_node_count;
+            trie_byte[trie_node_count] = byte;
+            trie_value[trie_node_count] = -1;
+            ++trie_node_count;
+        }
+        else if (trie_byte[*slot] != byte)
+        {
+            // Two siblings share their low 6 bits; the charmap has none
+            return;
+        }
+        node = *slot;
+    }
+    trie_value[node] = ch;
+}
+
+bool charset::static_init()
 {
     std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> cvt;
 
@@ -57,51 +94,55 @@ std::regex charset::static_init()
     // Create all sorts of lookup tables for PICO-8 character conversions
     char const *p8 = utf8_chars;
     auto const *p32 = (char32_t const *)utf32_chars.data();
-    std::string regex("(");
     for (int i = 0; i < 256; ++i)
     {
         size_t len32 = p32[1] == 0xfe0f ? 2 : 1;
         size_t len8 = ((0xe5000000 >> ((*p8 >> 3) & 0x1e)) & 3) + len32 * len32;
         to_utf8[i] = std::string_view(p8, len8);
         to_utf32[i] = std::u32string_view(p32, len32);
-        to_pico8[std::string(p8, len8)] = i;
 
-        // Build a regex that lets us do faster (maybe?) UTF-8 conversions
         if (len8 > 1)
-        {
-            multibyte_start[(uint8_t)*p8] = 1;
-            regex += std::string(p8, len8) + '|';
-        }
+            trie_insert(to_utf8[i], (uint8_t)i);
 
         p8 += len8;
         p32 += len32;
     }
-    regex += ')'; // Fall back to an empty match on purpose
-
-    return std::regex(regex);
+    return true;
 }
 
 std::string charset::utf8_to_pico8(std::string const &str)
 {
-    std::string ret;
-    std::smatch sm;
+    // Every glyph is at least one byte in and exactly one byte out
+    std::string ret(str.length(), '\0');
+    uint8_t const *p = (uint8_t const *)str.data();
+    uint8_t const *end = p + str.length();
+    char *out = &ret[0];
 
-    for (auto p = str.begin(); p != str.end(); )
+    while (p < end)
     {
-        // Only pass known start characters through the expensive regex
-        if (multibyte_start[(uint8_t)*p]
-             && std::regex_search(p, str.end(), sm, utf8_regex)
-             && sm.length() > 1)
+        int node = trie_root[*p];
+        size_t len = 1;
+
+        // No glyph is a prefix of another, so the first complete one wins
+        while (node != 0 && trie_value[node] < 0 && p + len < end)
+        {
+            int next = trie_next[node][p[len] & 0x3f];
+            node = trie_byte[next] == p[len] ? next : 0;
+            ++len;
+        }
+
+        if (node != 0 && trie_value[node] >= 0)
         {
-            ret += to_pico8[sm.str()];
-            p += sm.length();
+            *out++ = (char)trie_value[node];
+            p += len;
         }
         else
         {
-            ret += *p++;
+            *out++ = (char)*p++;
         }
     }
 
+    ret.resize(out - ret.data());
     return ret;
 }
 
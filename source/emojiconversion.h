@@ -1,5 +1,5 @@
 #include <string>
-#include <regex>
+#include <string_view>
 
 struct charset
 {
@@ -17,6 +17,6 @@ struct charset
     static std::string upper_to_emoji(std::string str);
 
 private:
-    static std::regex static_init();
-    static std::regex utf8_regex;
+    static bool static_init();
+    static bool initialized;
 };
\ No newline at end of file
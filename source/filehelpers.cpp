@@ -1,6 +1,7 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <sys/stat.h>
 
 //http://insanecoding.blogspot.com/2011/11/how-to-read-in-file-in-c.html
 std::string get_file_contents(std::string filename){
@@ -37,6 +38,15 @@ std::vector<char> get_file_as_buffer(std::string filename){
     return buffer;
 }
 
+int64_t get_file_modified_time(std::string filename){
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        return -1;
+    }
+
+    return (int64_t)info.st_mtime;
+}
+
 std::string get_first_four_chars(std::string filename){
     std::ifstream in(filename, std::ios::in | std::ios::binary);
     if (in)
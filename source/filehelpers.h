@@ -1,10 +1,14 @@
 #include <string>
 #include <vector>
+#include <stdint.h>
 
 std::string get_file_contents(std::string filename);
 
 std::vector<char> get_file_as_buffer(std::string filename);
 
+//seconds since the epoch, -1 if the file can't be stat'd
+int64_t get_file_modified_time(std::string filename);
+
 std::string get_first_four_chars(std::string filename);
 
 std::string getDirectory(const std::string& fname);
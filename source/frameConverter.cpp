@@ -0,0 +1,342 @@
+#include <string.h>
+
+#include "frameConverter.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FRAME_CONVERTER_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FRAME_CONVERTER_NEON 1
+#endif
+
+//the pico screen is always 128 pixels (64 bytes) wide
+#define SRC_ROW_BYTES 64
+
+static uint16_t toRgb565(Color col) {
+    return (uint16_t)(((col.Red & 0xf8) << 8) | ((col.Green & 0xfc) << 3) | (col.Blue >> 3));
+}
+
+static uint32_t toXrgb8888(Color col) {
+    return ((uint32_t)col.Alpha << 24) | ((uint32_t)col.Red << 16) | ((uint32_t)col.Green << 8) | col.Blue;
+}
+
+static uint32_t toAbgr8888(Color col) {
+    return ((uint32_t)col.Alpha << 24) | ((uint32_t)col.Blue << 16) | ((uint32_t)col.Green << 8) | col.Red;
+}
+
+static uint32_t toRgba8888(Color col) {
+    return ((uint32_t)col.Red << 24) | ((uint32_t)col.Green << 16) | ((uint32_t)col.Blue << 8) | col.Alpha;
+}
+
+static uint32_t toPixel32(FramePixelFormat format, Color col) {
+    switch (format) {
+        case FRAME_FORMAT_XRGB8888:
+            return toXrgb8888(col);
+        case FRAME_FORMAT_RGBA8888:
+            return toRgba8888(col);
+        default:
+            return toAbgr8888(col);
+    }
+}
+
+FrameConverter::FrameConverter(FramePixelFormat format) {
+    _format = format;
+    _bytesPerPixel = format == FRAME_FORMAT_RGB565 ? 2 : 4;
+
+    memset(_pairs16, 0, sizeof(_pairs16));
+    memset(_pairs32, 0, sizeof(_pairs32));
+    memset(_planes, 0, sizeof(_planes));
+}
+
+FramePixelFormat FrameConverter::getFormat() {
+    return _format;
+}
+
+int FrameConverter::getBytesPerPixel() {
+    return _bytesPerPixel;
+}
+
+//tables are rebuilt every call; 256 entries is nothing next to a frame and
+//it means pal() and host palette changes never need invalidating.
+//pairs are assembled through memcpy so they land in memory order on big endian hosts too
+void FrameConverter::buildTables(int set, const uint8_t* screenPaletteMap, const Color* paletteColors) {
+    //0x8f keeps the map inside the 16 regular + 16 secret colors
+    if (_format == FRAME_FORMAT_RGB565) {
+        uint16_t colors[16];
+        for (int c = 0; c < 16; c++) {
+            colors[c] = toRgb565(paletteColors[screenPaletteMap[c] & 0x8f]);
+            _planes[set][0][c] = ((uint8_t*)&colors[c])[0];
+            _planes[set][1][c] = ((uint8_t*)&colors[c])[1];
+        }
+
+        for (int b = 0; b < 256; b++) {
+            //low nibble is the left pixel
+            uint16_t pair[2] = { colors[b & 0x0f], colors[b >> 4] };
+            memcpy(&_pairs16[set][b], pair, sizeof(pair));
+        }
+        return;
+    }
+
+    uint32_t colors[16];
+    for (int c = 0; c < 16; c++) {
+        Color col = paletteColors[screenPaletteMap[c] & 0x8f];
+        colors[c] = toPixel32(_format, col);
+        for (int k = 0; k < 4; k++) {
+            _planes[set][k][c] = ((uint8_t*)&colors[c])[k];
+        }
+    }
+
+    for (int b = 0; b < 256; b++) {
+        uint32_t pair[2] = { colors[b & 0x0f], colors[b >> 4] };
+        memcpy(&_pairs32[set][b], pair, sizeof(pair));
+    }
+}
+
+//one 64 byte source row to 128 output pixels
+void FrameConverter::convertLine(const uint8_t* src, uint8_t* dest, int set) {
+#if FRAME_CONVERTER_NEON
+    //16 entry table lookups on both nibbles, 8 source bytes (16 pixels) at a time
+    const uint8x8_t lowMask = vdup_n_u8(0x0f);
+
+    if (_format == FRAME_FORMAT_RGB565) {
+        uint8x8x2_t t0 = { { vld1_u8(_planes[set][0]), vld1_u8(_planes[set][0] + 8) } };
+        uint8x8x2_t t1 = { { vld1_u8(_planes[set][1]), vld1_u8(_planes[set][1] + 8) } };
+
+        for (int i = 0; i < SRC_ROW_BYTES; i += 8) {
+            uint8x8_t v = vld1_u8(src + i);
+            uint8x8_t left = vand_u8(v, lowMask);
+            uint8x8_t right = vshr_n_u8(v, 4);
+
+            uint8x8x4_t out;
+            out.val[0] = vtbl2_u8(t0, left);
+            out.val[1] = vtbl2_u8(t1, left);
+            out.val[2] = vtbl2_u8(t0, right);
+            out.val[3] = vtbl2_u8(t1, right);
+            vst4_u8(dest + i * 4, out);
+        }
+        return;
+    }
+
+    uint8x8x2_t t[4];
+    for (int k = 0; k < 4; k++) {
+        t[k].val[0] = vld1_u8(_planes[set][k]);
+        t[k].val[1] = vld1_u8(_planes[set][k] + 8);
+    }
+
+    for (int i = 0; i < SRC_ROW_BYTES; i += 8) {
+        uint8x8_t v = vld1_u8(src + i);
+        uint8x8_t left = vand_u8(v, lowMask);
+        uint8x8_t right = vshr_n_u8(v, 4);
+
+        //interleave left/right pixels per byte plane, then the planes into pixels
+        uint8x8x2_t z[4];
+        for (int k = 0; k < 4; k++) {
+            z[k] = vzip_u8(vtbl2_u8(t[k], left), vtbl2_u8(t[k], right));
+        }
+
+        uint8x8x4_t lo = { { z[0].val[0], z[1].val[0], z[2].val[0], z[3].val[0] } };
+        uint8x8x4_t hi = { { z[0].val[1], z[1].val[1], z[2].val[1], z[3].val[1] } };
+        vst4_u8(dest + i * 8, lo);
+        vst4_u8(dest + i * 8 + 32, hi);
+    }
+#else
+    //sse2 has no byte shuffle to do the lookup with, so the x86 path is the
+    //pair table too; it only vectorizes the 2x-4x scaling below
+    if (_format == FRAME_FORMAT_RGB565) {
+        for (int i = 0; i < SRC_ROW_BYTES; i++) {
+            memcpy(dest + i * 4, &_pairs16[set][src[i]], 4);
+        }
+        return;
+    }
+
+    for (int i = 0; i < SRC_ROW_BYTES; i++) {
+        memcpy(dest + i * 8, &_pairs32[set][src[i]], 8);
+    }
+#endif
+}
+
+//horizontal scaling of one converted row
+void FrameConverter::expandLine(const uint8_t* src, int width, int scale, uint8_t* dest) {
+    if (scale == 1) {
+        memcpy(dest, src, width * _bytesPerPixel);
+        return;
+    }
+
+    int x = 0;
+
+    //2x, 3x and 4x write whole vectors of repeated pixels; the shuffles pick
+    //which source pixel lands in each output lane
+#if FRAME_CONVERTER_SSE2
+    if (_bytesPerPixel == 2) {
+        if (scale == 2) {
+            for (; x + 8 <= width; x += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 2));
+                _mm_storeu_si128((__m128i*)(dest + x * 4), _mm_unpacklo_epi16(v, v));
+                _mm_storeu_si128((__m128i*)(dest + x * 4 + 16), _mm_unpackhi_epi16(v, v));
+            }
+        }
+        else if (scale == 3) {
+            for (; x + 8 <= width; x += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 2));
+                __m128i lo = _mm_unpacklo_epi64(v, v);
+                __m128i hi = _mm_unpackhi_epi64(v, v);
+                //p0 p0 p0 p1 p1 p1 p2 p2 | p2 p3 p3 p3 p4 p4 p4 p5 | p5 p5 p6 p6 p6 p7 p7 p7
+                __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(1, 0, 0, 0)), _MM_SHUFFLE(2, 2, 1, 1));
+                __m128i b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 2)), _MM_SHUFFLE(1, 0, 0, 0));
+                __m128i c = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(2, 2, 1, 1)), _MM_SHUFFLE(3, 3, 3, 2));
+                _mm_storeu_si128((__m128i*)(dest + x * 6), a);
+                _mm_storeu_si128((__m128i*)(dest + x * 6 + 16), b);
+                _mm_storeu_si128((__m128i*)(dest + x * 6 + 32), c);
+            }
+        }
+        else if (scale == 4) {
+            for (; x + 8 <= width; x += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 2));
+                __m128i lo = _mm_unpacklo_epi16(v, v);
+                __m128i hi = _mm_unpackhi_epi16(v, v);
+                _mm_storeu_si128((__m128i*)(dest + x * 8), _mm_unpacklo_epi32(lo, lo));
+                _mm_storeu_si128((__m128i*)(dest + x * 8 + 16), _mm_unpackhi_epi32(lo, lo));
+                _mm_storeu_si128((__m128i*)(dest + x * 8 + 32), _mm_unpacklo_epi32(hi, hi));
+                _mm_storeu_si128((__m128i*)(dest + x * 8 + 48), _mm_unpackhi_epi32(hi, hi));
+            }
+        }
+    }
+    else {
+        if (scale == 2) {
+            for (; x + 4 <= width; x += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+                _mm_storeu_si128((__m128i*)(dest + x * 8), _mm_unpacklo_epi32(v, v));
+                _mm_storeu_si128((__m128i*)(dest + x * 8 + 16), _mm_unpackhi_epi32(v, v));
+            }
+        }
+        else if (scale == 3) {
+            for (; x + 4 <= width; x += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+                _mm_storeu_si128((__m128i*)(dest + x * 12), _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 0, 0)));
+                _mm_storeu_si128((__m128i*)(dest + x * 12 + 16), _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+                _mm_storeu_si128((__m128i*)(dest + x * 12 + 32), _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+            }
+        }
+        else if (scale == 4) {
+            for (; x + 4 <= width; x += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+                _mm_storeu_si128((__m128i*)(dest + x * 16), _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 0, 0, 0)));
+                _mm_storeu_si128((__m128i*)(dest + x * 16 + 16), _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 1, 1, 1)));
+                _mm_storeu_si128((__m128i*)(dest + x * 16 + 32), _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 2, 2)));
+                _mm_storeu_si128((__m128i*)(dest + x * 16 + 48), _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+        }
+    }
+#elif FRAME_CONVERTER_NEON
+    //interleaving stores of the same vector repeat every pixel
+    if (_bytesPerPixel == 2) {
+        if (scale == 2) {
+            for (; x + 8 <= width; x += 8) {
+                uint16x8_t v = vld1q_u16((const uint16_t*)(src + x * 2));
+                uint16x8x2_t twice = { { v, v } };
+                vst2q_u16((uint16_t*)(dest + x * 4), twice);
+            }
+        }
+        else if (scale == 3) {
+            for (; x + 8 <= width; x += 8) {
+                uint16x8_t v = vld1q_u16((const uint16_t*)(src + x * 2));
+                uint16x8x3_t thrice = { { v, v, v } };
+                vst3q_u16((uint16_t*)(dest + x * 6), thrice);
+            }
+        }
+        else if (scale == 4) {
+            for (; x + 8 <= width; x += 8) {
+                uint16x8_t v = vld1q_u16((const uint16_t*)(src + x * 2));
+                uint16x8x4_t fourTimes = { { v, v, v, v } };
+                vst4q_u16((uint16_t*)(dest + x * 8), fourTimes);
+            }
+        }
+    }
+    else {
+        if (scale == 2) {
+            for (; x + 4 <= width; x += 4) {
+                uint32x4_t v = vld1q_u32((const uint32_t*)(src + x * 4));
+                uint32x4x2_t twice = { { v, v } };
+                vst2q_u32((uint32_t*)(dest + x * 8), twice);
+            }
+        }
+        else if (scale == 3) {
+            for (; x + 4 <= width; x += 4) {
+                uint32x4_t v = vld1q_u32((const uint32_t*)(src + x * 4));
+                uint32x4x3_t thrice = { { v, v, v } };
+                vst3q_u32((uint32_t*)(dest + x * 12), thrice);
+            }
+        }
+        else if (scale == 4) {
+            for (; x + 4 <= width; x += 4) {
+                uint32x4_t v = vld1q_u32((const uint32_t*)(src + x * 4));
+                uint32x4x4_t fourTimes = { { v, v, v, v } };
+                vst4q_u32((uint32_t*)(dest + x * 16), fourTimes);
+            }
+        }
+    }
+#endif
+
+    //generic tail / other scale factors
+    int bpp = _bytesPerPixel;
+    for (; x < width; x++) {
+        const uint8_t* px = src + x * bpp;
+        uint8_t* out = dest + x * scale * bpp;
+        for (int s = 0; s < scale; s++) {
+            memcpy(out + s * bpp, px, bpp);
+        }
+    }
+}
+
+void FrameConverter::convert(
+    const uint8_t* picoFb,
+    const uint8_t* screenPaletteMap,
+    const AltScreenPalette_t* altPalette,
+    const Color* paletteColors,
+    void* dest,
+    int destPitch,
+    int scale,
+    const ScreenDirtyState_t* dirtyState,
+    int srcX,
+    int srcY,
+    int srcW,
+    int srcH)
+{
+    if (scale < 1 || srcW <= 0 || srcH <= 0 ||
+        srcX < 0 || srcY < 0 || srcX + srcW > 128 || srcY + srcH > 128) {
+        return;
+    }
+
+    //both palettes are built once per frame, each line just picks its set
+    buildTables(0, screenPaletteMap, paletteColors);
+    bool useAlt = altPalette != nullptr && altPalette->enabled;
+    if (useAlt) {
+        buildTables(1, altPalette->paletteMap, paletteColors);
+    }
+
+    bool direct = scale == 1 && srcX == 0 && srcW == 128;
+    int outRowBytes = srcW * scale * _bytesPerPixel;
+
+    for (int y = srcY; y < srcY + srcH; y++) {
+        if (dirtyState != nullptr && !isScreenRowDirty(dirtyState, y)) {
+            continue;
+        }
+
+        uint8_t* outRow = (uint8_t*)dest + (y - srcY) * scale * destPitch;
+        const uint8_t* srcRow = picoFb + y * SRC_ROW_BYTES;
+        int set = useAlt && isAltPaletteLine(altPalette, y) ? 1 : 0;
+
+        if (direct) {
+            convertLine(srcRow, outRow, set);
+        }
+        else {
+            convertLine(srcRow, _line, set);
+            expandLine(_line + srcX * _bytesPerPixel, srcW, scale, outRow);
+        }
+
+        for (int s = 1; s < scale; s++) {
+            memcpy(outRow + s * destPitch, outRow, outRowBytes);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "hostVmShared.h"
+
+//converts the 4bpp pico 8 screen into the pixel format a host uploads,
+//so every platform shares one kernel instead of a getPixelNibble loop
+
+enum FramePixelFormat {
+    //5:6:5 in a uint16_t (libretro, most handhelds)
+    FRAME_FORMAT_RGB565 = 0,
+    //0xAARRGGBB in a uint32_t (SDL_PIXELFORMAT_ARGB8888, libretro XRGB8888)
+    FRAME_FORMAT_XRGB8888,
+    //0xAABBGGRR in a uint32_t, RGBA byte order in memory on little endian (GL/GX textures)
+    FRAME_FORMAT_ABGR8888,
+    //0xRRGGBBAA in a uint32_t (SDL_PIXELFORMAT_RGBA8888, wii u)
+    FRAME_FORMAT_RGBA8888
+};
+
+class FrameConverter {
+    FramePixelFormat _format;
+    int _bytesPerPixel;
+
+    //one byte of the frame buffer (two pixels) to both output pixels.
+    //set 0 is the screen palette, set 1 the secondary (per scanline) palette
+    uint32_t _pairs16[2][256];
+    uint64_t _pairs32[2][256];
+    //per output byte tables indexed by color, used by the neon path
+    uint8_t _planes[2][4][16];
+
+    //one converted source row, used when cropping or scaling
+    alignas(16) uint8_t _line[128 * 4];
+
+    void buildTables(int set, const uint8_t* screenPaletteMap, const Color* paletteColors);
+    void convertLine(const uint8_t* src, uint8_t* dest, int set);
+    void expandLine(const uint8_t* src, int width, int scale, uint8_t* dest);
+
+    public:
+    FrameConverter(FramePixelFormat format);
+
+    FramePixelFormat getFormat();
+    int getBytesPerPixel();
+
+    //converts the srcW x srcH area at srcX, srcY of picoFb into dest. every pico
+    //pixel becomes scale x scale output pixels and destPitch is in bytes.
+    //rows that are clean in dirtyState are left alone when it is not null.
+    //altPalette (may be null) swaps in the secondary palette on its marked lines
+    void convert(
+        const uint8_t* picoFb,
+        const uint8_t* screenPaletteMap,
+        const AltScreenPalette_t* altPalette,
+        const Color* paletteColors,
+        void* dest,
+        int destPitch,
+        int scale = 1,
+        const ScreenDirtyState_t* dirtyState = nullptr,
+        int srcX = 0,
+        int srcY = 0,
+        int srcW = 128,
+        int srcH = 128);
+};
@@ -33,6 +33,10 @@ Graphics::Graphics(std::string fontdata, PicoRam* memory) {
 	clip();
 	pal();
 	color();
+	refreshBlitLuts();
+
+	memset(&_altScreenPalette, 0, sizeof(_altScreenPalette));
+	markAllDirty();
 }
 
 
@@ -52,8 +56,342 @@ uint8_t* Graphics::GetScreenPaletteMap(){
 	return _memory->drawState.screenPaletteMap;
 }
 
+static inline uint8_t swapNibbles(uint8_t b) {
+	return (uint8_t)((b >> 4) | (b << 4));
+}
+
+//left 64 pixels, each doubled
+static void presentStretchedRow(const uint8_t* src, uint8_t* dest) {
+	for (int i = 0; i < 32; i++) {
+		uint8_t left = src[i] & 0x0f;
+		uint8_t right = src[i] >> 4;
+		dest[i * 2] = left | (left << 4);
+		dest[i * 2 + 1] = right | (right << 4);
+	}
+}
+
+//left 64 pixels, then the same reversed
+static void presentMirroredRow(const uint8_t* src, uint8_t* dest) {
+	memcpy(dest, src, 32);
+	for (int i = 0; i < 32; i++) {
+		dest[63 - i] = swapNibbles(src[i]);
+	}
+}
+
+static void presentFlippedRow(const uint8_t* src, uint8_t* dest) {
+	for (int i = 0; i < 64; i++) {
+		dest[63 - i] = swapNibbles(src[i]);
+	}
+}
+
+//133 is a quarter turn clockwise: out(x, y) = screen(y, 127 - x).
+//135 is counter clockwise: out(x, y) = screen(127 - y, x).
+//works on an unpacked copy in 8x8 blocks so both the reads and the writes stay in cache
+void Graphics::presentRotated(const uint8_t* fb, bool clockwise) {
+	for (int i = 0; i < 128 * 64; i++) {
+		_rotateScratch[i * 2] = fb[i] & 0x0f;
+		_rotateScratch[i * 2 + 1] = fb[i] >> 4;
+	}
+
+	const int base = clockwise ? 127 * 128 : 127;
+	const int xStride = clockwise ? -128 : 128;
+	const int yStride = clockwise ? 1 : -1;
+
+	for (int by = 0; by < 128; by += 8) {
+		for (int bx = 0; bx < 128; bx += 8) {
+			for (int y = by; y < by + 8; y++) {
+				const uint8_t* src = _rotateScratch + base + y * yStride;
+				uint8_t* dest = _presentedBuffer + y * 64;
+				for (int x = bx; x < bx + 8; x += 2) {
+					dest[x >> 1] = src[x * xStride] | (src[(x + 1) * xStride] << 4);
+				}
+			}
+		}
+	}
+}
+
+uint8_t* Graphics::GetPresentedFrameBuffer(){
+	uint8_t* fb = GetP8FrameBuffer();
+	uint8_t drawMode = _memory->drawState.drawMode;
+
+	//bit 4 of 0x5f5f turns the secondary palette on
+	_altScreenPalette.enabled = (_memory->hwState.alternatePaletteFlag & 0x10) != 0;
+	if (_altScreenPalette.enabled) {
+		for (int c = 0; c < 16; c++) {
+			_altScreenPalette.paletteMap[c] = _memory->hwState.alternatePaletteMap[c] & 0x8f;
+		}
+		memcpy(_altScreenPalette.lineBitfield, _memory->hwState.alternatePaletteScreenLineBitfield, 16);
+	}
+
+	//per axis: 0 = as is, 1 = stretch, 2 = mirror, 3 = flip
+	int hOp = 0;
+	int vOp = 0;
+	switch(drawMode) {
+		case 1: hOp = 1; break;
+		case 2: vOp = 1; break;
+		case 3: hOp = 1; vOp = 1; break;
+		case 5: hOp = 2; break;
+		case 6: vOp = 2; break;
+		case 7: hOp = 2; vOp = 2; break;
+		case 129: hOp = 3; break;
+		case 130: vOp = 3; break;
+		case 131:
+		case 134: hOp = 3; vOp = 3; break;
+		case 133:
+		case 135:
+			presentRotated(fb, drawMode == 133);
+			markAllDirty();
+			return _presentedBuffer;
+		//0, 4 and anything unrecognised show the screen as is
+		default:
+			return fb;
+	}
+
+	for (int y = 0; y < 128; y++) {
+		int srcY = y;
+		if (vOp == 1) {
+			srcY = y >> 1;
+		}
+		else if (vOp == 2) {
+			srcY = y < 64 ? y : 127 - y;
+		}
+		else if (vOp == 3) {
+			srcY = 127 - y;
+		}
+
+		const uint8_t* src = fb + srcY * 64;
+		uint8_t* dest = _presentedBuffer + y * 64;
+		switch(hOp) {
+			case 1: presentStretchedRow(src, dest); break;
+			case 2: presentMirroredRow(src, dest); break;
+			case 3: presentFlippedRow(src, dest); break;
+			default: memcpy(dest, src, 64); break;
+		}
+	}
+
+	markAllDirty();
+	return _presentedBuffer;
+}
+
+AltScreenPalette_t* Graphics::GetAltScreenPalette(){
+	return &_altScreenPalette;
+}
+
+ScreenDirtyState_t* Graphics::GetScreenDirtyState(){
+	return &_dirtyState;
+}
+
+void Graphics::clearScreenDirtyState(){
+	memset(&_dirtyState, 0, sizeof(_dirtyState));
+}
+
+void Graphics::markAllDirty(){
+	memset(_dirtyState.rows, 0xff, sizeof(_dirtyState.rows));
+	_dirtyState.paletteChanged = true;
+}
+
+void Graphics::markPaletteDirty(){
+	_dirtyState.paletteChanged = true;
+}
+
+void Graphics::markRowsDirty(int y0, int y1){
+	y0 = std::max(y0, 0);
+	y1 = std::min(y1, 127);
+
+	for (int y = y0; y <= y1; y++) {
+		markRowDirty(y);
+	}
+}
+
+void Graphics::markMemoryDirty(int addr, int len){
+	if (len <= 0) {
+		return;
+	}
+	int end = addr + len;
+
+	//whichever buffer is currently being displayed
+	int screenBase = _memory->hwState.screenDataMemMapping == 0 ? 0 : 0x6000;
+	if (addr < screenBase + 0x2000 && end > screenBase) {
+		markRowsDirty((addr - screenBase) >> 6, (end - 1 - screenBase) >> 6);
+	}
+
+	//screen palette, draw mode, display mapping and alt palette all change every row
+	if ((addr < 0x5f20 && end > 0x5f10) ||
+		(addr <= 0x5f2c && end > 0x5f2c) ||
+		(addr <= 0x5f55 && end > 0x5f55) ||
+		(addr < 0x5f80 && end > 0x5f5f)) {
+		markAllDirty();
+	}
+}
+
 //start helper methods
-//based on tac08 implementation of blitter()
+
+//sprite and screen bytes are read and written 4 at a time (8 pixels). the words are
+//assembled a byte at a time so pixel order is the same on big endian hosts,
+//compilers turn these into single loads and stores
+static inline uint32_t loadBlitWord(const uint8_t* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void storeBlitWord(uint8_t* p, uint32_t w) {
+	p[0] = (uint8_t)w;
+	p[1] = (uint8_t)(w >> 8);
+	p[2] = (uint8_t)(w >> 16);
+	p[3] = (uint8_t)(w >> 24);
+}
+
+static inline uint32_t lookupBlitWord(const uint8_t* lut, uint32_t w) {
+	return (uint32_t)lut[w & 0xff]
+		| ((uint32_t)lut[(w >> 8) & 0xff] << 8)
+		| ((uint32_t)lut[(w >> 16) & 0xff] << 16)
+		| ((uint32_t)lut[w >> 24] << 24);
+}
+
+void Graphics::refreshBlitLuts() {
+	const uint8_t* paletteMap = _memory->drawState.drawPaletteMap;
+	memcpy(_blitLutPalette, paletteMap, sizeof(_blitLutPalette));
+
+	for (int i = 0; i < 256; i++) {
+		uint8_t lc = paletteMap[i & 0x0f];
+		uint8_t rc = paletteMap[i >> 4];
+		_blitColorLut[i] = (lc & 0x0f) | (rc << 4);
+		_blitOpaqueLut[i] = ((lc >> 4) ? 0 : 0x0f) | ((rc >> 4) ? 0 : 0xf0);
+	}
+}
+
+//per call state for the sprite blitter, after clipping
+struct SpriteBlit {
+	//sheet byte holding the leftmost pixel drawn (rightmost when flipped) in the first row drawn
+	const uint8_t* src;
+	//screen byte holding the leftmost pixel drawn in the first row drawn
+	uint8_t* dst;
+	int rows;
+	//screen bytes touched per row
+	int rowBytes;
+	//sheet bytes read per row
+	int srcBytes;
+	//nibble of the row buffer that lines up with the first nibble of dst
+	int rowShift;
+	//which pixels of each screen word are inside the drawn span
+	uint32_t edgeMasks[17];
+	uint32_t writeMask;
+	uint32_t readMask;
+	const uint8_t* colorLut;
+	const uint8_t* opaqueLut;
+};
+
+//one instance per flip_x, flip_y, color bitmask set, and whether the sheet and
+//screen x parity differ (a nibble shift). the plain case reads words straight
+//from the sheet with no branches in the row loop
+template <bool flipX, bool flipY, bool masked, bool shifted>
+static void blitSpriteRows(const SpriteBlit& blit) {
+	//rows are copied into a padded buffer when they need reversing or shifting.
+	//it starts one byte in so the shift can reach back a nibble
+	const bool buffered = flipX || shifted;
+	uint8_t rowPixels[72];
+	const uint8_t* words = rowPixels + (blit.rowShift >> 1);
+	if (buffered) {
+		//only the bytes around the span are ever read
+		memset(rowPixels, 0, std::min((int)sizeof(rowPixels), blit.srcBytes + 4));
+	}
+
+	const uint8_t* src = blit.src;
+	uint8_t* dst = blit.dst;
+	const int rowBytes = blit.rowBytes;
+
+	for (int row = 0; row < blit.rows; row++) {
+		if (flipX) {
+			for (int b = 0; b < blit.srcBytes; b++) {
+				rowPixels[1 + b] = swapNibbles(src[-b]);
+			}
+		}
+		else if (shifted) {
+			memcpy(rowPixels + 1, src, blit.srcBytes);
+		}
+		else {
+			words = src;
+		}
+
+		int b = 0;
+		for (; b + 4 <= rowBytes; b += 4) {
+			uint32_t pixels = shifted
+				? (loadBlitWord(words + b) >> 4) | ((uint32_t)words[b + 4] << 28)
+				: loadBlitWord(words + b);
+
+			uint32_t color = lookupBlitWord(blit.colorLut, pixels);
+			uint32_t mask = lookupBlitWord(blit.opaqueLut, pixels) & blit.edgeMasks[b >> 2];
+			if (masked) {
+				color &= blit.readMask;
+				mask &= blit.writeMask;
+			}
+
+			uint32_t d = loadBlitWord(dst + b);
+			storeBlitWord(dst + b, (d & ~mask) | (color & mask));
+		}
+
+		//last few bytes of the row, don't read or write past them
+		uint32_t edge = b < rowBytes ? blit.edgeMasks[b >> 2] : 0;
+		for (; b < rowBytes; b++) {
+			uint8_t pixels = shifted
+				? (uint8_t)((words[b] >> 4) | (words[b + 1] << 4))
+				: words[b];
+
+			uint8_t color = blit.colorLut[pixels];
+			uint8_t mask = blit.opaqueLut[pixels] & (uint8_t)edge;
+			if (masked) {
+				color &= (uint8_t)blit.readMask;
+				mask &= (uint8_t)blit.writeMask;
+			}
+
+			dst[b] = (dst[b] & ~mask) | (color & mask);
+			edge >>= 8;
+		}
+
+		src += flipY ? -64 : 64;
+		dst += 64;
+	}
+}
+
+//rowBytes and edgeMasks for rows of width pixels starting at nibble firstNibble of dst
+static void setSpriteBlitEdges(SpriteBlit& blit, int firstNibble, int width) {
+	blit.rowBytes = (firstNibble + width + 1) >> 1;
+
+	for (int w = 0; w * 4 < blit.rowBytes; w++) {
+		int lo = firstNibble - w * 8;
+		int hi = firstNibble + width - w * 8;
+		uint32_t mask = hi >= 8 ? 0xffffffffu : (1u << (hi * 4)) - 1;
+		if (lo > 0) {
+			mask &= ~((1u << (lo * 4)) - 1);
+		}
+		blit.edgeMasks[w] = mask;
+	}
+}
+
+typedef void (*SpriteBlitKernel)(const SpriteBlit& blit);
+
+//indexed by flip_x << 3 | flip_y << 2 | masked << 1 | shifted
+static const SpriteBlitKernel spriteBlitKernels[16] = {
+	blitSpriteRows<false, false, false, false>,
+	blitSpriteRows<false, false, false, true>,
+	blitSpriteRows<false, false, true, false>,
+	blitSpriteRows<false, false, true, true>,
+	blitSpriteRows<false, true, false, false>,
+	blitSpriteRows<false, true, false, true>,
+	blitSpriteRows<false, true, true, false>,
+	blitSpriteRows<false, true, true, true>,
+	blitSpriteRows<true, false, false, false>,
+	blitSpriteRows<true, false, false, true>,
+	blitSpriteRows<true, false, true, false>,
+	blitSpriteRows<true, false, true, true>,
+	blitSpriteRows<true, true, false, false>,
+	blitSpriteRows<true, true, false, true>,
+	blitSpriteRows<true, true, true, false>,
+	blitSpriteRows<true, true, true, true>,
+};
+
+//originally based on tac08 implementation of blitter()
+//clips once, then hands the rows to the kernel for this combination of flips,
+//color bitmask and alignment (see blitSpriteRows)
 void Graphics::copySpriteToScreen(
 	uint8_t* spritebuffer,
 	int scr_x,
@@ -65,141 +403,164 @@ void Graphics::copySpriteToScreen(
 	bool flip_x,
 	bool flip_y) 
 {
-
-	//note: no clipping yet
-	int scr_w = spr_w;
-	int scr_h = spr_h;
-
 	auto &drawState = _memory->drawState;
 	auto &hwState = _memory->hwState;
 	uint8_t *screenBuffer = GetP8FrameBuffer();
-	
-	const uint8_t writeMask = hwState.colorBitmask & 15;
-	const uint8_t readMask = hwState.colorBitmask >> 4;
 
 	scr_x -= drawState.camera_x;
 	scr_y -= drawState.camera_y;
 
-	// left clip
-	if (scr_x < drawState.clip_xb) {
-		int nclip = drawState.clip_xb - scr_x;
-		scr_x = drawState.clip_xb;
-		scr_w -= nclip;
-		if (!flip_x) {
-			spr_x += nclip;
-		} else {
-			spr_w -= nclip;
-		}
-	}
-
-	// right clip
-	if (scr_x + scr_w > drawState.clip_xe) {
-		int nclip = (scr_x + scr_w) - drawState.clip_xe;
-		scr_w -= nclip;
+	//columns and rows of the sprite (from its top left on screen) inside the clip rect
+	int i0 = std::max(0, drawState.clip_xb - scr_x);
+	int i1 = std::min(spr_w, drawState.clip_xe - scr_x);
+	int j0 = std::max(0, drawState.clip_yb - scr_y);
+	int j1 = std::min(spr_h, drawState.clip_ye - scr_y);
+	if (i0 >= i1 || j0 >= j1) {
+		return;
 	}
 
-	// top clip
-	if (scr_y < drawState.clip_yb) {
-		int nclip = drawState.clip_yb - scr_y;
-		scr_y = drawState.clip_yb;
-		scr_h -= nclip;
-		if (!flip_y) {
-			spr_y += nclip;
-		} else {
-			spr_h -= nclip;
-		}
+	//pixels that would come from outside the sprite sheet are not drawn
+	const int sheetI = flip_x ? spr_x + spr_w - 128 : -spr_x;
+	const int sheetJ = flip_y ? spr_y + spr_h - 128 : -spr_y;
+	i0 = std::max(i0, sheetI);
+	i1 = std::min(i1, sheetI + 128);
+	j0 = std::max(j0, sheetJ);
+	j1 = std::min(j1, sheetJ + 128);
+	if (i0 >= i1 || j0 >= j1) {
+		return;
 	}
 
-	// bottom clip
-	if (scr_y + scr_h > drawState.clip_ye) {
-		int nclip = (scr_y + scr_h) - drawState.clip_ye;
-		scr_h -= nclip;
-	}
-	uint8_t lastScreenBuffByte = 0;
-	int lastScreenBuffIdx = -1;
+	markRowsDirty(scr_y + j0, scr_y + j1 - 1);
 
-	bool startWithHalf = false;
-	//starting with odd pixel
-	if (BITMASK(0) & spr_x) {
-		startWithHalf = true;
+	if (memcmp(_blitLutPalette, drawState.drawPaletteMap, sizeof(_blitLutPalette)) != 0) {
+		refreshBlitLuts();
 	}
 
-	//since we get 2 pixels at a time, don't go through this whole loop every pixel
-	for (int y = 0; y < scr_h; y++) {
-		int x = 0;
-		while (x < scr_w) {
-			int abs_spr_x = spr_x + (flip_x ? spr_w - (x + 1) : x);
-			int abs_spr_y = spr_y + (flip_y ? spr_h - (y + 1) : y);
-			if (!IS_VALID_SPR_IDX(abs_spr_x, abs_spr_y)){
-				++x;
-				continue;
-			}
-			uint8_t bothPix = spritebuffer[COMBINED_IDX(abs_spr_x, abs_spr_y)];
+	SpriteBlit blit;
+	blit.colorLut = _blitColorLut;
+	blit.opaqueLut = _blitOpaqueLut;
 
-			//uint8_t c = (BITMASK(0) & abs_spr_x)== 0 
-			//			? bothPix & 0x0f //just first 4 bits
-			//			: bothPix >> 4;  //just last 4 bits
-			uint8_t lc = bothPix & 0x0f;
-			uint8_t rc = bothPix >> 4;
-			
-			const int finaly = scr_y + y;
-			int finalx = scr_x + (flip_x ? x + 1 : x);
-			
-			if (x > 0 || !startWithHalf){
-				if (!(drawState.drawPaletteMap[lc] >> 4)){
-					lc = drawState.drawPaletteMap[lc] & 0x0f;
+	//from pico 8 wiki:
+	//dst_color = (dst_color & ~write_mask) | (src_color & write_mask & read_mask)
+	const bool masked = hwState.colorBitmask != 0xff;
+	blit.writeMask = (hwState.colorBitmask & 15) * 0x11111111u;
+	blit.readMask = (hwState.colorBitmask >> 4) * 0x11111111u;
+
+	//every row covers the same columns
+	const int width = i1 - i0;
+	const int dst_x = scr_x + i0;
+	const int firstNibble = dst_x & 1;
+	blit.rows = j1 - j0;
+	blit.dst = screenBuffer + (COMBINED_IDX(dst_x, scr_y + j0));
+
+	//nibble of the first sheet byte read that holds the first pixel drawn
+	int srcNibble;
+	int srcByte;
+	if (flip_x) {
+		int sxHi = spr_x + spr_w - 1 - i0;
+		srcByte = sxHi >> 1;
+		blit.srcBytes = srcByte - ((sxHi - width + 1) >> 1) + 1;
+		srcNibble = ~sxHi & 1;
+	}
+	else {
+		int sxLo = spr_x + i0;
+		srcByte = sxLo >> 1;
+		blit.srcBytes = ((sxLo + width - 1) >> 1) - srcByte + 1;
+		srcNibble = sxLo & 1;
+	}
+	const int spr_row = flip_y ? spr_y + spr_h - 1 - j0 : spr_y + j0;
+	blit.src = spritebuffer + (spr_row << 6) + srcByte;
+	blit.rowShift = 2 + srcNibble - firstNibble;
+
+	setSpriteBlitEdges(blit, firstNibble, width);
+
+	int kernel = (flip_x << 3) | (flip_y << 2) | (masked << 1) | (blit.rowShift & 1);
+	spriteBlitKernels[kernel](blit);
+}
+
+//per call state for the stretch blitter, after clipping
+struct StretchBlit {
+	const uint8_t* spritebuffer;
+	uint8_t* screenBuffer;
+	const uint8_t* paletteMap;
+	int scr_x;
+	int scr_y;
+	int scr_w;
+	int scr_h;
+	//sprite sheet coordinates and steps are 16.16 fixed point
+	int spr_x;
+	int spr_y;
+	int spr_w;
+	int dx;
+	int dy;
+	uint8_t writeMask;
+	uint8_t readMask;
+	bool skipStretchPx;
+};
+
+//one instance per flip_x and color bitmask set. flip_y is already folded into
+//spr_y and dy by the caller
+template <bool flipX, bool masked>
+static void stretchSpriteRows(const StretchBlit& blit) {
+	int prevSprX = -1;
+	int prevSprY = -1;
 
-					int screenPixelIdx = COMBINED_IDX(finalx, finaly);
-					if (lastScreenBuffIdx != screenPixelIdx) {
-						lastScreenBuffByte = screenBuffer[screenPixelIdx];
-						lastScreenBuffIdx = screenPixelIdx;
-					}
+	for (int y = 0; y < blit.scr_h; y++) {
+		int sprY = (blit.spr_y + y * blit.dy) >> 16;
+		if ((unsigned)sprY > 127) {
+			continue;
+		}
+		if (blit.skipStretchPx && prevSprY == sprY) {
+			continue;
+		}
+		prevSprY = sprY;
 
-					uint8_t source = (BITMASK(0) & finalx) == 0 
-						? lastScreenBuffByte & 0x0f //just first 4 bits
-						: lastScreenBuffByte >> 4;
+		const uint8_t* spr = blit.spritebuffer + (sprY * 64);
+		uint8_t* dst = blit.screenBuffer + ((blit.scr_y + y) * 64);
 
-					lc = (source & ~writeMask) | (lc & writeMask & readMask);
+		int sprX = flipX ? blit.spr_x + blit.spr_w - blit.dx : blit.spr_x;
+		const int stepX = flipX ? -blit.dx : blit.dx;
 
-					setPixelNibble(finalx, finaly, lc, screenBuffer);
-				}
-				++x;
-				if (flip_x){
-					--finalx;
-				}
-				else {
-					++finalx;
-				}
+		for (int x = 0; x < blit.scr_w; x++, sprX += stepX) {
+			int pix = sprX >> 16;
+			if ((unsigned)pix > 127) {
+				continue;
 			}
+			if (blit.skipStretchPx && prevSprX == pix) {
+				continue;
+			}
+			prevSprX = pix;
 
-			if (x < scr_w) {
-				if (!(drawState.drawPaletteMap[rc] >> 4)){
-					rc = drawState.drawPaletteMap[rc] & 0x0f;
-
-					int screenPixelIdx = COMBINED_IDX(finalx, finaly);
-					if (lastScreenBuffIdx != screenPixelIdx) {
-						lastScreenBuffByte = screenBuffer[screenPixelIdx];
-						lastScreenBuffIdx = screenPixelIdx;
-					}
-
-					uint8_t source = (BITMASK(0) & finalx) == 0 
-						? lastScreenBuffByte & 0x0f //just first 4 bits
-						: lastScreenBuffByte >> 4;
-
-					rc = (source & ~writeMask) | (rc & writeMask & readMask);
+			uint8_t c = (spr[pix >> 1] >> ((pix & 1) << 2)) & 0x0f;
+			if (blit.paletteMap[c] >> 4) {
+				continue;
+			}
+			c = blit.paletteMap[c] & 0x0f;
 
-					setPixelNibble(finalx, finaly, rc, screenBuffer);
-				}
+			const int finalx = blit.scr_x + x;
+			const int shift = (finalx & 1) << 2;
+			uint8_t& d = dst[finalx >> 1];
 
-				//we did two pixels so do an extra increment
-				++x;
+			if (masked) {
+				uint8_t source = (d >> shift) & 0x0f;
+				c = (source & ~blit.writeMask) | (c & blit.writeMask & blit.readMask);
 			}
-			
-		}
 
+			d = (d & ~(0x0f << shift)) | (c << shift);
+		}
 	}
 }
 
+typedef void (*StretchBlitKernel)(const StretchBlit& blit);
+
+//indexed by flip_x << 1 | masked
+static const StretchBlitKernel stretchBlitKernels[4] = {
+	stretchSpriteRows<false, false>,
+	stretchSpriteRows<false, true>,
+	stretchSpriteRows<true, false>,
+	stretchSpriteRows<true, true>,
+};
+
 //based on tac08 implementation of stretch_blitter()
 //uses ints so we can shift bits and do integer division instead of floating point
 void Graphics::copyStretchSpriteToScreen(
@@ -221,19 +582,15 @@ void Graphics::copyStretchSpriteToScreen(
 	if (scr_w == 0 || scr_h == 0)
 		return;
 
-	if (spr_h == scr_h && spr_w == scr_w && !flip_x) {
-		// use faster non stretch blitter if sprite is not stretched 
-		//(or flipped horizontally - but skipping for that is just a hacky fix)
+	if (spr_h == scr_h && spr_w == scr_w && (!flip_x || scr_w > 0)) {
+		// use faster non stretch blitter if sprite is not stretched
+		//(negative widths only flip in the stretch blitter)
 		copySpriteToScreen(spritebuffer, scr_x, scr_y, spr_x, spr_y, scr_w, scr_h, flip_x, flip_y);
 		return;
 	}
 
 	auto &drawState = _memory->drawState;
 	auto &hwState = _memory->hwState;
-	uint8_t *screenBuffer = GetP8FrameBuffer();
-
-	const uint8_t writeMask = hwState.colorBitmask & 15;
-	const uint8_t readMask = hwState.colorBitmask >> 4;
 
 	scr_x -= drawState.camera_x;
 	scr_y -= drawState.camera_y;
@@ -294,145 +651,36 @@ void Graphics::copyStretchSpriteToScreen(
 		scr_h -= nclip;
 	}
 
-	if (flip_y) {
-		spr_y += spr_h - 1 * dy;
-		dy = -dy;
+	if (scr_w <= 0 || scr_h <= 0) {
+		return;
 	}
 
-	int prevSprX = -1;
-	int prevSprY = -1;
-
-	//ugly duplication but see if inlining helps
-	if (hwState.colorBitmask == 0xff){
-		for (int y = 0; y < scr_h; y++) {
-			int sprY = ((spr_y + y * dy) >> 16);
-			if (sprY > 127) {
-				continue;
-			}
-			uint8_t* spr = spritebuffer + (sprY * 64);
+	markRowsDirty(scr_y, scr_y + scr_h - 1);
 
-			if (skipStretchPx && prevSprY == sprY){
-				continue;
-			}
-			
-			prevSprY = sprY;
-
-			if (!flip_x) {
-				for (int x = 0; x < scr_w; x++) {
-					int shiftedPixIndex = (spr_x + x * dx) >> 16;
-					if (shiftedPixIndex > 127) {
-						continue;
-					}
-					if (skipStretchPx && prevSprX == shiftedPixIndex){
-						continue;
-					}
-					prevSprX = shiftedPixIndex;
-					int preShiftedCombinedPixIndex = (shiftedPixIndex / 2);
-					uint8_t bothPix = spr[preShiftedCombinedPixIndex];
-
-					uint8_t c = FAST_MOD_2(shiftedPixIndex) == 0 
-						? bothPix & 0x0f //just first 4 bits
-						: bothPix >> 4;  //just last 4 bits
-
-					if (_memory->drawState.drawPaletteMap[c] >> 4){
-						continue;
-					}
-					c = drawState.drawPaletteMap[c] & 0x0f;
-					setPixelNibble(scr_x + x, scr_y + y, c, screenBuffer);
-				}
-			} else {
-				for (int x = 0; x < scr_w; x++) {
-					int pixIndex = (spr_x + spr_w - (x + 1) * dx);
-					int shiftedPixIndex = pixIndex >> 16;
-					if (shiftedPixIndex > 127) {
-						continue;
-					}
-					int combinedPixIdx = shiftedPixIndex / 2;
-					uint8_t bothPix = spr[combinedPixIdx];
-
-					uint8_t c = FAST_MOD_2(pixIndex >> 16) == 0 
-						? bothPix & 0x0f //just first 4 bits
-						: bothPix >> 4;  //just last 4 bits
-					
-					if (_memory->drawState.drawPaletteMap[c] >> 4){
-						continue;
-					}
-					c = drawState.drawPaletteMap[c] & 0x0f;
-					setPixelNibble(scr_x + x, scr_y + y, c, screenBuffer);
-				}
-			}
-		}
+	if (flip_y) {
+		spr_y += spr_h - 1 * dy;
+		dy = -dy;
 	}
-	else {
-		for (int y = 0; y < scr_h; y++) {
-			int sprY = ((spr_y + y * dy) >> 16);
-			if (sprY > 127) {
-				continue;
-			}
-			uint8_t* spr = spritebuffer + (sprY) * 64;
 
-			if (!flip_x) {
-				for (int x = 0; x < scr_w; x++) {
-					int shiftedPixIndex = (spr_x + x * dx) >> 16;
-					if (shiftedPixIndex > 127) {
-						continue;
-					}
-					int combinedPixIdx = (shiftedPixIndex / 2);
-					uint8_t bothPix = spr[combinedPixIdx];
+	StretchBlit blit;
+	blit.spritebuffer = spritebuffer;
+	blit.screenBuffer = GetP8FrameBuffer();
+	blit.paletteMap = drawState.drawPaletteMap;
+	blit.scr_x = scr_x;
+	blit.scr_y = scr_y;
+	blit.scr_w = scr_w;
+	blit.scr_h = scr_h;
+	blit.spr_x = spr_x;
+	blit.spr_y = spr_y;
+	blit.spr_w = spr_w;
+	blit.dx = dx;
+	blit.dy = dy;
+	blit.writeMask = hwState.colorBitmask & 15;
+	blit.readMask = hwState.colorBitmask >> 4;
+	blit.skipStretchPx = skipStretchPx;
 
-					uint8_t c = FAST_MOD_2(shiftedPixIndex) == 0 
-						? bothPix & 0x0f //just first 4 bits
-						: bothPix >> 4;  //just last 4 bits
-
-					if (_memory->drawState.drawPaletteMap[c] >> 4){
-						continue;
-					}
-					c = drawState.drawPaletteMap[c] & 0x0f;
-
-					const int finalx = scr_x + x;
-					const int finaly = scr_y + y;
-
-					uint8_t source = (BITMASK(0) & finalx) == 0 
-							? screenBuffer[COMBINED_IDX(finalx, finaly)] & 0x0f //just first 4 bits
-							: screenBuffer[COMBINED_IDX(finalx, finaly)] >> 4;
-
-					c = (source & ~writeMask) | (c & writeMask & readMask);
-
-					setPixelNibble(finalx, finaly, c, screenBuffer);
-				}
-			} else {
-				for (int x = 0; x < scr_w; x++) {
-					int pixIndex = (spr_x + spr_w - (x + 1) * dx);
-					int shiftedPixIndex = pixIndex >> 16;
-					if (shiftedPixIndex > 127) {
-						continue;
-					}
-					int combinedPixIdx = (shiftedPixIndex / 2);
-					uint8_t bothPix = spr[combinedPixIdx];
-
-					uint8_t c = FAST_MOD_2(pixIndex >> 16) == 0 
-						? bothPix & 0x0f //just first 4 bits
-						: bothPix >> 4;  //just last 4 bits
-
-					if (_memory->drawState.drawPaletteMap[c] >> 4){
-						continue;
-					}
-					c = drawState.drawPaletteMap[c] & 0x0f;
-					
-					const int finalx = scr_x + x;
-					const int finaly = scr_y + y;
-					
-					uint8_t source = (BITMASK(0) & finalx) == 0 
-							? screenBuffer[COMBINED_IDX(finalx, finaly)] & 0x0f //just first 4 bits
-							: screenBuffer[COMBINED_IDX(finalx, finaly)] >> 4;
-
-					c = (source & ~writeMask) | (c & writeMask & readMask);
-
-					setPixelNibble(finalx, finaly, c, screenBuffer);
-				}
-			}
-		}
-	}
+	const bool masked = hwState.colorBitmask != 0xff;
+	stretchBlitKernels[(flip_x << 1) | masked](blit);
 }
 
 void Graphics::swap(int *x, int *y) {
@@ -507,6 +755,18 @@ bool Graphics::isYWithinClip(int y) {
 		y < _memory->drawState.clip_ye;
 }
 
+bool Graphics::isRectOutsideClip(int x1, int y1, int x2, int y2) {
+	//an empty clip window (clip() off screen, or poked with begin past end)
+	//rejects everything, otherwise clamped spans would wrap into the next row
+	return
+		_memory->drawState.clip_xb >= _memory->drawState.clip_xe ||
+		_memory->drawState.clip_yb >= _memory->drawState.clip_ye ||
+		std::max(x1, x2) < _memory->drawState.clip_xb ||
+		std::min(x1, x2) >= _memory->drawState.clip_xe ||
+		std::max(y1, y2) < _memory->drawState.clip_yb ||
+		std::min(y1, y2) >= _memory->drawState.clip_ye;
+}
+
 int clampCoordToScreenDims(int val) {
 	return clamp(val, 0, 128);
 }
@@ -555,6 +815,7 @@ void Graphics::_setPixelFromSprite(int x, int y, uint8_t col) {
 		col = (source & ~writeMask) | (col & writeMask & readMask);
 	}
 
+	markRowDirty(y);
 	setPixelNibble(x, y, col, screenBuffer);
 }
 
@@ -607,6 +868,7 @@ void Graphics::_setPixelFromPen(int x, int y) {
 		finalC = (source & ~writeMask) | (finalC & writeMask & readMask);
 	}
 
+	markRowDirty(y);
 	setPixelNibble(x, y, finalC, screenBuffer);
 }
 //end helper methods
@@ -619,6 +881,7 @@ void Graphics::cls(uint8_t color) {
 	color = color & 15;
 	uint8_t val = color << 4 | color;
 	memset(GetP8FrameBuffer(), val, sizeof(_memory->screenBuffer));
+	markRowsDirty(0, 127);
 
 	_memory->drawState.text_x = 0;
 	_memory->drawState.text_y = 0;
@@ -704,7 +967,7 @@ void Graphics::_private_h_line(int x1, int x2, int y){
 	}
 
 	if ((x1 < drawState.clip_xb && x2 < drawState.clip_xb) ||
-		(x1 > drawState.clip_xe && x2 > drawState.clip_xe)) {
+		(x1 >= drawState.clip_xe && x2 >= drawState.clip_xe)) {
 			return;
 	}
 
@@ -725,6 +988,7 @@ void Graphics::_private_h_line(int x1, int x2, int y){
 
 	if (canmemset) {
 		//zepto 8 adapted otimized line draw with memset
+		markRowDirty(y);
 		uint8_t *p = screenBuffer + (y*64);
         uint8_t color = getDrawPalMappedColor(drawState.color);
 
@@ -745,8 +1009,53 @@ void Graphics::_private_h_line(int x1, int x2, int y){
         memset(p + minx / 2, color * 0x11, (maxx - minx + 1) / 2);
 	}
 	else {
-		for (int x = minx; x <= maxx; x++){
-			_setPixelFromPen(x, y);
+		//fill pattern and/or color bitmask: same result as _setPixelFromPen per pixel,
+		//but worked out once for the row and written a byte (2 pixels) at a time
+		markRowDirty(y);
+		uint8_t *p = screenBuffer + (y*64);
+
+		//this row of the pattern, leftmost pixel in bit 3
+		uint16_t fillp = ((uint16_t)drawState.fillPattern[1] << 8) + drawState.fillPattern[0];
+		uint8_t rowBits = (fillp >> (12 - 4 * (y & 3))) & 0x0f;
+
+		const uint8_t col0 = getDrawPalMappedColor(drawState.color) * 0x11;
+		const uint8_t col1 = getDrawPalMappedColor(drawState.color >> 4) * 0x11;
+		const bool altTransparent = drawState.fillPatternTransparencyBit & 1;
+
+		//from pico 8 wiki:
+		//dst_color = (dst_color & ~write_mask) | (src_color & write_mask & read_mask)
+		const uint8_t writeMask = (hwState.colorBitmask & 15) * 0x11;
+		const uint8_t readMask = (hwState.colorBitmask >> 4) * 0x11;
+
+		//the pattern repeats every 4 pixels, so every other byte. indexed by byte & 1
+		uint8_t colors[2];
+		uint8_t masks[2];
+		for (int i = 0; i < 2; i++) {
+			uint8_t alt = ((rowBits >> (3 - i * 2)) & 1 ? 0x0f : 0)
+				| ((rowBits >> (2 - i * 2)) & 1 ? 0xf0 : 0);
+			colors[i] = ((col0 & ~alt) | (col1 & alt)) & readMask;
+			masks[i] = (altTransparent ? ~alt : 0xff) & writeMask;
+		}
+
+		int first = minx >> 1;
+		int last = maxx >> 1;
+		uint8_t firstMask = (minx & 1) ? 0xf0 : 0xff;
+		uint8_t lastMask = (maxx & 1) ? 0xff : 0x0f;
+		if (first == last) {
+			firstMask &= lastMask;
+		}
+
+		uint8_t m = masks[first & 1] & firstMask;
+		p[first] = (p[first] & ~m) | (colors[first & 1] & m);
+
+		for (int b = first + 1; b < last; b++) {
+			m = masks[b & 1];
+			p[b] = (p[b] & ~m) | (colors[b & 1] & m);
+		}
+
+		if (last > first) {
+			m = masks[last & 1] & lastMask;
+			p[last] = (p[last] & ~m) | (colors[last & 1] & m);
 		}
 	}
 }
@@ -761,7 +1070,7 @@ void Graphics::_private_v_line (int y1, int y2, int x){
 	}
 
 	if ((y1 < drawState.clip_yb && y2 < drawState.clip_yb) ||
-		(y1 > drawState.clip_ye && y2 > drawState.clip_ye)) {
+		(y1 >= drawState.clip_ye && y2 >= drawState.clip_ye)) {
 			return;
 	}
 
@@ -784,6 +1093,8 @@ void Graphics::_private_v_line (int y1, int y2, int x){
 		uint8_t mask = (x & 1) ? 0x0f : 0xf0;
 		uint8_t nibble = (x & 1) ? color << 4 : color;
 
+		markRowsDirty(miny, maxy);
+
 		for (int16_t y = miny; y <= maxy; ++y)
         {
 			int pixIdx = COMBINED_IDX(x, y);
@@ -808,6 +1119,10 @@ void Graphics::line(int x0, int y0, int x1, int y1, uint8_t col) {
 
 	color(col);
 
+	if (isRectOutsideClip(x0, y0, x1, y1)) {
+		return;
+	}
+
 	//vertical line
 	if (x0 == x1) {
 		_private_v_line(y0, y1, x0);
@@ -866,6 +1181,12 @@ void Graphics::tline(int x0, int y0, int x1, int y1, fix32 mx, fix32 my, fix32 m
 	applyCameraToPoint(&x0, &y0);
 	applyCameraToPoint(&x1, &y1);
 
+	//the endpoints get clamped to the clip rect below, which would otherwise
+	//pull lines that are entirely outside it onto its edge
+	if (isRectOutsideClip(x0, y0, x1, y1)) {
+		return;
+	}
+
 	// Pre-compute inverse ranges to avoid expensive divisions in inner loop
 	float inv_x_range = (x1 != x0) ? (1.0f / (x1 - x0)) : 0.0f;
 	float inv_y_range = (y1 != y0) ? (1.0f / (y1 - y0)) : 0.0f;
@@ -959,6 +1280,10 @@ void Graphics::circ(int ox, int oy, int r, uint8_t col){
 
 	applyCameraToPoint(&ox, &oy);
 
+	if (r < 0 || isRectOutsideClip(ox - r, oy - r, ox + r, oy + r)) {
+		return;
+	}
+
 	int x = r;
 	int y = 0;
 	int decisionOver2 = 1-x;
@@ -999,6 +1324,10 @@ void Graphics::circfill(int ox, int oy, int r, uint8_t col){
 
 	applyCameraToPoint(&ox, &oy);
 
+	if (r < 0 || isRectOutsideClip(ox - r, oy - r, ox + r, oy + r)) {
+		return;
+	}
+
 	if (r == 0) {
 		_safeSetPixelFromPen(ox, oy);
 	}
@@ -1009,9 +1338,15 @@ void Graphics::circfill(int ox, int oy, int r, uint8_t col){
 	}
 	else if (r > 0) {
 		int x = -r, y = 0, err = 2 - 2 * r;
+		//x only grows while y stays put, so the first span on each row is the widest
+		//and the rest are already covered
+		int lastY = -1;
 		do {
-			_private_h_line(ox - x, ox + x, oy + y);
-			_private_h_line(ox - x, ox + x, oy - y);
+			if (y != lastY) {
+				_private_h_line(ox - x, ox + x, oy + y);
+				_private_h_line(ox - x, ox + x, oy - y);
+				lastY = y;
+			}
 			r = err;
 			if (r > x)
 				err += ++x * 2 + 1;
@@ -1034,6 +1369,10 @@ void Graphics::oval(int x0, int y0, int x1, int y1, uint8_t col) {
 
 	sortCoordsForRect(&x0, &y0, &x1, &y1);
 
+	if (isRectOutsideClip(x0, y0, x1, y1)) {
+		return;
+	}
+
 	//x radius and y radius
 	int xr = (x1 - x0) / 2;
 	int yr = (y1 - y0) / 2;
@@ -1129,6 +1468,10 @@ void Graphics::ovalfill(int x0, int y0, int x1, int y1, uint8_t col){
 
 	sortCoordsForRect(&x0, &y0, &x1, &y1);
 
+	if (isRectOutsideClip(x0, y0, x1, y1)) {
+		return;
+	}
+
 	//x radius and y radius
 	int xr = (x1 - x0) / 2;
 	int yr = (y1 - y0) / 2;
@@ -1250,6 +1593,10 @@ void Graphics::rect(int x1, int y1, int x2, int y2, uint8_t col) {
 		y2 = temp;
 	}
 
+	if (isRectOutsideClip(x1, y1, x2, y2)) {
+		return;
+	}
+
 	_private_h_line(x1, x2, y1);
 	_private_h_line(x1, x2, y2);
 
@@ -1286,6 +1633,14 @@ void Graphics::rectfill(int x1, int y1, int x2, int y2, uint8_t col) {
 		y2 = temp;
 	}
 
+	if (isRectOutsideClip(x1, y1, x2, y2)) {
+		return;
+	}
+
+	//only the rows inside the clip rect
+	y1 = std::max(y1, (int)drawState.clip_yb);
+	y2 = std::min(y2, (int)drawState.clip_ye - 1);
+
 	for (int y = y1; y <= y2; y++) {
 		_private_h_line(x1, x2, y);
 	}
@@ -1409,6 +1764,9 @@ std::tuple<int, int> Graphics::drawCharacterFromBytes(
 	fgColor &= 0x0f;
 	bgColor &= 0x0f;
 
+	markRowsDirty(std::max(y, (int)_memory->drawState.clip_yb),
+		std::min(y + charHeight * hFactor, (int)_memory->drawState.clip_ye) - 1);
+
 	for (int relDestY = 0; relDestY < charHeight * hFactor; relDestY++) {
 		for(int relDestX = 0; relDestX < charWidth * wFactor; relDestX++) {
 
@@ -1500,7 +1858,11 @@ uint8_t Graphics::sget(uint8_t x, uint8_t y){
 
 void Graphics::sset(uint8_t x, uint8_t y, uint8_t c){
 	if (IS_VALID_SPR_IDX(x, y)) {
-		setPixelNibble(x, y, c, GetP8SpriteSheetBuffer());
+		uint8_t* spriteSheet = GetP8SpriteSheetBuffer();
+		if (spriteSheet == GetP8FrameBuffer()) {
+			markRowDirty(y);
+		}
+		setPixelNibble(x, y, c, spriteSheet);
 	}
 	return;
 }
@@ -1609,14 +1971,94 @@ void Graphics::map(int celx, int cely, int sx, int sy, int celw, int celh) {
 	map(celx, cely, sx, sy, celw, celh, 0);
 }
 
+//draws the visible part of the cell rectangle a tile row at a time. map memory is
+//resolved once, cells that would land outside the clip rect are never read, and
+//tiles fully inside it go straight to the sprite blit kernel with no per tile clipping
 void Graphics::map(int celx, int cely, int sx, int sy, int celw, int celh, uint8_t layer) {
-	for (int y = 0; y < celh; y++) {
-		for (int x = 0; x < celw; x++) {
-			uint8_t cell = mget(celx + x, cely + y);
-			if (cell && ((layer == 0) || (fget(cell) & layer))) {
-				spr(cell, sx + x * 8, sy + y * 8);
+	auto &drawState = _memory->drawState;
+	auto &hwState = _memory->hwState;
+
+	const bool bigMap = hwState.mapMemMapping >= 0x80;
+	const int mapSize = bigMap
+		? 0x10000 - (hwState.mapMemMapping << 8)
+		: 8192;
+	const int mapW = hwState.widthOfTheMap == 0 ? 256 : hwState.widthOfTheMap;
+	const int mapH = mapSize / mapW;
+	//cell idx is at data[mapBase + idx], apart from the first 4096 cells of the
+	//regular map which are at 0x2000 (the rest are in the shared sprite sheet half)
+	const int mapBase = bigMap ? 0x10000 - mapSize : 0;
+
+	const int scr_x = sx - drawState.camera_x;
+	const int scr_y = sy - drawState.camera_y;
+
+	//cells (relative to celx, cely) that land at least partly inside the clip rect
+	//and inside the map
+	const int x0 = std::max({0, -celx, (drawState.clip_xb - scr_x) >> 3});
+	const int x1 = std::min({celw, mapW - celx, (drawState.clip_xe - scr_x + 7) >> 3});
+	const int y0 = std::max({0, -cely, (drawState.clip_yb - scr_y) >> 3});
+	const int y1 = std::min({celh, mapH - cely, (drawState.clip_ye - scr_y + 7) >> 3});
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+
+	//cells whose tile is entirely inside the clip rect
+	const int innerX0 = (drawState.clip_xb - scr_x + 7) >> 3;
+	const int innerX1 = (drawState.clip_xe - scr_x) >> 3;
+	const int innerY0 = (drawState.clip_yb - scr_y + 7) >> 3;
+	const int innerY1 = (drawState.clip_ye - scr_y) >> 3;
+
+	uint8_t* spritebuffer = GetP8SpriteSheetBuffer();
+	uint8_t* screenBuffer = GetP8FrameBuffer();
+
+	if (memcmp(_blitLutPalette, drawState.drawPaletteMap, sizeof(_blitLutPalette)) != 0) {
+		refreshBlitLuts();
+	}
+
+	//every inner tile is 8x8, unflipped, and has the same screen x parity
+	//(tiles always start on an even sprite sheet x), so they share one kernel setup
+	SpriteBlit tile;
+	tile.colorLut = _blitColorLut;
+	tile.opaqueLut = _blitOpaqueLut;
+	tile.rows = 8;
+	tile.srcBytes = 4;
+	tile.rowShift = 2 - (scr_x & 1);
+	tile.writeMask = (hwState.colorBitmask & 15) * 0x11111111u;
+	tile.readMask = (hwState.colorBitmask >> 4) * 0x11111111u;
+	setSpriteBlitEdges(tile, scr_x & 1, 8);
+	const bool masked = hwState.colorBitmask != 0xff;
+	const SpriteBlitKernel tileKernel = spriteBlitKernels[(masked << 1) | (scr_x & 1)];
+
+	for (int y = y0; y < y1; y++) {
+		const int rowIdx = (cely + y) * mapW + celx;
+		const int tile_y = scr_y + y * 8;
+		const bool innerRow = y >= innerY0 && y < innerY1;
+		bool drewInnerTile = false;
+
+		for (int x = x0; x < x1; x++) {
+			const int idx = rowIdx + x;
+			const uint8_t cell = _memory->data[(bigMap || idx >= 4096 ? mapBase : 0x2000) + idx];
+			if (!cell || (layer && !(_memory->spriteFlags[cell] & layer))) {
+				continue;
+			}
+
+			const int spr_x = FAST_MOD_16(cell) * 8;
+			const int spr_y = (cell / 16) * 8;
+
+			if (innerRow && x >= innerX0 && x < innerX1) {
+				const int tile_x = scr_x + x * 8;
+				tile.src = spritebuffer + (spr_y << 6) + (spr_x >> 1);
+				tile.dst = screenBuffer + (COMBINED_IDX(tile_x, tile_y));
+				tileKernel(tile);
+				drewInnerTile = true;
+			}
+			else {
+				copySpriteToScreen(spritebuffer, sx + x * 8, sy + y * 8, spr_x, spr_y, 8, 8, false, false);
 			}
 		}
+
+		if (drewInnerTile) {
+			markRowsDirty(tile_y, tile_y + 7);
+		}
 	}
 }
 
@@ -1625,6 +2067,7 @@ void Graphics::pal() {
 		_memory->drawState.drawPaletteMap[c] = c;
 		_memory->drawState.screenPaletteMap[c] = c;
 	}
+	markPaletteDirty();
 
 	this->palt();
 }
@@ -1637,6 +2080,9 @@ void Graphics::pal(uint8_t p) {
 			_memory->drawState.screenPaletteMap[c] = c;
 		}
 	}
+	if (p == 1) {
+		markPaletteDirty();
+	}
 }
 
 uint8_t Graphics::pal(uint8_t c0, uint8_t c1, uint8_t p){
@@ -1652,6 +2098,7 @@ uint8_t Graphics::pal(uint8_t c0, uint8_t c1, uint8_t p){
 		prev = _memory->drawState.screenPaletteMap[c0] & 0xf;
 		c1 &= 0x8f;
 		_memory->drawState.screenPaletteMap[c0] = c1;
+		markPaletteDirty();
 	}
 
 	return prev;
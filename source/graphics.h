@@ -14,6 +14,31 @@ class Graphics {
 
 	PicoRam* _memory;
 
+	ScreenDirtyState_t _dirtyState;
+
+	inline void markRowDirty(int y) {
+		_dirtyState.rows[(y >> 5) & 3] |= 1u << (y & 31);
+	}
+	void markRowsDirty(int y0, int y1);
+
+	//the screen with the draw mode (stretch/mirror/flip/rotate) applied
+	uint8_t _presentedBuffer[128 * 64];
+	//one byte per pixel copy of the screen, for the rotated modes
+	uint8_t _rotateScratch[128 * 128];
+	//snapshot of 0x5f5f-0x5f7f taken when the frame is presented
+	AltScreenPalette_t _altScreenPalette;
+
+	void presentRotated(const uint8_t* fb, bool clockwise);
+
+	//sprite blitter lookups for a whole byte (2 pixels) of sprite data:
+	//the draw palette mapped colors, and 0xf in each nibble that is not transparent.
+	//rebuilt whenever drawPaletteMap no longer matches the copy they were built from
+	uint8_t _blitLutPalette[16];
+	uint8_t _blitColorLut[256];
+	uint8_t _blitOpaqueLut[256];
+
+	void refreshBlitLuts();
+
 	void copySpriteToScreen(
 		uint8_t* spritebuffer,
 		int scr_x,
@@ -50,6 +75,8 @@ class Graphics {
 	bool isWithinClip(int x, int y);
 	bool isXWithinClip(int x);
 	bool isYWithinClip(int y);
+	//whether a box (inclusive, already camera adjusted) misses the clip rect entirely
+	bool isRectOutsideClip(int x1, int y1, int x2, int y2);
 	int clampXCoordToClip(int x);
 	int clampYCoordToClip(int y);
 
@@ -65,6 +92,19 @@ class Graphics {
 	uint8_t* GetP8FrameBuffer();
 	uint8_t* GetP8SpriteSheetBuffer();
 	uint8_t* GetScreenPaletteMap();
+	//what the host should show: the frame buffer itself for the plain draw modes,
+	//otherwise a transformed copy. any mode but the plain ones marks every row dirty
+	uint8_t* GetPresentedFrameBuffer();
+	//per scanline secondary palette for the last presented frame
+	AltScreenPalette_t* GetAltScreenPalette();
+
+	//dirty scanline tracking for hosts
+	ScreenDirtyState_t* GetScreenDirtyState();
+	void clearScreenDirtyState();
+	void markAllDirty();
+	void markPaletteDirty();
+	//for writes straight to pico 8 ram (poke, memcpy, etc)
+	void markMemoryDirty(int addr, int len);
 
 	bool isColorTransparent(uint8_t color);
 	uint8_t getDrawPalMappedColor(uint8_t color);
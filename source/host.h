@@ -96,6 +96,11 @@ class Host {
 
     Color _paletteColors[144];
 
+    //owned by the vm's graphics. drawFrame can use it to skip unchanged rows
+    ScreenDirtyState_t* _screenDirtyState = nullptr;
+    //refreshed by the vm each time it presents a frame
+    AltScreenPalette_t* _altScreenPalette = nullptr;
+
     public:
     Host();
 
@@ -142,6 +147,8 @@ class Host {
     void writeBufferToFile(std::string cartDataKey, char* buffer, size_t length);
 
     std::string getCartDirectory();
+    //where parsed carts are cached between launches. "" disables the cache
+    std::string getCartCacheDirectory();
 	
     //settings
     int getSetting(std::string sname);
@@ -149,6 +156,9 @@ class Host {
 
     Color* GetPaletteColors();
 
+    void setScreenDirtyState(ScreenDirtyState_t* dirtyState) { _screenDirtyState = dirtyState; }
+    void setAltScreenPalette(AltScreenPalette_t* altScreenPalette) { _altScreenPalette = altScreenPalette; }
+
     void setPlatformParams(
         int windowWidth,
         int windowHeight,
@@ -1,4 +1,5 @@
 #include <string>
+#include <sys/stat.h>
 
 #include "host.h"
 #include "hostVmShared.h"
@@ -218,6 +219,17 @@ std::string Host::getCartDataFile(std::string cartDataKey) {
     return _logFilePrefix + "cdata/" + cartDataKey + ".p8d.txt";
 }
 
+std::string Host::getCartCacheDirectory() {
+    std::string cacheDir = _logFilePrefix + "ccache";
+
+    struct stat st = {0};
+    if (stat(cacheDir.c_str(), &st) == -1 && mkdir(cacheDir.c_str(), 0777) != 0) {
+        return "";
+    }
+
+    return cacheDir + "/";
+}
+
 std::string Host::getCartDataFileContents(std::string cartDataKey) {
     return get_file_contents(getCartDataFile(cartDataKey));
 }
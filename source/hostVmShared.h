@@ -68,6 +68,40 @@ struct Bgr24Col {
 	uint8_t Red;
 };
 
+//scanlines of the displayed 128x128 buffer written since the host last presented
+//it. hosts can skip converting/uploading rows whose bit is clear, unless
+//paletteChanged is set (then every row's colors may be different)
+struct ScreenDirtyState_t {
+	uint32_t rows[4];
+	bool paletteChanged;
+};
+
+inline bool isScreenRowDirty(const ScreenDirtyState_t* state, int y) {
+	return state->paletteChanged || ((state->rows[y >> 5] >> (y & 31)) & 1);
+}
+
+inline bool isScreenDirty(const ScreenDirtyState_t* state) {
+	return state->paletteChanged ||
+		(state->rows[0] | state->rows[1] | state->rows[2] | state->rows[3]) != 0;
+}
+
+inline void resetScreenDirtyState(ScreenDirtyState_t* state) {
+	state->rows[0] = state->rows[1] = state->rows[2] = state->rows[3] = 0;
+	state->paletteChanged = false;
+}
+
+//secondary screen palette (0x5f5f-0x5f7f). when enabled, display lines whose
+//bit is set in lineBitfield use paletteMap instead of the screen palette
+struct AltScreenPalette_t {
+	bool enabled;
+	uint8_t paletteMap[16];
+	uint8_t lineBitfield[16];
+};
+
+inline bool isAltPaletteLine(const AltScreenPalette_t* alt, int y) {
+	return alt->enabled && ((alt->lineBitfield[y >> 3] >> (y & 7)) & 1);
+}
+
 struct InputState_t {
 	uint8_t KDown;
 	uint8_t KHeld;
@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "luaAllocator.h"
+#include "logger.h"
+
+//headers are 16 bytes so blocks after them keep malloc's alignment
+struct LuaArenaChunk {
+    LuaArenaChunk* next;
+    size_t size;
+};
+
+struct LuaArenaLargeBlock {
+    LuaArenaLargeBlock* prev;
+    LuaArenaLargeBlock* next;
+};
+
+static_assert(sizeof(LuaArenaChunk) % 8 == 0, "chunk header breaks alignment");
+static_assert(sizeof(LuaArenaLargeBlock) % 8 == 0, "large block header breaks alignment");
+
+//8 byte steps up to 128, then 32 byte steps up to 256
+static inline int sizeClassIndex(size_t size) {
+    if (size <= 128) {
+        return (int)((size + 7) >> 3) - 1;
+    }
+
+    return 16 + (int)((size - 129) >> 5);
+}
+
+static inline size_t sizeClassBytes(int idx) {
+    if (idx < 16) {
+        return (size_t)(idx + 1) << 3;
+    }
+
+    return 128 + ((size_t)(idx - 15) << 5);
+}
+
+static void* arenaAllocSmall(LuaAllocatorState* state, size_t size) {
+    int idx = sizeClassIndex(size);
+
+    void* block = state->freeLists[idx];
+    if (block != nullptr) {
+        state->freeLists[idx] = *(void**)block;
+        state->stats.freeListReuses++;
+        return block;
+    }
+
+    size_t classBytes = sizeClassBytes(idx);
+    if ((size_t)(state->bumpEnd - state->bumpPtr) < classBytes) {
+        LuaArenaChunk* chunk = state->spareChunks;
+        if (chunk != nullptr) {
+            state->spareChunks = chunk->next;
+        }
+        else {
+            chunk = (LuaArenaChunk*)malloc(LUA_ARENA_CHUNK_SIZE);
+            if (chunk == nullptr) {
+                return nullptr;
+            }
+            chunk->size = LUA_ARENA_CHUNK_SIZE;
+            state->stats.chunkCount++;
+            state->stats.reservedBytes += LUA_ARENA_CHUNK_SIZE;
+        }
+
+        //the tail of the previous chunk is abandoned; it is at most one block
+        chunk->next = state->chunks;
+        state->chunks = chunk;
+        state->bumpPtr = (char*)(chunk + 1);
+        state->bumpEnd = (char*)chunk + chunk->size;
+    }
+
+    block = state->bumpPtr;
+    state->bumpPtr += classBytes;
+
+    return block;
+}
+
+static void arenaFreeSmall(LuaAllocatorState* state, void* ptr, size_t size) {
+    int idx = sizeClassIndex(size);
+    *(void**)ptr = state->freeLists[idx];
+    state->freeLists[idx] = ptr;
+}
+
+static void* arenaReallocLarge(LuaAllocatorState* state, void* ptr, size_t size) {
+    LuaArenaLargeBlock* old = ptr == nullptr ? nullptr : (LuaArenaLargeBlock*)ptr - 1;
+
+    LuaArenaLargeBlock* block =
+        (LuaArenaLargeBlock*)realloc(old, sizeof(LuaArenaLargeBlock) + size);
+    if (block == nullptr) {
+        return nullptr;
+    }
+
+    if (old == nullptr) {
+        block->prev = nullptr;
+        block->next = state->largeBlocks;
+        if (block->next != nullptr) {
+            block->next->prev = block;
+        }
+        state->largeBlocks = block;
+        state->stats.largeBlockCount++;
+    }
+    else if (block != old) {
+        //relink neighbours to the moved block
+        if (block->prev != nullptr) {
+            block->prev->next = block;
+        }
+        else {
+            state->largeBlocks = block;
+        }
+        if (block->next != nullptr) {
+            block->next->prev = block;
+        }
+    }
+
+    return block + 1;
+}
+
+static void arenaFreeLarge(LuaAllocatorState* state, void* ptr) {
+    LuaArenaLargeBlock* block = (LuaArenaLargeBlock*)ptr - 1;
+
+    if (block->prev != nullptr) {
+        block->prev->next = block->next;
+    }
+    else {
+        state->largeBlocks = block->next;
+    }
+    if (block->next != nullptr) {
+        block->next->prev = block->prev;
+    }
+
+    state->stats.largeBlockCount--;
+    free(block);
+}
+
+void initLuaAllocatorState(LuaAllocatorState* state, size_t limitBytes) {
+    memset(state, 0, sizeof(LuaAllocatorState));
+    state->limitBytes = limitBytes;
+}
+
+void resetLuaAllocatorState(LuaAllocatorState* state, size_t limitBytes) {
+    LuaArenaLargeBlock* large = state->largeBlocks;
+    while (large != nullptr) {
+        LuaArenaLargeBlock* next = large->next;
+        free(large);
+        large = next;
+    }
+
+    //keep a few chunks for the next cart, give the rest back
+    size_t spareCount = 0;
+    for (LuaArenaChunk* spare = state->spareChunks; spare != nullptr; spare = spare->next) {
+        spareCount++;
+    }
+
+    LuaArenaChunk* chunk = state->chunks;
+    while (chunk != nullptr) {
+        LuaArenaChunk* next = chunk->next;
+        if (spareCount < LUA_ARENA_SPARE_CHUNKS) {
+            chunk->next = state->spareChunks;
+            state->spareChunks = chunk;
+            spareCount++;
+        }
+        else {
+            state->stats.chunkCount--;
+            state->stats.reservedBytes -= chunk->size;
+            free(chunk);
+        }
+        chunk = next;
+    }
+
+    memset(state->freeLists, 0, sizeof(state->freeLists));
+    state->chunks = nullptr;
+    state->bumpPtr = nullptr;
+    state->bumpEnd = nullptr;
+    state->largeBlocks = nullptr;
+    state->stats.largeBlockCount = 0;
+    state->stats.resets++;
+
+    state->liveBytes = 0;
+    state->peakBytes = 0;
+    state->limitBytes = limitBytes;
+    state->limitExceeded = false;
+}
+
+void destroyLuaAllocatorState(LuaAllocatorState* state) {
+    resetLuaAllocatorState(state, state->limitBytes);
+
+    LuaArenaChunk* chunk = state->spareChunks;
+    while (chunk != nullptr) {
+        LuaArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    state->spareChunks = nullptr;
+    state->stats.chunkCount = 0;
+    state->stats.reservedBytes = 0;
+}
+
+void* picoLuaAlloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+    LuaAllocatorState* state = (LuaAllocatorState*)ud;
+
+    //when ptr is null, osize is the type of object being allocated, not a size
+    if (ptr == nullptr) {
+        osize = 0;
+    }
+
+    if (nsize == 0) {
+        if (ptr != nullptr) {
+            if (osize <= LUA_ARENA_MAX_SMALL) {
+                arenaFreeSmall(state, ptr, osize);
+            }
+            else {
+                arenaFreeLarge(state, ptr);
+            }
+        }
+        state->liveBytes -= osize;
+        return nullptr;
+    }
+
+    //lua expects shrinking to always succeed, so only growth is checked against the limit
+    if (nsize > osize && state->limitBytes > 0 &&
+        state->liveBytes - osize + nsize > state->limitBytes) {
+        if (!state->limitExceeded) {
+            Logger_Write("lua memory limit of %zu bytes exceeded\n", state->limitBytes);
+        }
+        state->limitExceeded = true;
+        return nullptr;
+    }
+
+    bool oldSmall = ptr == nullptr || osize <= LUA_ARENA_MAX_SMALL;
+    bool newSmall = nsize <= LUA_ARENA_MAX_SMALL;
+    void* newPtr;
+
+    if (ptr != nullptr && oldSmall && newSmall && sizeClassIndex(osize) == sizeClassIndex(nsize)) {
+        //still fits in the same block
+        newPtr = ptr;
+    }
+    else if (!oldSmall && !newSmall) {
+        newPtr = arenaReallocLarge(state, ptr, nsize);
+        if (newPtr == nullptr) {
+            //a failed realloc leaves the block as it was
+            if (nsize > osize) {
+                return nullptr;
+            }
+            newPtr = ptr;
+        }
+        state->stats.largeAllocs++;
+    }
+    else {
+        if (newSmall) {
+            newPtr = arenaAllocSmall(state, nsize);
+            state->stats.smallAllocs++;
+        }
+        else {
+            newPtr = arenaReallocLarge(state, nullptr, nsize);
+            state->stats.largeAllocs++;
+        }
+
+        if (newPtr == nullptr) {
+            if (nsize > osize) {
+                return nullptr;
+            }
+            //lua can't handle a failed shrink, so keep the old block. freeing it
+            //later as the smaller size just puts it on a smaller size class list.
+            //a large block stays linked in largeBlocks and is released on reset
+            newPtr = ptr;
+        }
+        else if (ptr != nullptr) {
+            memcpy(newPtr, ptr, osize < nsize ? osize : nsize);
+            if (oldSmall) {
+                arenaFreeSmall(state, ptr, osize);
+            }
+            else {
+                arenaFreeLarge(state, ptr);
+            }
+        }
+    }
+
+    state->liveBytes = state->liveBytes - osize + nsize;
+    if (state->liveBytes > state->peakBytes) {
+        state->peakBytes = state->liveBytes;
+    }
+
+    return newPtr;
+}
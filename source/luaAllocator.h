@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+
+//pico 8 carts get 2MB of lua memory
+#define PICO_LUA_MEMORY_LIMIT (2 * 1024 * 1024)
+
+//small allocations are served from size class free lists carved out of
+//large chunks. everything is released at once when the cart is closed
+#define LUA_ARENA_CLASS_COUNT 20
+#define LUA_ARENA_MAX_SMALL 256
+#define LUA_ARENA_CHUNK_SIZE (64 * 1024)
+//chunks kept around after a reset so the next cart doesn't go back to malloc
+#define LUA_ARENA_SPARE_CHUNKS 8
+
+struct LuaArenaChunk;
+struct LuaArenaLargeBlock;
+
+struct LuaArenaStats {
+    size_t chunkCount;
+    size_t reservedBytes;
+    size_t largeBlockCount;
+    size_t smallAllocs;
+    size_t largeAllocs;
+    size_t freeListReuses;
+    size_t resets;
+};
+
+struct LuaAllocatorState {
+    size_t liveBytes;
+    size_t peakBytes;
+    //0 means no limit
+    size_t limitBytes;
+    bool limitExceeded;
+
+    void* freeLists[LUA_ARENA_CLASS_COUNT];
+    LuaArenaChunk* chunks;
+    LuaArenaChunk* spareChunks;
+    char* bumpPtr;
+    char* bumpEnd;
+    LuaArenaLargeBlock* largeBlocks;
+
+    LuaArenaStats stats;
+};
+
+void initLuaAllocatorState(LuaAllocatorState* state, size_t limitBytes);
+
+//releases every allocation made through the state in one go. any lua_State
+//using it must not be touched afterwards
+void resetLuaAllocatorState(LuaAllocatorState* state, size_t limitBytes);
+
+//reset, and also free the spare chunks
+void destroyLuaAllocatorState(LuaAllocatorState* state);
+
+//lua_Alloc implementation. ud must point to a LuaAllocatorState.
+//growing past limitBytes fails the allocation, which lua reports as a memory error
+void* picoLuaAlloc(void *ud, void *ptr, size_t osize, size_t nsize);
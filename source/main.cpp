@@ -71,8 +71,15 @@ int main(int argc, char* argv[])
 	// Main loop
 	Logger_Write("Starting main loop\n");
 
+	#ifdef AUDIO_LOOKAHEAD_MS
+	//push model hosts can opt into rendering audio ahead of the frame loop
+	vm->StartAudioRenderThread(AUDIO_LOOKAHEAD_MS);
+	#endif
+
 	vm->GameLoop();
 
+	vm->StopAudioRenderThread();
+
 	Logger_Write("Turning off vm and exiting logger\n");
 	vm->CloseCart();
 
@@ -14,7 +14,10 @@ const char * p8GlobalLuaFunctions = R"#(
 --string indexing: https://lua-users.org/wiki/StringIndexing
 getmetatable('').__index = function(str,i) return string.sub(str,i,i) end
 
---from zepto 8 bios.p8
+)#"
+#ifndef FAKE08_NATIVE_TABLE_HELPERS
+//with FAKE08_NATIVE_TABLE_HELPERS these are registered from picoluaapi.cpp instead
+R"#(--from zepto 8 bios.p8
 -- PicoLove functions did not return values added/deleted
 
 function all(c)
@@ -90,7 +93,9 @@ function deli(c,i)
     end
 end
 
-function serial(chan, address, len)
+)#"
+#endif
+R"#(function serial(chan, address, len)
     --stubbed out
     --return len
 end
@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include <algorithm>
 using namespace std;
 
 #include "picoluaapi.h"
@@ -778,20 +779,19 @@ int stat(lua_State *L) {
     switch(n){
         //0 memory usage
         case 0:
-            //TODO: get from z8lua
-            lua_pushnumber(L, 1);
+            //in KiB, like pico 8
+            lua_pushnumber(L, _vmForLuaApi->getLuaMemoryUsage() / 1024.0);
             return 1;
         break;
-        //cpu usage
+        //cpu usage so far this frame
         case 1:
-            // stubbed to return 50%
-            lua_pushnumber(L, 0.5);
+            lua_pushnumber(L, _vmForLuaApi->getCpuUsage());
             return 1;
         break;
         //cpu usage (without system calls)
+        //host overhead isn't split out, so report the last complete frame
         case 2:
-            // stubbed to return 50%
-            lua_pushnumber(L, 0.5);
+            lua_pushnumber(L, _vmForLuaApi->getPrevFrameCpuUsage());
             return 1;
         break;
         //clipboard contents
@@ -1162,6 +1162,276 @@ int reload(lua_State *L) {
     return 0;
 }
 
+//Tables
+//with FAKE08_NATIVE_TABLE_HELPERS these replace the zepto8 bios lua versions
+//and do the same table operations in the same order. tables without a
+//metatable use raw access, anything else goes through the metamethods like
+//the lua code did
+#ifdef FAKE08_NATIVE_TABLE_HELPERS
+
+static bool isPlainTable(lua_State *L, int idx) {
+    if (!lua_istable(L, idx)) {
+        return false;
+    }
+    if (lua_getmetatable(L, idx)) {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    return true;
+}
+
+//#c
+static int tableLength(lua_State *L, int idx, bool plain) {
+    if (plain) {
+        return (int)lua_rawlen(L, idx);
+    }
+
+    int type = lua_type(L, idx);
+    if (type != LUA_TTABLE && type != LUA_TSTRING) {
+        if (!luaL_getmetafield(L, idx, "__len")) {
+            return luaL_error(L, "attempt to get length of local 'c' (a %s value)", luaL_typename(L, idx));
+        }
+        lua_pop(L, 1);
+    }
+
+    lua_len(L, idx);
+    int len = (int)lua_tonumber(L, -1);
+    lua_pop(L, 1);
+
+    return len;
+}
+
+//pushes c[i]
+static void pushIndex(lua_State *L, int idx, int i, bool plain) {
+    if (plain) {
+        lua_rawgeti(L, idx, i);
+        return;
+    }
+
+    lua_pushnumber(L, i);
+    lua_gettable(L, idx);
+}
+
+//pops a value into c[i]
+static void setIndex(lua_State *L, int idx, int i, bool plain) {
+    if (plain) {
+        lua_rawseti(L, idx, i);
+        return;
+    }
+
+    lua_pushnumber(L, i);
+    lua_insert(L, -2);
+    lua_settable(L, idx);
+}
+
+//i\1 for the optional index arguments of add and deli
+static int floorArg(lua_State *L, int idx) {
+    fix32 val = luaL_checknumber(L, idx);
+
+    return val.bits() >> 16;
+}
+
+static int mid3(int a, int b, int c) {
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+//one step of all(): moves past the value returned last (at prev) unless it was
+//deleted during the iteration, skips nils up to #c and pushes the next value
+static int allStep(lua_State *L, int c, int i, int prev) {
+    bool plain = isPlainTable(L, c);
+
+    //increment unless the current value changed
+    pushIndex(L, c, i, plain);
+    if (lua_compare(L, -1, prev, LUA_OPEQ)) {
+        i++;
+    }
+    lua_pop(L, 1);
+
+    //skip until non-nil or end of table
+    if (plain) {
+        int len = (int)lua_rawlen(L, c);
+        lua_rawgeti(L, c, i);
+        while (i <= len && lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            lua_rawgeti(L, c, ++i);
+        }
+    }
+    else {
+        while (i <= tableLength(L, c, false)) {
+            pushIndex(L, c, i, false);
+            bool isNil = lua_isnil(L, -1);
+            lua_pop(L, 1);
+            if (!isNil) {
+                break;
+            }
+            i++;
+        }
+        pushIndex(L, c, i, false);
+    }
+
+    return i;
+}
+
+//upvalues: the table (nil when there is nothing to iterate), index, previous value
+int allnext(lua_State *L) {
+    if (lua_isnil(L, lua_upvalueindex(1))) {
+        return 0;
+    }
+
+    int i = (int)lua_tonumber(L, lua_upvalueindex(2));
+    i = allStep(L, lua_upvalueindex(1), i, lua_upvalueindex(3));
+
+    lua_pushnumber(L, i);
+    lua_replace(L, lua_upvalueindex(2));
+    lua_pushvalue(L, -1);
+    lua_replace(L, lua_upvalueindex(3));
+
+    return 1;
+}
+
+int all(lua_State *L) {
+    bool empty = lua_isnoneornil(L, 1) || tableLength(L, 1, isPlainTable(L, 1)) == 0;
+
+    if (empty) {
+        lua_pushnil(L);
+    }
+    else {
+        lua_pushvalue(L, 1);
+    }
+    lua_pushnumber(L, 1);
+    lua_pushnil(L);
+    lua_pushcclosure(L, allnext, 3);
+
+    return 1;
+}
+
+//stack: c, f, previous value, index. also the continuation when f yields
+static int foreachLoop(lua_State *L) {
+    for (;;) {
+        int i = (int)lua_tonumber(L, 4);
+        i = allStep(L, 1, i, 3);
+        if (lua_isnil(L, -1)) {
+            return 0;
+        }
+
+        lua_pushnumber(L, i);
+        lua_replace(L, 4);
+        lua_pushvalue(L, -1);
+        lua_replace(L, 3);
+
+        lua_pushvalue(L, 2);
+        lua_insert(L, -2);
+        lua_callk(L, 1, 0, 0, foreachLoop);
+    }
+}
+
+int foreach(lua_State *L) {
+    lua_settop(L, 2);
+    if (lua_isnil(L, 1) || tableLength(L, 1, isPlainTable(L, 1)) == 0) {
+        return 0;
+    }
+
+    lua_pushnil(L);
+    lua_pushnumber(L, 1);
+
+    return foreachLoop(L);
+}
+
+//the number of non-nil values in c[1] to c[#c], or of values equal to v
+int count(lua_State *L) {
+    bool plain = isPlainTable(L, 1);
+    int max = tableLength(L, 1, plain);
+    bool nonNil = lua_isnoneornil(L, 2);
+    int cnt = 0;
+
+    for (int i = 1; i <= max; i++) {
+        pushIndex(L, 1, i, plain);
+        if (nonNil ? !lua_isnil(L, -1) : lua_compare(L, -1, 2, LUA_OPEQ)) {
+            cnt++;
+        }
+        lua_pop(L, 1);
+    }
+
+    lua_pushnumber(L, cnt);
+
+    return 1;
+}
+
+int add(lua_State *L) {
+    if (lua_isnil(L, 1)) {
+        return 0;
+    }
+
+    lua_settop(L, 3);
+    bool plain = isPlainTable(L, 1);
+    //insert at i if specified, otherwise append
+    int i = lua_toboolean(L, 3) ? floorArg(L, 3) : 0;
+    int len = tableLength(L, 1, plain);
+    i = lua_toboolean(L, 3) ? mid3(1, i, len + 1) : len + 1;
+
+    for (int j = len; j >= i; j--) {
+        pushIndex(L, 1, j, plain);
+        setIndex(L, 1, j + 1, plain);
+    }
+    lua_pushvalue(L, 2);
+    setIndex(L, 1, i, plain);
+
+    lua_pushvalue(L, 2);
+
+    return 1;
+}
+
+int del(lua_State *L) {
+    if (lua_isnil(L, 1)) {
+        return 0;
+    }
+
+    lua_settop(L, 2);
+    bool plain = isPlainTable(L, 1);
+    int max = tableLength(L, 1, plain);
+
+    for (int i = 1; i <= max; i++) {
+        pushIndex(L, 1, i, plain);
+        bool found = lua_compare(L, -1, 2, LUA_OPEQ);
+        lua_pop(L, 1);
+
+        if (found) {
+            for (int j = i; j <= max; j++) {
+                pushIndex(L, 1, j + 1, plain);
+                setIndex(L, 1, j, plain);
+            }
+            lua_pushvalue(L, 2);
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int deli(lua_State *L) {
+    if (lua_isnil(L, 1)) {
+        return 0;
+    }
+
+    lua_settop(L, 2);
+    bool plain = isPlainTable(L, 1);
+    //delete at i if specified, otherwise at the end
+    int i = lua_toboolean(L, 2) ? floorArg(L, 2) : 0;
+    int len = tableLength(L, 1, plain);
+    i = lua_toboolean(L, 2) ? mid3(1, i, len) : len;
+
+    pushIndex(L, 1, i, plain);
+    for (int j = i; j <= len; j++) {
+        pushIndex(L, 1, j + 1, plain);
+        setIndex(L, 1, j, plain);
+    }
+
+    return 1;
+}
+#endif
+
 //cart data
 int cartdata(lua_State *L) {
     bool result = false;
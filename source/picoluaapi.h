@@ -49,15 +49,17 @@ int fillp(lua_State *L);
 int flip(lua_State *L);
 //end todo
 
-//tables functions, maybe implemented in lua? 
-//list from: https://pico-8.fandom.com/wiki/APIReference
-/*
-     add(t, v)
-    all(t)
-    del(t, v)
-    foreach(t, f)
-    pairs(t) 
-*/
+//tables, only with FAKE08_NATIVE_TABLE_HELPERS
+#ifdef FAKE08_NATIVE_TABLE_HELPERS
+int all(lua_State *L);
+//the iterator all() returns
+int allnext(lua_State *L);
+int foreach(lua_State *L);
+int count(lua_State *L);
+int add(lua_State *L);
+int del(lua_State *L);
+int deli(lua_State *L);
+#endif
 
 //input api
 int btn(lua_State *L);
@@ -0,0 +1,193 @@
+#include <string.h>
+#include <memory>
+
+#include "pngCartDecoder.h"
+
+#include "miniz.h"
+
+#define ROW_BYTES (PNG_CART_WIDTH * 4)
+
+void extractPngCartBytes(const uint8_t* rgba, size_t count, uint8_t* out) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = rgba + i * 4;
+        //r g b a in bytes 0-3. after masking, one multiply moves the four
+        //2 bit fields next to each other in the top byte (a r g b), and the
+        //other partial products land in bits that never overlap, so no carries
+        uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        out[i] = (uint8_t)(((v & 0x03030303) * 0x10040140) >> 24);
+    }
+}
+
+static uint32_t readBigEndian32(const unsigned char* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p;
+    int pb = p > b ? p - b : b - p;
+    int pc = p > c ? p - c : c - p;
+
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+//undoes the png filter of one rgba row in place
+static bool unfilterRow(uint8_t filter, uint8_t* row, const uint8_t* prev) {
+    switch (filter) {
+        case 0:
+            break;
+        case 1:
+            for (int i = 4; i < ROW_BYTES; i++) row[i] += row[i - 4];
+            break;
+        case 2:
+            for (int i = 0; i < ROW_BYTES; i++) row[i] += prev[i];
+            break;
+        case 3:
+            for (int i = 0; i < 4; i++) row[i] += prev[i] >> 1;
+            for (int i = 4; i < ROW_BYTES; i++) row[i] += (row[i - 4] + prev[i]) >> 1;
+            break;
+        case 4:
+            for (int i = 0; i < 4; i++) row[i] += prev[i];
+            for (int i = 4; i < ROW_BYTES; i++) row[i] += paeth(row[i - 4], prev[i], prev[i - 4]);
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+struct PngCartRows {
+    //filter byte then the row. the first row is unfiltered against zeros
+    uint8_t current[1 + ROW_BYTES];
+    uint8_t previous[ROW_BYTES];
+    size_t filled;
+    int row;
+    uint8_t* out;
+
+    bool consume(const uint8_t* data, size_t size) {
+        while (size > 0) {
+            if (row >= PNG_CART_HEIGHT) {
+                //trailing bytes after the last scanline
+                return false;
+            }
+
+            size_t count = sizeof(current) - filled;
+            if (count > size) count = size;
+            memcpy(current + filled, data, count);
+            filled += count;
+            data += count;
+            size -= count;
+
+            if (filled == sizeof(current)) {
+                uint8_t* pixels = current + 1;
+                if (!unfilterRow(current[0], pixels, previous)) {
+                    return false;
+                }
+
+                extractPngCartBytes(pixels, PNG_CART_WIDTH, out + row * PNG_CART_WIDTH);
+                memcpy(previous, pixels, ROW_BYTES);
+                filled = 0;
+                row++;
+            }
+        }
+
+        return true;
+    }
+};
+
+bool decodePngCartData(const unsigned char* png, size_t size, uint8_t out[PNG_CART_DATA_SIZE]) {
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (size < 8 || memcmp(png, signature, 8) != 0) {
+        return false;
+    }
+
+    //the inflate state and its 32k window are most of the memory used here
+    std::unique_ptr<tinfl_decompressor, void(*)(tinfl_decompressor*)> inflator(tinfl_decompressor_alloc(), tinfl_decompressor_free);
+    std::unique_ptr<uint8_t[]> window(new uint8_t[TINFL_LZ_DICT_SIZE]);
+    std::unique_ptr<PngCartRows> rows(new PngCartRows());
+    if (!inflator) {
+        return false;
+    }
+    tinfl_init(inflator.get());
+    memset(rows->previous, 0, sizeof(rows->previous));
+    rows->filled = 0;
+    rows->row = 0;
+    rows->out = out;
+
+    size_t windowOffset = 0;
+    bool seenHeader = false;
+    bool inflateDone = false;
+    size_t pos = 8;
+
+    while (pos + 12 <= size) {
+        uint32_t length = readBigEndian32(png + pos);
+        const unsigned char* type = png + pos + 4;
+        const unsigned char* data = png + pos + 8;
+        if (length > size - pos - 12) {
+            return false;
+        }
+
+        uint32_t crc = (uint32_t)mz_crc32(MZ_CRC32_INIT, type, length + 4);
+        if (crc != readBigEndian32(data + length)) {
+            return false;
+        }
+        pos += 12 + length;
+
+        if (memcmp(type, "IHDR", 4) == 0) {
+            //8 bit depth, rgba, deflate, standard filters, not interlaced
+            if (length != 13 ||
+                readBigEndian32(data) != PNG_CART_WIDTH ||
+                readBigEndian32(data + 4) != PNG_CART_HEIGHT ||
+                data[8] != 8 || data[9] != 6 || data[10] != 0 || data[11] != 0 || data[12] != 0) {
+                return false;
+            }
+            seenHeader = true;
+        }
+        else if (memcmp(type, "IDAT", 4) == 0) {
+            if (!seenHeader || inflateDone) {
+                return false;
+            }
+
+            const uint8_t* in = data;
+            size_t inLeft = length;
+            for (;;) {
+                size_t inSize = inLeft;
+                size_t outSize = TINFL_LZ_DICT_SIZE - windowOffset;
+                tinfl_status status = tinfl_decompress(inflator.get(), in, &inSize,
+                    window.get(), window.get() + windowOffset, &outSize,
+                    TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+                in += inSize;
+                inLeft -= inSize;
+
+                if (!rows->consume(window.get() + windowOffset, outSize)) {
+                    return false;
+                }
+                windowOffset = (windowOffset + outSize) & (TINFL_LZ_DICT_SIZE - 1);
+
+                if (status < TINFL_STATUS_DONE) {
+                    return false;
+                }
+                if (status == TINFL_STATUS_DONE) {
+                    inflateDone = true;
+                    break;
+                }
+                if (status == TINFL_STATUS_NEEDS_MORE_INPUT && inLeft == 0) {
+                    //on to the next IDAT chunk
+                    break;
+                }
+            }
+        }
+        else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        else if ((type[0] & 0x20) == 0 && memcmp(type, "PLTE", 4) != 0) {
+            //unknown critical chunk
+            return false;
+        }
+    }
+
+    return inflateDone && rows->row == PNG_CART_HEIGHT;
+}
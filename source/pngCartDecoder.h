@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//a p8.png cart is a 160x205 image with one byte of cart data hidden in the
+//low two bits of each pixel's channels (argb, a most significant)
+#define PNG_CART_WIDTH 160
+#define PNG_CART_HEIGHT 205
+#define PNG_CART_DATA_SIZE (PNG_CART_WIDTH * PNG_CART_HEIGHT)
+
+//gathers the hidden byte of each of count rgba pixels into out
+void extractPngCartBytes(const uint8_t* rgba, size_t count, uint8_t* out);
+
+//decodes the cart data of a png without building the rgba image: idat is
+//inflated and unfiltered one scanline at a time and each row goes straight
+//through extractPngCartBytes. only handles 8 bit rgba, non interlaced pngs of
+//the cart size; false for anything else, so the caller can fall back to lodepng
+bool decodePngCartData(const unsigned char* png, size_t size, uint8_t out[PNG_CART_DATA_SIZE]);
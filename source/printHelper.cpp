@@ -80,6 +80,9 @@ int print(std::string str) {
     //todo: default is not 0,0?
     int x = _ph_mem->drawState.text_x;
     int y = _ph_mem->drawState.text_y;
+    //scroll whichever buffer 0x5f55 maps the screen to
+    uint8_t* screenBuffer = _ph_graphics->GetP8FrameBuffer();
+    int screenAddr = (int)(screenBuffer - _ph_mem->data);
     if (y >= 127) {
         //Memcy screen to itself offset by how many lines needed (y + line height)
         int lineHeight = 6; // possibly need to check if bigger font?
@@ -87,15 +90,16 @@ int print(std::string str) {
         int startY = y - linesToCopy; 
 
         memmove(
-            &_ph_mem->screenBuffer, 
-            &_ph_mem->screenBuffer[COMBINED_IDX(0, startY)],
+            screenBuffer, 
+            &screenBuffer[COMBINED_IDX(0, startY)],
             linesToCopy * 64);
         
         //set the rest of the screen buffer to 0 (black)
         memset(
-            &_ph_mem->screenBuffer[COMBINED_IDX(0, linesToCopy)],
+            &screenBuffer[COMBINED_IDX(0, linesToCopy)],
             0,
             startY * 64);
+        _ph_graphics->markMemoryDirty(screenAddr, sizeof(_ph_mem->screenBuffer));
 
         y = _ph_mem->drawState.text_y = 127 - lineHeight;
         //Memcpy buffy back to screen
@@ -108,15 +112,16 @@ int print(std::string str) {
         int linesToCopy = 127 - lineHeight; 
         int startY = _ph_mem->drawState.text_y - linesToCopy; 
         memmove(
-            &_ph_mem->screenBuffer, 
-            &_ph_mem->screenBuffer[COMBINED_IDX(0, startY)],
+            screenBuffer, 
+            &screenBuffer[COMBINED_IDX(0, startY)],
             linesToCopy * 64);
         
         //set the rest of the screen buffer to 0 (black)
         memset(
-            &_ph_mem->screenBuffer[COMBINED_IDX(0, linesToCopy)],
+            &screenBuffer[COMBINED_IDX(0, linesToCopy)],
             0,
             startY * 64);
+        _ph_graphics->markMemoryDirty(screenAddr, sizeof(_ph_mem->screenBuffer));
 
         y = _ph_mem->drawState.text_y = 127 - lineHeight;
     }
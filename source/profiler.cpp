@@ -0,0 +1,17 @@
+#include <string.h>
+
+#include "profiler.h"
+
+ProfileCounters _profileCounters;
+
+void Profile_Reset() {
+    memset(&_profileCounters, 0, sizeof(ProfileCounters));
+}
+
+uint64_t Profile_Nanos(ProfileBucket bucket) {
+    return _profileCounters.nanos[bucket];
+}
+
+uint32_t Profile_Calls(ProfileBucket bucket) {
+    return _profileCounters.calls[bucket];
+}
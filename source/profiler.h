@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+//lightweight timing buckets used by the headless bench runner (bench/).
+//the scoped timers compile to nothing unless FAKE08_PROFILE is defined,
+//so platform builds pay nothing for them
+
+enum ProfileBucket {
+    PROFILE_GFX = 0,
+    PROFILE_AUDIO,
+    PROFILE_BUCKET_COUNT
+};
+
+struct ProfileCounters {
+    uint64_t nanos[PROFILE_BUCKET_COUNT];
+    uint32_t calls[PROFILE_BUCKET_COUNT];
+};
+
+extern ProfileCounters _profileCounters;
+
+void Profile_Reset();
+uint64_t Profile_Nanos(ProfileBucket bucket);
+uint32_t Profile_Calls(ProfileBucket bucket);
+
+class ProfileScope {
+    ProfileBucket _bucket;
+    std::chrono::steady_clock::time_point _start;
+
+    public:
+    ProfileScope(ProfileBucket bucket) : _bucket(bucket), _start(std::chrono::steady_clock::now()) { }
+    ~ProfileScope() {
+        auto elapsed = std::chrono::steady_clock::now() - _start;
+        _profileCounters.nanos[_bucket] +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        _profileCounters.calls[_bucket]++;
+    }
+};
+
+#if FAKE08_PROFILE
+#define PROFILE_SCOPE(bucket) ProfileScope _profileScope(bucket)
+#else
+#define PROFILE_SCOPE(bucket)
+#endif
@@ -1,26 +1,24 @@
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 #include "stringToDataHelpers.h"
 
 #include "logger.h"
 
-void copy_string_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string data) {
+void copy_string_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string_view data) {
 	uint16_t i = 0;
+	size_t length = data.length();
 
-	for (size_t n = 0; n < data.length(); n++) {
-		char buf[3] = {0};
-
+	for (size_t n = 0; n < length && i < 128 * 64; n++) {
 		//https://pico-8.fandom.com/wiki/Memory
 		// "An 8-bit byte represents two pixels, horizontally adjacent, where the most significant 
 		// (leftmost) 4 bits is the right pixel of the pair, and the least significant 4 bits is 
 		// the left pixel.
 		if (data[n] > ' ') {
-			//buf[0] = data[n++];
-			//buf[1] = data[n];
-			buf[1] = data[n++]; //left pixel 
-			buf[0] = data[n];
-			uint8_t val = (uint8_t)strtol(buf, NULL, 16);
+			char left = data[n++]; //left pixel
+			char right = n < length ? data[n] : '\0';
+			uint8_t val = hex_pair_value(right, left);
 
 			//this was the impl before combining nibbles into a single byte
 			//sprite_data[i++] = val >> 4;
@@ -30,23 +28,22 @@ void copy_string_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string dat
 	}
 }
 
-void copy_mini_label_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string data, int labeloffset) {
+void copy_mini_label_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string_view data, int labeloffset) {
 	int buffcount = 0;
 	int labelx = 0;
 	int labely = 0;
-	char buf[3] = {0};
+	char left = 0;
 	
 	for (size_t n = 0; n < data.length(); n++) {
 		
 		if (data[n] > ' ') {
 			
 			if (buffcount == 0) {
-				buf[1] = data[n];
+				left = data[n];
 			}
 			
 			if (buffcount == 4) {
-				buf[0] = data[n];
-				uint8_t val = (uint8_t)strtol(buf, NULL, 16);
+				uint8_t val = hex_pair_value(data[n], left);
 				if ((labelx + (labely * 16)) % 64 <= 15){
 					sprite_data[labeloffset + labelx + (labely * 16)] = val;
 				}
@@ -70,16 +67,15 @@ void copy_mini_label_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string
 }
 
 
-void copy_string_to_memory(uint8_t* sprite_flag_data, std::string data) {
-	uint16_t i = 0;
-
-	for (size_t n = 0; n < data.length(); n++) {
-		char buf[3] = {0};
+void copy_string_to_memory(uint8_t* sprite_flag_data, std::string_view data, size_t size) {
+	size_t i = 0;
+	size_t length = data.length();
 
+	for (size_t n = 0; n < length && i < size; n++) {
 		if (data[n] > ' ') {
-			buf[0] = data[n++];
-			buf[1] = data[n];
-			uint8_t val = (uint8_t)strtol(buf, NULL, 16);
+			char hi = data[n++];
+			char lo = n < length ? data[n] : '\0';
+			uint8_t val = hex_pair_value(hi, lo);
 
 			sprite_flag_data[i++] = val;
 		}
@@ -1,9 +1,33 @@
 #pragma once
 
+#include <stdint.h>
 #include <string>
+#include <string_view>
 
-void copy_string_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string data);
+//value of a hex digit, -1 if c isn't one
+inline int hex_digit_value(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
 
-void copy_mini_label_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string data, int labeloffset);
+//same result as strtol on the two char string hi lo with base 16: parsing
+//stops at the first non hex digit and leading whitespace is skipped
+inline uint8_t hex_pair_value(char hi, char lo) {
+	int h = hex_digit_value(hi);
+	int l = hex_digit_value(lo);
+	if (h < 0) {
+		bool space = hi == ' ' || (hi >= '\t' && hi <= '\r');
+		return space && l >= 0 ? (uint8_t)l : 0;
+	}
 
-void copy_string_to_memory(uint8_t* sprite_flag_data, std::string data);
\ No newline at end of file
+	return l < 0 ? (uint8_t)h : (uint8_t)(h << 4 | l);
+}
+
+void copy_string_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string_view data);
+
+void copy_mini_label_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string_view data, int labeloffset);
+
+//writes at most size bytes
+void copy_string_to_memory(uint8_t* sprite_flag_data, std::string_view data, size_t size);
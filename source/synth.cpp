@@ -11,6 +11,7 @@
 //
 
 #include "synth.h"
+#include "PicoRam.h"
 #include "audioOptimizations.h"
 
 //#include <lol/noise> // lol::perlin_noise
@@ -23,112 +24,202 @@
 namespace z8
 {
 
-float synth::waveform(int instrument, float advance)
+//const from picolove:
+//local function note_to_hz(note)
+//  return 440 * 2 ^ ((note - 33) / 12)
+//end
+//local tscale = note_to_hz(63) / __sample_rate
+static const float tscale = 0.11288053831187f;
+
+// Multipliers were measured from PICO-8 WAV exports. Waveforms are
+// inferred from those exports by guessing what the original formulas
+// could be.
+// t is the phase already wrapped to [0, 1)
+static inline float triangle(float t)
 {
-    using std::fabs;
-    using std::fmod;
+    // Optimized triangle wave using fast math
+    return fast_div2(fast_fabs(fast_mul4(t) - 2.0f) - 1.0f);
+}
+
+static inline float tiltedSaw(float t)
+{
+    static float const a = 0.9f;
+    static float const inv_a = 1.111111f; // 1/0.9
+    static float const inv_1_minus_a = 10.0f; // 1/(1-0.9)
+    float ret = t < a ? fast_mul2(t) * inv_a - 1.0f
+                      : fast_mul2(1.0f - t) * inv_1_minus_a - 1.0f;
+    return fast_div2(ret);
+}
+
+static inline float saw(float t)
+{
+    return 0.653f * (t < 0.5f ? t : t - 1.0f);
+}
+
+static inline float square(float t)
+{
+    return t < 0.5f ? 0.25f : -0.25f;
+}
+
+static inline float pulse(float t)
+{
+    return t < 0.33333333f ? 0.25f : -0.25f;
+}
+
+static inline float organ(float t)
+{
+    float ret = t < 0.5f ? 3.0f - fast_fabs(24.0f * t - 6.0f)
+                         : 1.0f - fast_fabs(16.0f * t - 12.0f);
+    return fast_div9(ret);
+}
+
+static inline float phaser(float advance, float t)
+{
+    // This one has a subfrequency of freq/128 that appears
+    // to modulate two signals using a triangle wave
+    // FIXME: amplitude seems to be affected, too
+    float k = fast_fabs(fast_mul2(fast_fmod(advance * 0.0078125f, 1.0f)) - 1.0f); // 1/128 = 0.0078125
+    float u = fast_fmod(t + fast_div2(k), 1.0f);
+    float ret = fast_fabs(fast_mul4(u) - 2.0f) - fast_fabs(8.0f * t - 4.0f);
+    return fast_div6(ret);
+}
+
+//xorshift32, mapped to -1..1
+static inline float noise_random(noiseState &state)
+{
+    uint32_t x = state.rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state.rng = x;
+    return (float)(int32_t)x * (1.0f / 2147483648.0f);
+}
 
-    //const from picolove:
-    //local function note_to_hz(note)
-	//  return 440 * 2 ^ ((note - 33) / 12)
+void synth::seedNoise(noiseState &noise, uint32_t seed)
+{
+    noise.rng = seed != 0 ? seed : NOISE_DEFAULT_SEED;
+    noise.lastadvance = 0;
+    noise.sample = 0;
+    noise.lsample = 0;
+}
+
+float synth::noise(float advance, noiseState &state)
+{
+    // Spectral analysis indicates this is some kind of brown noise,
+    // but losing almost 10dB per octave. I thought using Perlin noise
+    // would be fun, but it’s definitely not accurate.
+    //
+    // This may help us create a correct filter:
+    // http://www.firstpr.com.au/dsp/pink-noise/
+
+    //TODO: not even doing zepto 8 noise here
+
+    //static lol::perlin_noise<1> noise;
+    //for (float m = 1.75f, d = 1.f; m <= 128; m *= 2.25f, d *= 0.75f)
+    //    ret += d * noise.eval(lol::vec_t<float, 1>(m * advance));
+
+    //ret = ((float)rand() / (float)RAND_MAX);
+
+    //return ret * 0.4f;
+
+    //picolove noise function in lua
+    //zepto8 phi == picolove oscpos (x parameter in picolove generator func, advance in synth.cpp waveform function)
+    //-- noise
+    //osc[6] = function()
+    //    local lastx = 0
+    //    local sample = 0
+    //    local lsample = 0
+    //    local tscale = note_to_hz(63) / __sample_rate
+    //1,041.8329
+    //    return function(x)
+    //        local scale = (x - lastx) / tscale
+    //        lsample = sample
+    //        sample = (lsample + scale * (math.random() * 2 - 1)) / (1 + scale)
+    //        lastx = x
+    //        return math.min(math.max((lsample + sample) * 4 / 3 * (1.75 - scale), -1), 1) *
+    //            0.7
+    //    end
     //end
-    //local tscale = note_to_hz(63) / __sample_rate
-    const float tscale = 0.11288053831187f;
 
+    float scale = (advance - state.lastadvance) / tscale;
+    state.lsample = state.sample;
+    state.sample = (state.lsample + scale * noise_random(state)) / (1.0f + scale);
+    state.lastadvance = advance;
+    float temp_val = (state.lsample + state.sample) * 1.33333333f * (1.75f - scale);
+    float endval = std::min(std::max(temp_val, -1.0f), 1.0f) * 0.2f;
+    return endval;
+}
+
+float synth::waveform(int instrument, float advance, noiseState &noise)
+{
     float t = fast_fmod(advance, 1.f);
-    float ret = 0.f;
 
-    // Multipliers were measured from PICO-8 WAV exports. Waveforms are
-    // inferred from those exports by guessing what the original formulas
-    // could be.
     switch (instrument)
     {
         case INST_TRIANGLE:
-            // Optimized triangle wave using fast math
-            return fast_div2(fast_fabs(fast_mul4(t) - 2.0f) - 1.0f);
+            return triangle(t);
         case INST_TILTED_SAW:
-        {
-            static float const a = 0.9f;
-            static float const inv_a = 1.111111f; // 1/0.9
-            static float const inv_1_minus_a = 10.0f; // 1/(1-0.9)
-            ret = t < a ? fast_mul2(t) * inv_a - 1.0f
-                        : fast_mul2(1.0f - t) * inv_1_minus_a - 1.0f;
-            return fast_div2(ret);
-        }
+            return tiltedSaw(t);
         case INST_SAW:
-            return 0.653f * (t < 0.5f ? t : t - 1.0f);
+            return saw(t);
         case INST_SQUARE:
-            return t < 0.5f ? 0.25f : -0.25f;
+            return square(t);
         case INST_PULSE:
-            return t < 0.33333333f ? 0.25f : -0.25f;
+            return pulse(t);
         case INST_ORGAN:
-            ret = t < 0.5f ? 3.0f - fast_fabs(24.0f * t - 6.0f)
-                           : 1.0f - fast_fabs(16.0f * t - 12.0f);
-            return fast_div9(ret);
+            return organ(t);
         case INST_NOISE:
-        {
-            // Spectral analysis indicates this is some kind of brown noise,
-            // but losing almost 10dB per octave. I thought using Perlin noise
-            // would be fun, but it’s definitely not accurate.
-            //
-            // This may help us create a correct filter:
-            // http://www.firstpr.com.au/dsp/pink-noise/
-
-            //TODO: not even doing zepto 8 noise here
-
-            //static lol::perlin_noise<1> noise;
-            //for (float m = 1.75f, d = 1.f; m <= 128; m *= 2.25f, d *= 0.75f)
-            //    ret += d * noise.eval(lol::vec_t<float, 1>(m * advance));
-
-            //ret = ((float)rand() / (float)RAND_MAX);
-
-            //return ret * 0.4f;
-
-            //picolove noise function in lua
-            //zepto8 phi == picolove oscpos (x parameter in picolove generator func, advance in synth.cpp waveform function)
-            //-- noise
-            //osc[6] = function()
-            //    local lastx = 0
-            //    local sample = 0
-            //    local lsample = 0
-            //    local tscale = note_to_hz(63) / __sample_rate
-            //1,041.8329
-            //    return function(x)
-            //        local scale = (x - lastx) / tscale
-            //        lsample = sample
-            //        sample = (lsample + scale * (math.random() * 2 - 1)) / (1 + scale)
-            //        lastx = x
-            //        return math.min(math.max((lsample + sample) * 4 / 3 * (1.75 - scale), -1), 1) *
-            //            0.7
-            //    end
-            //end
-            //printf("tscale: %f\n", tscale);
-            //printf("advance: %f\n", advance);
-
-            float scale = (advance - lastadvance) / tscale;
-            //printf("scale: %f\n", scale);
-            lsample = sample;
-            sample = (lsample + scale * (((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f)) / (1.0f + scale);
-            //printf("sample: %f\n", sample);
-            lastadvance = advance;
-            float temp_val = (lsample + sample) * 1.33333333f * (1.75f - scale);
-            float endval = std::min(std::max(temp_val, -1.0f), 1.0f) * 0.2f;
-            //printf("endval: %f\n", endval);
-            return endval;
-        }
+            return synth::noise(advance, noise);
         case INST_PHASER:
-        {   // This one has a subfrequency of freq/128 that appears
-            // to modulate two signals using a triangle wave
-            // FIXME: amplitude seems to be affected, too
-            float k = fast_fabs(fast_mul2(fast_fmod(advance * 0.0078125f, 1.0f)) - 1.0f); // 1/128 = 0.0078125
-            float u = fast_fmod(t + fast_div2(k), 1.0f);
-            ret = fast_fabs(fast_mul4(u) - 2.0f) - fast_fabs(8.0f * t - 4.0f);
-            return fast_div6(ret);
-        }
+            return phaser(advance, t);
     }
 
     return 0.0f;
 }
 
+//same as waveform() for every phase, with the instrument switch hoisted out of the loop
+#define WAVEFORM_LOOP(expr) \
+    for (int i = 0; i < count; i++) { \
+        float t = fast_fmod(advances[i], 1.f); \
+        out[i] = (expr); \
+    }
+
+void synth::waveforms(int instrument, const float* advances, float* out, int count, noiseState &noise)
+{
+    switch (instrument)
+    {
+        case INST_TRIANGLE:
+            WAVEFORM_LOOP(triangle(t));
+            return;
+        case INST_TILTED_SAW:
+            WAVEFORM_LOOP(tiltedSaw(t));
+            return;
+        case INST_SAW:
+            WAVEFORM_LOOP(saw(t));
+            return;
+        case INST_SQUARE:
+            WAVEFORM_LOOP(square(t));
+            return;
+        case INST_PULSE:
+            WAVEFORM_LOOP(pulse(t));
+            return;
+        case INST_ORGAN:
+            WAVEFORM_LOOP(organ(t));
+            return;
+        case INST_NOISE:
+            for (int i = 0; i < count; i++) {
+                out[i] = synth::noise(advances[i], noise);
+            }
+            return;
+        case INST_PHASER:
+            WAVEFORM_LOOP(phaser(advances[i], t));
+            return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        out[i] = 0.0f;
+    }
+}
+
 } // namespace z8
 
@@ -12,6 +12,10 @@
 
 #pragma once
 
+#include <stdint.h>
+
+struct noiseState;
+
 namespace z8
 {
 
@@ -34,17 +38,16 @@ public:
         INST_PHASER     = 7,
     };
 
-    static float waveform(int instrument, float advance);
+    //noise is only touched by INST_NOISE
+    static float waveform(int instrument, float advance, noiseState &noise);
+    //fills out[i] with waveform(instrument, advances[i], noise) for the whole block
+    static void waveforms(int instrument, const float* advances, float* out, int count, noiseState &noise);
+
+    //seeds the noise prng. a zero seed is replaced, xorshift would stay at zero
+    static void seedNoise(noiseState &noise, uint32_t seed);
 
-    //These are inline so they don't have to be declared in the class
-    //c++17 allows this, but if need for c++11 "inline" can be removed and they
-    //can be declared in synth.cpp
-    //also not threadsafe, but this is all single threaded anyway
     private:
-        inline static float lastadvance;
-        inline static float sample;
-        inline static float lsample;
-        
+        static float noise(float advance, noiseState &state);
 };
 
 } // namespace z8
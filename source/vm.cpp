@@ -22,6 +22,9 @@
 #include "p8GlobalLuaFunctions.h"
 #include "hostVmShared.h"
 #include "emojiconversion.h"
+#include "filehelpers.h"
+#include "cartCache.h"
+#include "profiler.h"
 
 #include "NoLabel.h"
 
@@ -37,6 +40,36 @@ using namespace z8;
 static const char BiosCartName[] = "__FAKE08-BIOS.p8";
 static const char SettingsCartName[] = "__FAKE08-SETTINGS.p8";
 
+//cycle estimate mode. pico 8 runs at 8MHz; lua vm instructions average out to
+//roughly 2 cycles once api call costs are folded in
+static const int PicoCyclesPerSecond = 8000000;
+static const int CyclesPerLuaInstruction = 2;
+static const int LuaInstructionHookInterval = 100;
+//registry key (by address) of the Vm that owns a lua state
+static const char VmRegistryKey = 0;
+
+void Vm::countLuaInstructions(lua_State *L, lua_Debug *ar) {
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &VmRegistryKey);
+    Vm* vm = (Vm*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    if (vm) {
+        vm->_luaInstructionCount += LuaInstructionHookInterval;
+    }
+}
+
+#if FAKE08_PROFILE
+//wraps graphics api calls so the bench runner can split gfx time out of lua time
+template <lua_CFunction F>
+static int profiledGfxCall(lua_State *L) {
+    PROFILE_SCOPE(PROFILE_GFX);
+    return F(L);
+}
+#define register_gfx(L, name, fn) lua_register(L, name, (profiledGfxCall<fn>))
+#else
+#define register_gfx(L, name, fn) lua_register(L, name, fn)
+#endif
+
 Vm::Vm(
     Host* host,
     PicoRam* memory,
@@ -45,6 +78,7 @@ Vm::Vm(
     Audio* audio) :
         _loadedCart(nullptr),
         _luaState(nullptr),
+        _luaMemoryLimit(PICO_LUA_MEMORY_LIMIT),
         _cleanupDeps(false),
         _targetFps(30),
         _picoFrameCount(0),
@@ -55,10 +89,17 @@ Vm::Vm(
         _update_ref(LUA_NOREF),
         _update60_ref(LUA_NOREF),
         _draw_ref(LUA_NOREF),
-        _refs_cached(false)
+        _refs_cached(false),
+        _cpuCycleEstimate(false),
+        _prevFrameCpu(0),
+        _luaInstructionCount(0)
 {
     _host = host;
 
+    initLuaAllocatorState(&_luaAllocState, _luaMemoryLimit);
+
+    setCartCacheDirectory(_host->getCartCacheDirectory());
+
     if (memory == nullptr) {
         memory = new PicoRam();
         _cleanupDeps = true;
@@ -85,10 +126,14 @@ Vm::Vm(
         _cleanupDeps = true;
     }
     _audio = audio;
+    _audioRenderThread = new AudioRenderThread(_audio, 22050);
 
     //this can probably go away when I'm loading actual carts and just have to expose api to lua
     Logger_Write("Initializing global api\n");
     initPicoApi(_memory, _graphics, _input, this, _audio);
+
+    _host->setScreenDirtyState(_graphics->GetScreenDirtyState());
+    _host->setAltScreenPalette(_graphics->GetAltScreenPalette());
     //initGlobalApi(_graphics);
 
 }
@@ -107,8 +152,13 @@ Vm::~Vm(){
         }
     }
 
+    //has to stop before the audio it renders goes away
+    delete _audioRenderThread;
+
     CloseCart();
 
+    destroyLuaAllocatorState(&_luaAllocState);
+
     if (_cleanupDeps){
         if (_input != nullptr) {
             delete _input;
@@ -132,6 +182,22 @@ PicoRam* Vm::getPicoRam(){
 jmp_buf place;
 bool abortLua;
 
+//fnv-1a over the cart's sound data, so noise is the same every time a cart plays
+static uint32_t cartNoiseSeed(Cart* cart) {
+    const uint8_t* data = (const uint8_t*)&cart->CartRom.SongData[0];
+    size_t size = sizeof(cart->CartRom.SongData) + sizeof(cart->CartRom.SfxData);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int luaPanic(lua_State *L) {
+    Logger_Write("PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(L, -1));
+    return 0;
+}
+
 bool Vm::loadCart(Cart* cart) {
     _picoFrameCount = 0;
 
@@ -148,6 +214,7 @@ bool Vm::loadCart(Cart* cart) {
     _graphics->color();
     _graphics->clip();
     _graphics->pal();
+    _graphics->markAllDirty();
 
     if (cart->LuaString == "") {
         if (_cartLoadError == "") {
@@ -159,7 +226,7 @@ bool Vm::loadCart(Cart* cart) {
     }
 
     //reset audio
-    _audio->resetAudioState();
+    _audio->resetAudioState(cartNoiseSeed(cart));
 
     //copy data from cart rom to ram
     vm_reload(0, 0, sizeof(cart->CartRom), cart);
@@ -169,9 +236,17 @@ bool Vm::loadCart(Cart* cart) {
     abortLua = false;
 
     // initialize Lua interpreter
-    _luaState = luaL_newstate();
+    // allocations go through our allocator so memory use can be reported and capped
+    resetLuaAllocatorState(&_luaAllocState, _luaMemoryLimit);
+    _luaState = lua_newstate(picoLuaAlloc, &_luaAllocState);
+    lua_atpanic(_luaState, luaPanic);
+    lua_pushlightuserdata(_luaState, this);
+    lua_rawsetp(_luaState, LUA_REGISTRYINDEX, &VmRegistryKey);
 
     lua_setpico8memory(_luaState, (uint8_t *)&_memory->data);
+    _prevFrameCpu = 0;
+    _luaInstructionCount = 0;
+    beginCpuFrame();
     // load Lua base libraries (print / math / etc)
     luaL_openlibs(_luaState);
     lua_pushglobaltable(_luaState);
@@ -200,39 +275,39 @@ bool Vm::loadCart(Cart* cart) {
     //register global functions first, they will get local aliases when
     //the rest of the api is registered
     //graphics
-    lua_register(_luaState, "cls", cls);
-    lua_register(_luaState, "pset", pset);
-    lua_register(_luaState, "pget", pget);
-    lua_register(_luaState, "color", color);
-    lua_register(_luaState, "line", line);
-    lua_register(_luaState, "tline", tline);
-    lua_register(_luaState, "circ", circ);
-    lua_register(_luaState, "circfill", circfill);
-    lua_register(_luaState, "oval", oval);
-    lua_register(_luaState, "ovalfill", ovalfill);
-    lua_register(_luaState, "rect", rect);
-    lua_register(_luaState, "rectfill", rectfill);
-    lua_register(_luaState, "print", print);
-    lua_register(_luaState, "cursor", cursor);
-    lua_register(_luaState, "spr", spr);
-    lua_register(_luaState, "sspr", sspr);
-    lua_register(_luaState, "fget", fget);
-    lua_register(_luaState, "fset", fset);
-    lua_register(_luaState, "sget", sget);
-    lua_register(_luaState, "sset", sset);
-    lua_register(_luaState, "camera", camera);
-    lua_register(_luaState, "clip", clip);
-
-    lua_register(_luaState, "pal", pal);
-    lua_register(_luaState, "palt", palt);
-
-    lua_register(_luaState, "mget", mget);
-    lua_register(_luaState, "mset", mset);
-    lua_register(_luaState, "map", gfx_map);
-    lua_register(_luaState, "mapdraw", gfx_map);
+    register_gfx(_luaState, "cls", cls);
+    register_gfx(_luaState, "pset", pset);
+    register_gfx(_luaState, "pget", pget);
+    register_gfx(_luaState, "color", color);
+    register_gfx(_luaState, "line", line);
+    register_gfx(_luaState, "tline", tline);
+    register_gfx(_luaState, "circ", circ);
+    register_gfx(_luaState, "circfill", circfill);
+    register_gfx(_luaState, "oval", oval);
+    register_gfx(_luaState, "ovalfill", ovalfill);
+    register_gfx(_luaState, "rect", rect);
+    register_gfx(_luaState, "rectfill", rectfill);
+    register_gfx(_luaState, "print", print);
+    register_gfx(_luaState, "cursor", cursor);
+    register_gfx(_luaState, "spr", spr);
+    register_gfx(_luaState, "sspr", sspr);
+    register_gfx(_luaState, "fget", fget);
+    register_gfx(_luaState, "fset", fset);
+    register_gfx(_luaState, "sget", sget);
+    register_gfx(_luaState, "sset", sset);
+    register_gfx(_luaState, "camera", camera);
+    register_gfx(_luaState, "clip", clip);
+
+    register_gfx(_luaState, "pal", pal);
+    register_gfx(_luaState, "palt", palt);
+
+    register_gfx(_luaState, "mget", mget);
+    register_gfx(_luaState, "mset", mset);
+    register_gfx(_luaState, "map", gfx_map);
+    register_gfx(_luaState, "mapdraw", gfx_map);
 
     //stubbed in graphics:
-    lua_register(_luaState, "fillp", fillp);
+    register_gfx(_luaState, "fillp", fillp);
     lua_register(_luaState, "flip", flip);
 
     //input
@@ -276,6 +351,20 @@ bool Vm::loadCart(Cart* cart) {
     lua_register(_luaState, "rnd", rnd);
     lua_register(_luaState, "srand", srand);
 
+    #ifdef FAKE08_NATIVE_TABLE_HELPERS
+    //tables. otherwise they are the bios lua versions in p8GlobalLuaFunctions
+    lua_register(_luaState, "all", all);
+    //not called directly, but save states need it reachable from _G to
+    //persist iterators returned by all(). it adds a key to the eris
+    //permanents table, so save states aren't shared with builds without it
+    lua_register(_luaState, "__allnext", allnext);
+    lua_register(_luaState, "foreach", foreach);
+    lua_register(_luaState, "count", count);
+    lua_register(_luaState, "add", add);
+    lua_register(_luaState, "del", del);
+    lua_register(_luaState, "deli", deli);
+    #endif
+
     //load in global lua fuctions for pico 8- part of this is setting a local variable
     //with the same name as all the globals we just registered
     //auto convertedGlobalLuaFunctions = convert_emojis(p8GlobalLuaFunctions);
@@ -515,6 +604,7 @@ void Vm::togglePauseMenu(){
     else{
         //restore old draw state
         memcpy(&_memory->drawState, _drawStateCopy, 64);
+        _graphics->markAllDirty();
     }
     
 }
@@ -579,6 +669,8 @@ void Vm::deserializeCartDataToMemory(std::string cartDataStr) {
 }
 
 void Vm::UpdateAndDraw() {
+    beginCpuFrame();
+
     update_buttons();
 
     _picoFrameCount++;
@@ -689,20 +781,69 @@ void Vm::UpdateAndDraw() {
         }
     }
 
+    endCpuFrame();
 }
 
 uint8_t* Vm::GetPicoInteralFb(){
     return _graphics->GetP8FrameBuffer();
 }
 
+uint8_t* Vm::GetPresentedFrameBuffer(){
+    return _graphics->GetPresentedFrameBuffer();
+}
+
+AltScreenPalette_t* Vm::GetAltScreenPalette(){
+    return _graphics->GetAltScreenPalette();
+}
+
 uint8_t* Vm::GetScreenPaletteMap(){
     return _graphics->GetScreenPaletteMap();
 }
 
+ScreenDirtyState_t* Vm::GetScreenDirtyState(){
+    return _graphics->GetScreenDirtyState();
+}
+
+void Vm::ClearScreenDirtyState(){
+    _graphics->clearScreenDirtyState();
+}
+
 void Vm::FillAudioBuffer(void *audioBuffer, size_t offset, size_t size){
+   PROFILE_SCOPE(PROFILE_AUDIO);
+   if (_audioRenderThread->isRunning()) {
+       if (audioBuffer != nullptr) {
+           _audioRenderThread->read((uint32_t*)audioBuffer + offset, size);
+       }
+       return;
+   }
+
    _audio->FillAudioBuffer(audioBuffer, offset, size);
 }
 
+bool Vm::StartAudioRenderThread(int lookaheadMs){
+    if (!_audioRenderThread->start(lookaheadMs)) {
+        Logger_Write("audio render thread not supported on this platform\n");
+        return false;
+    }
+
+    Logger_Write("audio render thread started, %dms lookahead\n", lookaheadMs);
+    return true;
+}
+
+void Vm::StopAudioRenderThread(){
+    if (!_audioRenderThread->isRunning()) {
+        return;
+    }
+
+    _audioRenderThread->stop();
+    Logger_Write("audio render thread stopped, underruns: %u overruns: %u\n",
+        _audioRenderThread->getUnderruns(), _audioRenderThread->getOverruns());
+}
+
+AudioRenderThread* Vm::GetAudioRenderThread(){
+    return _audioRenderThread;
+}
+
 void Vm::CloseCart() {
     if (_loadedCart){
         Logger_Write("deleting cart\n");
@@ -711,8 +852,12 @@ void Vm::CloseCart() {
     }
     
     if (_luaState) {
-        Logger_Write("closing lua state\n");
-        lua_close(_luaState);
+        //every allocation the state made came from the arena, so dropping the
+        //arena frees the whole state without walking it like lua_close would.
+        //carts can't hold resources that need __gc finalizers to release them
+        Logger_Write("releasing lua state (%zu bytes live, %zu chunks reserved)\n",
+            _luaAllocState.liveBytes, _luaAllocState.stats.chunkCount);
+        resetLuaAllocatorState(&_luaAllocState, _luaMemoryLimit);
         _luaState = nullptr;
     }
 
@@ -789,10 +934,11 @@ void Vm::GameLoop() {
         //then we don't need to pass them in here
         UpdateAndDraw();
 
-        uint8_t* picoFb = GetPicoInteralFb();
+        uint8_t* picoFb = GetPresentedFrameBuffer();
         uint8_t* screenPaletteMap = GetScreenPaletteMap();
 
-        _host->drawFrame(picoFb, screenPaletteMap, _memory->drawState.drawMode);
+        //draw mode transforms are already applied to the presented buffer
+        _host->drawFrame(picoFb, screenPaletteMap, 0);
 
         if (_host->shouldFillAudioBuff()) {
             FillAudioBuffer(_host->getAudioBufferPointer(), 0, _host->getAudioBufferSize());
@@ -875,6 +1021,7 @@ void Vm::vm_poke(int addr, uint8_t value){
     }
     
     _memory->data[addr] = value;
+    _graphics->markMemoryDirty(addr, 1);
 }
 
 void Vm::vm_poke2(int addr, int16_t value){
@@ -884,7 +1031,7 @@ void Vm::vm_poke2(int addr, int16_t value){
 
     _memory->data[addr] = (uint8_t)value;
     _memory->data[addr + 1] = (uint8_t)(value >> 8);
-
+    _graphics->markMemoryDirty(addr, 2);
 }
 
 void Vm::vm_poke4(int addr, fix32 value){
@@ -897,6 +1044,7 @@ void Vm::vm_poke4(int addr, fix32 value){
     _memory->data[addr + 1] = (uint8_t)(ubits >> 8);
     _memory->data[addr + 2] = (uint8_t)(ubits >> 16);
     _memory->data[addr + 3] = (uint8_t)(ubits >> 24);
+    _graphics->markMemoryDirty(addr, 4);
 }
 
 bool Vm::vm_cartdata(string key) {
@@ -949,6 +1097,7 @@ void Vm::vm_reload(int destaddr, int sourceaddr, int len, Cart* cart){
         return;
     }
     memcpy(&_memory->data[destaddr], &cart->CartRom.data[sourceaddr], len);
+    _graphics->markMemoryDirty(destaddr, len);
 }
 
 void Vm::vm_reload(int destaddr, int sourceaddr, int len, string filename){
@@ -968,27 +1117,39 @@ void Vm::vm_reload(int destaddr, int sourceaddr, int len, string filename){
         return;
     }
 
-    Cart* cart = _loadedCart;
-    bool multicart = false;
-
-    if (filename.length() > 0) {
-        cart = new Cart(filename, _host->getCartDirectory());
-        if (cart->LoadError.length() > 0) {
-            //error, can't load cart
-            //todo: see what kind of error pico 8 throws, emulate
-            delete cart;
+    if (filename.length() == 0) {
+        vm_reload(destaddr, sourceaddr, len, _loadedCart);
+        return;
+    }
 
+    //multicart read. decoding the other cart is the slow part, so keep its rom around
+    string cartPath = resolveCartPath(filename, _host->getCartDirectory());
+    int64_t mtime = get_file_modified_time(cartPath);
+    if (mtime >= 0 && sourceaddr + len <= (int)sizeof(CartRomData)) {
+        const CartRomData* rom = _cartRomCache.get(cartPath, mtime);
+        if (rom != nullptr) {
+            memcpy(&_memory->data[destaddr], &rom->data[sourceaddr], len);
+            _graphics->markMemoryDirty(destaddr, len);
             return;
         }
+    }
 
-        multicart = true;
+    Cart* cart = new Cart(filename, _host->getCartDirectory());
+    if (cart->LoadError.length() > 0) {
+        //error, can't load cart
+        //todo: see what kind of error pico 8 throws, emulate
+        delete cart;
+
+        return;
+    }
+
+    if (mtime >= 0) {
+        _cartRomCache.put(cartPath, mtime, cart->CartRom);
     }
 
     vm_reload(destaddr, sourceaddr, len, cart);
 
-    if (multicart) {
-        delete cart;
-    }
+    delete cart;
 }
 
 void Vm::vm_memset(int destaddr, uint8_t val, int len){
@@ -1000,7 +1161,7 @@ void Vm::vm_memset(int destaddr, uint8_t val, int len){
     }
 
     memset(&_memory->data[destaddr], val, len);
-
+    _graphics->markMemoryDirty(destaddr, len);
 }
 void Vm::vm_memcpy(int destaddr, int sourceaddr, int len){
     if (len <= 0) {
@@ -1014,6 +1175,7 @@ void Vm::vm_memcpy(int destaddr, int sourceaddr, int len){
     }
 
     memcpy(&_memory->data[destaddr], &_memory->data[sourceaddr], len);
+    _graphics->markMemoryDirty(destaddr, len);
 }
 
 void Vm::update_prng()
@@ -1068,6 +1230,8 @@ void Vm::vm_flip() {
     }
 
     if (!_host->shouldQuit() && !_cartChangeQueued) {
+        endCpuFrame();
+
         update_buttons();
 
         _picoFrameCount++;
@@ -1078,6 +1242,7 @@ void Vm::vm_flip() {
             togglePauseMenu();
 
             //shouldn't get here
+            beginCpuFrame();
             return;
         }
 
@@ -1085,9 +1250,6 @@ void Vm::vm_flip() {
 
         _host->setTargetFps(_targetFps);
 
-        uint8_t* picoFb = GetPicoInteralFb();
-        uint8_t* screenPaletteMap = GetScreenPaletteMap();
-
         if (_pauseMenu){
             //pause menu probably needs refactor out of lua. For now this is better than just quitting
             lua_getglobal(_luaState, "__f08_menu_update");
@@ -1099,10 +1261,16 @@ void Vm::vm_flip() {
             lua_pop(_luaState, 0);
         }
 
-        _host->drawFrame(picoFb, screenPaletteMap, _memory->drawState.drawMode);
+        uint8_t* picoFb = GetPresentedFrameBuffer();
+        uint8_t* screenPaletteMap = GetScreenPaletteMap();
+
+        //draw mode transforms are already applied to the presented buffer
+        _host->drawFrame(picoFb, screenPaletteMap, 0);
 
         //is this better at the end of the loop?
         _host->waitForTargetFps();
+
+        beginCpuFrame();
     }
 }
 
@@ -1146,6 +1314,7 @@ void Vm::vm_reset(){
     _graphics->color();
     _graphics->clip();
     _graphics->pal();
+    _graphics->markAllDirty();
 }
 
 void Vm::setTargetFps(int targetFps){
@@ -1161,6 +1330,71 @@ int Vm::getTargetFps(){
     return _targetFps;
 }
 
+void Vm::beginCpuFrame(){
+    _cpuFrameStart = std::chrono::steady_clock::now();
+    _luaInstructionCount = 0;
+
+    if (_cpuCycleEstimate && _luaState) {
+        //re-arming the hook restarts its countdown so every frame counts from the same phase
+        lua_sethook(_luaState, countLuaInstructions, LUA_MASKCOUNT, LuaInstructionHookInterval);
+    }
+}
+
+void Vm::endCpuFrame(){
+    _prevFrameCpu = getCpuUsage();
+}
+
+float Vm::getCpuUsage(){
+    int fps = _targetFps > 0 ? _targetFps : 30;
+
+    if (_cpuCycleEstimate) {
+        int64_t cycles = _luaInstructionCount * CyclesPerLuaInstruction;
+
+        return (float)cycles * fps / PicoCyclesPerSecond;
+    }
+
+    std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - _cpuFrameStart;
+
+    return elapsed.count() * fps;
+}
+
+float Vm::getPrevFrameCpuUsage(){
+    return _prevFrameCpu;
+}
+
+size_t Vm::getLuaMemoryUsage(){
+    return _luaAllocState.liveBytes;
+}
+
+LuaArenaStats Vm::getLuaAllocatorStats(){
+    return _luaAllocState.stats;
+}
+
+void Vm::setLuaMemoryLimit(size_t limitBytes){
+    _luaMemoryLimit = limitBytes;
+}
+
+void Vm::setCartRomCacheBudget(size_t budgetBytes){
+    _cartRomCache.setBudget(budgetBytes);
+}
+
+CartRomCache* Vm::getCartRomCache(){
+    return &_cartRomCache;
+}
+
+void Vm::setCpuCycleEstimate(bool enabled){
+    _cpuCycleEstimate = enabled;
+
+    if (_luaState) {
+        if (enabled) {
+            lua_sethook(_luaState, countLuaInstructions, LUA_MASKCOUNT, LuaInstructionHookInterval);
+        }
+        else {
+            lua_sethook(_luaState, nullptr, 0, 0);
+        }
+    }
+}
+
 int Vm::getYear(){
     std::time_t t = std::time(0);
     std::tm* now = std::localtime(&t);
@@ -1240,7 +1474,7 @@ void Vm::loadLabel(std::string filename, bool mini, int minioffset) {
     
     auto cartDir = _host->getCartDirectory();
     Cart *labelcart = new Cart(filename, cartDir);
-    std::string labelstr = labelcart->LabelString;
+    std::string_view labelstr = labelcart->LabelString;
     if(labelstr.length() == 0){
         labelstr = NoLabelString;
     }
@@ -2,12 +2,16 @@
 
 #include <vector>
 #include <string>
+#include <chrono>
 using namespace std;
 
 #include "cart.h"
 #include "Input.h"
 #include "Audio.h"
+#include "audioRenderThread.h"
 #include "host.h"
+#include "luaAllocator.h"
+#include "cartRomCache.h"
 
 //extern "C" {
   #include <lua.h>
@@ -25,10 +29,15 @@ class Vm {
 
     Graphics* _graphics;
     Audio* _audio;
+    AudioRenderThread* _audioRenderThread;
     Input* _input;
 
     Cart* _loadedCart;
+    //roms of other carts read by reload()
+    CartRomCache _cartRomCache;
     lua_State* _luaState;
+    LuaAllocatorState _luaAllocState;
+    size_t _luaMemoryLimit;
 
     bool _cleanupDeps;
 
@@ -60,7 +69,17 @@ class Vm {
     int _draw_ref;
     bool _refs_cached;
 
+    //cpu usage for stat(1)/stat(2)
+    bool _cpuCycleEstimate;
+    std::chrono::steady_clock::time_point _cpuFrameStart;
+    float _prevFrameCpu;
+    //lua instructions run this frame, counted by the cycle estimate hook
+    int64_t _luaInstructionCount;
+
     bool loadCart(Cart* cart);
+    void beginCpuFrame();
+    void endCpuFrame();
+    static void countLuaInstructions(lua_State *L, lua_Debug *ar);
     void vm_reload(int destaddr, int sourceaddr, int len, Cart* cart);
 
 
@@ -83,10 +102,23 @@ class Vm {
     void UpdateAndDraw();
 
     uint8_t* GetPicoInteralFb();
+    //the frame buffer with the current draw mode applied; what hosts should display
+    uint8_t* GetPresentedFrameBuffer();
+    //secondary scanline palette, valid after GetPresentedFrameBuffer
+    AltScreenPalette_t* GetAltScreenPalette();
     uint8_t* GetScreenPaletteMap();
+    //rows changed since the last clear. whoever presents the frame clears it
+    ScreenDirtyState_t* GetScreenDirtyState();
+    void ClearScreenDirtyState();
 
     void FillAudioBuffer(void *audioBuffer, size_t offset, size_t size);
 
+    //renders audio ahead of the frame loop on its own thread; FillAudioBuffer
+    //then just copies out of its ring. false if threads aren't available
+    bool StartAudioRenderThread(int lookaheadMs);
+    void StopAudioRenderThread();
+    AudioRenderThread* GetAudioRenderThread();
+
     void CloseCart();
 
     void QueueCartChange(string newcart);
@@ -150,6 +182,25 @@ class Vm {
     int getFps();
     int getTargetFps();
 
+    //fraction of the frame budget used so far this frame (1.0 == 100%)
+    float getCpuUsage();
+    //fraction of the frame budget used by the last completed frame
+    float getPrevFrameCpuUsage();
+    //when enabled cpu usage is estimated from lua instruction counts instead of
+    //wall time, so it is the same on every host
+    void setCpuCycleEstimate(bool enabled);
+
+    //bytes currently allocated by the cart's lua state
+    size_t getLuaMemoryUsage();
+    //chunk/free list counters for the lua arena allocator
+    LuaArenaStats getLuaAllocatorStats();
+    //cap on lua memory applied to the next cart loaded. 0 disables the cap
+    void setLuaMemoryLimit(size_t limitBytes);
+
+    //memory kept for decoded roms of carts read by reload(). 0 disables the cache
+    void setCartRomCacheBudget(size_t budgetBytes);
+    CartRomCache* getCartRomCache();
+
     int getYear();
     int getMonth();
     int getDay();
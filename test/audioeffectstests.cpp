@@ -0,0 +1,141 @@
+#include <string.h>
+
+#include "doctest.h"
+#include "../source/audioEffects.h"
+#include "../source/Audio.h"
+#include "../source/PicoRam.h"
+
+TEST_CASE("channel hardware effects") {
+    ChannelFxState fx;
+    resetChannelFx(&fx);
+    int16_t samples[AUDIO_FX_BLOCK_SIZE];
+
+    SUBCASE("no effects leaves samples alone") {
+        for (int i = 0; i < AUDIO_FX_BLOCK_SIZE; i++) {
+            samples[i] = (int16_t)(i * 97 - 12000);
+        }
+        applyChannelFx(&fx, samples, AUDIO_FX_BLOCK_SIZE, false, false, false);
+
+        bool same = true;
+        for (int i = 0; i < AUDIO_FX_BLOCK_SIZE; i++) {
+            same &= samples[i] == (int16_t)(i * 97 - 12000);
+        }
+        CHECK(same);
+    }
+    SUBCASE("distort quantizes samples") {
+        samples[0] = 0x0fff;
+        samples[1] = 0x1000;
+        samples[2] = 0x7fff;
+        applyChannelFx(&fx, samples, 3, true, false, false);
+
+        CHECK_EQ(samples[0], 0);
+        CHECK_EQ(samples[1], 0x1249);
+        CHECK_EQ(samples[2], 0x7fff);
+    }
+    SUBCASE("lowpass smooths a step") {
+        for (int i = 0; i < AUDIO_FX_BLOCK_SIZE; i++) {
+            samples[i] = 10000;
+        }
+        applyChannelFx(&fx, samples, AUDIO_FX_BLOCK_SIZE, false, true, false);
+
+        CHECK(samples[0] > 0);
+        CHECK(samples[0] < 10000);
+        CHECK(samples[1] > samples[0]);
+        CHECK(samples[AUDIO_FX_BLOCK_SIZE - 1] > 9900);
+    }
+    SUBCASE("lowpass carries state across blocks") {
+        samples[0] = 10000;
+        applyChannelFx(&fx, samples, 1, false, true, false);
+        int16_t first = samples[0];
+        samples[0] = 10000;
+        applyChannelFx(&fx, samples, 1, false, true, false);
+
+        CHECK(samples[0] > first);
+    }
+    SUBCASE("lowpass follows a full scale square wave") {
+        for (int i = 0; i < AUDIO_FX_BLOCK_SIZE; i++) {
+            samples[i] = -0x8000;
+        }
+        applyChannelFx(&fx, samples, AUDIO_FX_BLOCK_SIZE, false, true, false);
+        for (int i = 0; i < AUDIO_FX_BLOCK_SIZE; i++) {
+            samples[i] = 0x7fff;
+        }
+        applyChannelFx(&fx, samples, AUDIO_FX_BLOCK_SIZE, false, true, false);
+
+        CHECK(samples[0] > -0x8000);
+        CHECK(samples[1] > samples[0]);
+        CHECK(samples[AUDIO_FX_BLOCK_SIZE - 1] > 0x7f00);
+    }
+    SUBCASE("reverb echoes an impulse") {
+        memset(samples, 0, sizeof(samples));
+        samples[0] = 8000;
+        applyChannelFx(&fx, samples, AUDIO_FX_BLOCK_SIZE, false, false, true);
+        CHECK_EQ(samples[0], 8000);
+        CHECK_EQ(samples[1], 0);
+
+        //the echo lands in the second block
+        memset(samples, 0, sizeof(samples));
+        applyChannelFx(&fx, samples, AUDIO_FX_BLOCK_SIZE, false, false, true);
+        int echoAt = AUDIO_FX_REVERB_DELAY - AUDIO_FX_BLOCK_SIZE;
+        CHECK_EQ(samples[echoAt], 4000);
+        CHECK_EQ(samples[echoAt - 1], 0);
+    }
+    SUBCASE("disabling reverb drops the tail") {
+        memset(samples, 0, sizeof(samples));
+        samples[0] = 8000;
+        applyChannelFx(&fx, samples, AUDIO_FX_BLOCK_SIZE, false, false, true);
+        memset(samples, 0, sizeof(samples));
+        applyChannelFx(&fx, samples, AUDIO_FX_BLOCK_SIZE, false, false, false);
+        applyChannelFx(&fx, samples, AUDIO_FX_BLOCK_SIZE, false, false, true);
+
+        bool silent = true;
+        for (int i = 0; i < AUDIO_FX_BLOCK_SIZE; i++) {
+            silent &= samples[i] == 0;
+        }
+        CHECK(silent);
+    }
+}
+
+TEST_CASE("audio renders hardware effects per channel") {
+    PicoRam picoRam;
+    picoRam.Reset();
+    Audio* audio = new Audio(&picoRam);
+
+    note n;
+    n.setWaveform(2);
+    n.setVolume(7);
+    n.setKey(33);
+    picoRam.sfx[0].speed = 16;
+    for (int i = 0; i < 32; i++) {
+        picoRam.sfx[0].notes[i] = n;
+    }
+
+    SUBCASE("half rate plays every sample twice") {
+        picoRam.hwState.half_rate = 0x01;
+        audio->api_sfx(0, 0, 0);
+
+        int16_t buffer[600];
+        audio->FillMonoAudioBuffer(buffer, 0, 600);
+
+        bool pairs = true;
+        for (int i = 0; i < 600; i += 2) {
+            pairs &= buffer[i] == buffer[i + 1];
+        }
+        CHECK(pairs);
+    }
+    SUBCASE("half rate on another channel leaves this one alone") {
+        picoRam.hwState.half_rate = 0x02;
+        audio->api_sfx(0, 0, 0);
+
+        int16_t buffer[600];
+        audio->FillMonoAudioBuffer(buffer, 0, 600);
+
+        bool pairs = true;
+        for (int i = 0; i < 600; i += 2) {
+            pairs &= buffer[i] == buffer[i + 1];
+        }
+        CHECK_FALSE(pairs);
+    }
+
+    delete audio;
+}
@@ -0,0 +1,98 @@
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "doctest.h"
+#include "../source/audioRenderThread.h"
+#include "../source/Audio.h"
+#include "../source/PicoRam.h"
+
+#if AUDIO_RENDER_THREAD_SUPPORTED
+
+static void waitForBuffered(AudioRenderThread* thread, uint32_t samples) {
+    for (int i = 0; i < 1000 && thread->getBufferedSamples() < samples; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+TEST_CASE("audio render thread") {
+    PicoRam picoRam;
+    picoRam.Reset();
+    Audio* audio = new Audio(&picoRam);
+
+    note n = {};
+    n.setWaveform(2);
+    n.setVolume(7);
+    n.setKey(33);
+    picoRam.sfx[0].speed = 16;
+    for (int i = 0; i < 32; i++) {
+        picoRam.sfx[0].notes[i] = n;
+    }
+
+    AudioRenderThread* thread = new AudioRenderThread(audio, 22050);
+    REQUIRE(thread->start(30));
+    CHECK(thread->isRunning());
+
+    SUBCASE("fills the lookahead") {
+        waitForBuffered(thread, 512);
+        CHECK(thread->getBufferedSamples() >= 512);
+        CHECK(thread->getBufferedSamples() <= 22050 * 30 / 1000);
+    }
+    SUBCASE("sfx calls reach the renderer") {
+        audio->api_sfx(0, 0, 0);
+        thread->pause();
+        thread->flush();
+        thread->resume();
+        waitForBuffered(thread, 512);
+
+        uint32_t buffer[512];
+        CHECK_EQ(thread->read(buffer, 512), 512);
+
+        bool audible = false;
+        for (int i = 0; i < 512; i++) {
+            audible |= buffer[i] != 0;
+        }
+        CHECK(audible);
+        CHECK_EQ(thread->getUnderruns(), 0);
+    }
+    SUBCASE("short reads are padded with silence") {
+        thread->pause();
+        thread->flush();
+
+        uint32_t buffer[64];
+        memset(buffer, 0xff, sizeof(buffer));
+        CHECK_EQ(thread->read(buffer, 64), 0);
+        CHECK_EQ(buffer[0], 0);
+        CHECK_EQ(buffer[63], 0);
+        CHECK_EQ(thread->getUnderruns(), 1);
+
+        thread->resume();
+    }
+    SUBCASE("flush after pause leaves nothing buffered") {
+        for (int i = 0; i < 200; i++) {
+            thread->resume();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            thread->pause();
+            thread->flush();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+            REQUIRE_EQ(thread->getBufferedSamples(), 0);
+        }
+        thread->resume();
+    }
+    SUBCASE("sfx calls apply directly again after stop") {
+        thread->stop();
+        audio->api_sfx(0, 1, 0);
+
+        CHECK_EQ(audio->getCurrentSfxId(1), 0);
+    }
+
+    thread->stop();
+    CHECK_FALSE(thread->isRunning());
+
+    delete thread;
+    delete audio;
+}
+
+#endif
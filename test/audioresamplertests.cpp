@@ -0,0 +1,97 @@
+#include <math.h>
+#include <vector>
+
+#include "doctest.h"
+#include "../source/audioResampler.h"
+
+//one second of input in libretro sized chunks (367/368 frames)
+static std::vector<int16_t> resampleSecond(AudioResampler* resampler, const std::vector<int16_t>& input) {
+    std::vector<int16_t> output;
+    std::vector<int16_t> chunkOut;
+    size_t frames = input.size() / 2;
+    size_t done = 0;
+    int remainder = 0;
+
+    while (done < frames) {
+        remainder += 22050;
+        size_t count = remainder / 60;
+        remainder %= 60;
+        if (done + count > frames) {
+            count = frames - done;
+        }
+
+        chunkOut.resize(resampler->maxOutputFrames(count) * 2);
+        size_t written = resampler->process(&input[done * 2], count, chunkOut.data());
+        REQUIRE(written <= resampler->maxOutputFrames(count));
+        output.insert(output.end(), chunkOut.begin(), chunkOut.begin() + written * 2);
+        done += count;
+    }
+
+    return output;
+}
+
+TEST_CASE("audio resampler") {
+    AudioResampler resampler;
+
+    SUBCASE("rejects ratios with too many phases") {
+        CHECK_FALSE(resampler.configure(22050, 44099));
+        CHECK_FALSE(resampler.configure(0, 48000));
+    }
+    SUBCASE("output count follows the rate ratio") {
+        REQUIRE(resampler.configure(22050, 48000));
+        std::vector<int16_t> input(22050 * 2, 0);
+        std::vector<int16_t> output = resampleSecond(&resampler, input);
+
+        //everything except the filter's lookahead comes out
+        CHECK(output.size() / 2 <= 48000);
+        CHECK(output.size() / 2 >= 48000 - (AUDIO_RESAMPLER_HALF_TAPS + 1) * 48000 / 22050 - 1);
+    }
+    SUBCASE("dc passes through at unity gain") {
+        REQUIRE(resampler.configure(22050, 44100));
+        std::vector<int16_t> input(22050 * 2, 10000);
+        std::vector<int16_t> output = resampleSecond(&resampler, input);
+
+        bool flat = true;
+        for (size_t i = 200; i < output.size(); i++) {
+            flat &= abs(output[i] - 10000) <= 1;
+        }
+        CHECK(flat);
+    }
+    SUBCASE("keeps the pitch of a tone") {
+        REQUIRE(resampler.configure(22050, 48000));
+        std::vector<int16_t> input(22050 * 2);
+        for (int i = 0; i < 22050; i++) {
+            int16_t s = (int16_t)(12000 * sin(2 * M_PI * 440 * i / 22050.0));
+            input[i * 2] = s;
+            input[i * 2 + 1] = -s;
+        }
+        std::vector<int16_t> output = resampleSecond(&resampler, input);
+
+        int crossings = 0;
+        for (size_t i = 1; i < output.size() / 2; i++) {
+            if (output[(i - 1) * 2] < 0 && output[i * 2] >= 0) {
+                crossings++;
+            }
+        }
+        CHECK(crossings >= 438);
+        CHECK(crossings <= 441);
+
+        //channels stay separate
+        CHECK_EQ(output[1000 * 2], -output[1000 * 2 + 1]);
+    }
+    SUBCASE("reset clears the history") {
+        REQUIRE(resampler.configure(22050, 48000));
+        std::vector<int16_t> loud(512 * 2, 20000);
+        std::vector<int16_t> out(resampler.maxOutputFrames(512) * 2);
+        resampler.process(loud.data(), 512, out.data());
+        resampler.reset();
+
+        std::vector<int16_t> quiet(512 * 2, 0);
+        size_t written = resampler.process(quiet.data(), 512, out.data());
+        bool silent = true;
+        for (size_t i = 0; i < written * 2; i++) {
+            silent &= out[i] == 0;
+        }
+        CHECK(silent);
+    }
+}
@@ -6,6 +6,10 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <filesystem>
 
 typedef struct WAV_HEADER {
   /* RIFF Chunk Descriptor */
@@ -319,8 +323,288 @@ TEST_CASE("audio class behaves as expected") {
         int16_t sample = audio->getSampleForChannel(0);
         os.write(reinterpret_cast<char *>(&sample), sizeof(int16_t));
       }
-      write_wav(&os, "bass.wav");
+      //written outside the tree so a test run doesn't leave output behind
+      std::string wavPath = (std::filesystem::temp_directory_path() / "fake08-bass.wav").string();
+      write_wav(&os, wavPath.c_str());
       delete cart;
     }
 
 }
+
+TEST_CASE("block renderer matches per sample rendering") {
+    PicoRam picoRam;
+    picoRam.Reset();
+
+    //every builtin waveform and every effect
+    for (int s = 0; s < 64; s++) {
+        picoRam.sfx[s].speed = 2 + s % 13;
+        picoRam.sfx[s].loopRangeStart = s % 3 == 0 ? 4 : 0;
+        picoRam.sfx[s].loopRangeEnd = s % 3 == 0 ? 9 : 0;
+        for (int n = 0; n < 32; n++) {
+            note x;
+            int waveform = (s + n) % 8;
+            x.setWaveform(waveform);
+            x.setVolume((s + n * 3) % 8);
+            x.setKey((s * 7 + n * 5) % 64);
+            x.setEffect((s + n * 2) % 8);
+            x.setCustom(s >= 8 && n % 5 == 0);
+            picoRam.sfx[s].notes[n] = x;
+        }
+    }
+    for (int p = 0; p < 64; p++) {
+        for (int c = 0; c < 4; c++) {
+            picoRam.songs[p].data[c] = 8 + (p * 4 + c * 11) % 56;
+        }
+    }
+    picoRam.songs[2].data[1] |= 0x80;
+
+    Audio* blockAudio = new Audio(&picoRam);
+    Audio* sampleAudio = new Audio(&picoRam);
+    blockAudio->api_music(0, 0, 0xf);
+    sampleAudio->api_music(0, 0, 0xf);
+
+    int16_t buffer[1000];
+    int mismatches = 0;
+    for (int chunk = 0; chunk < 60; chunk++) {
+        if (chunk == 30) {
+            blockAudio->api_sfx(12, 2, 3);
+            sampleAudio->api_sfx(12, 2, 3);
+        }
+
+        int size = 100 + (chunk * 37) % 900;
+        blockAudio->FillMonoAudioBuffer(buffer, 0, size);
+
+        for (int i = 0; i < size; i++) {
+            int32_t sample = 0;
+            for (int c = 0; c < 4; c++) {
+                sample += sampleAudio->getSampleForChannel(c);
+            }
+            if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
+
+            mismatches += buffer[i] != sample;
+        }
+    }
+
+    CHECK_EQ(mismatches, 0);
+
+    delete blockAudio;
+    delete sampleAudio;
+}
+
+TEST_CASE("noise is deterministic per channel") {
+    PicoRam picoRam;
+    picoRam.Reset();
+
+    for (int s = 0; s < 2; s++) {
+        picoRam.sfx[s].speed = 16;
+        for (int n = 0; n < 32; n++) {
+            note x = {};
+            x.setWaveform(6);
+            x.setVolume(5);
+            x.setKey(20 + s * 12 + n % 7);
+            picoRam.sfx[s].notes[n] = x;
+        }
+    }
+
+    Audio* first = new Audio(&picoRam);
+    Audio* second = new Audio(&picoRam);
+    Audio* alone = new Audio(&picoRam);
+    first->resetAudioState(1234);
+    second->resetAudioState(1234);
+    alone->resetAudioState(1234);
+
+    first->api_sfx(0, 0, 0);
+    first->api_sfx(1, 1, 0);
+    second->api_sfx(0, 0, 0);
+    second->api_sfx(1, 1, 0);
+    alone->api_sfx(0, 0, 0);
+
+    int instanceMismatches = 0;
+    int channelMismatches = 0;
+    int nonZero = 0;
+    for (int i = 0; i < 22050; i++) {
+        int16_t sample = first->getSampleForChannel(0);
+        int16_t other = first->getSampleForChannel(1);
+
+        instanceMismatches += sample != second->getSampleForChannel(0);
+        instanceMismatches += other != second->getSampleForChannel(1);
+        //a second noise channel doesn't change the first one
+        channelMismatches += sample != alone->getSampleForChannel(0);
+        nonZero += sample != 0;
+    }
+
+    CHECK_EQ(instanceMismatches, 0);
+    CHECK_EQ(channelMismatches, 0);
+    CHECK(nonZero > 11025);
+
+    SUBCASE("different seeds give different noise") {
+        Audio* reseeded = new Audio(&picoRam);
+        reseeded->resetAudioState(4321);
+        first->resetAudioState(1234);
+        reseeded->api_sfx(0, 0, 0);
+        first->api_sfx(0, 0, 0);
+
+        int differences = 0;
+        for (int i = 0; i < 1000; i++) {
+            differences += first->getSampleForChannel(0) != reseeded->getSampleForChannel(0);
+        }
+        CHECK(differences > 0);
+
+        delete reseeded;
+    }
+
+    delete first;
+    delete second;
+    delete alone;
+}
+
+TEST_CASE("audio instances render independently on separate threads") {
+    PicoRam picoRam;
+    picoRam.Reset();
+
+    //a different key on every note, and noise, so shared frequency or
+    //noise state between instances would show up in the output
+    for (int s = 0; s < 2; s++) {
+        picoRam.sfx[s].speed = 3 + s;
+        for (int n = 0; n < 32; n++) {
+            note x = {};
+            x.setWaveform(s == 0 ? n % 8 : 6);
+            x.setVolume(5);
+            x.setKey((n * 7 + s * 29) % 64);
+            picoRam.sfx[s].notes[n] = x;
+        }
+    }
+
+    const int sampleCount = 22050;
+    std::vector<int16_t> expected[2];
+    std::vector<int16_t> rendered[2];
+    Audio* audio[2];
+
+    for (int i = 0; i < 2; i++) {
+        audio[i] = new Audio(&picoRam);
+        audio[i]->resetAudioState(1234);
+        audio[i]->api_sfx(i, 0, 0);
+        for (int s = 0; s < sampleCount; s++) {
+            expected[i].push_back(audio[i]->getSampleForChannel(0));
+        }
+
+        audio[i]->resetAudioState(1234);
+        audio[i]->api_sfx(i, 0, 0);
+    }
+
+    std::thread renderers[2];
+    for (int i = 0; i < 2; i++) {
+        renderers[i] = std::thread([&, i]() {
+            for (int s = 0; s < sampleCount; s++) {
+                rendered[i].push_back(audio[i]->getSampleForChannel(0));
+            }
+        });
+    }
+    for (int i = 0; i < 2; i++) {
+        renderers[i].join();
+    }
+
+    CHECK(expected[0] == rendered[0]);
+    CHECK(expected[1] == rendered[1]);
+
+    delete audio[0];
+    delete audio[1];
+}
+
+TEST_CASE("audio command queue") {
+    AudioCommandQueue queue;
+    AudioCommand command;
+
+    SUBCASE("pops commands in order") {
+        for (int i = 0; i < 3; i++) {
+            AudioCommand c = { AUDIO_CMD_SFX, { i, 0, 0 } };
+            CHECK(queue.push(c));
+        }
+        for (int i = 0; i < 3; i++) {
+            CHECK(queue.pop(&command));
+            CHECK_EQ(command.args[0], i);
+        }
+        CHECK_FALSE(queue.pop(&command));
+    }
+    SUBCASE("drops commands when full") {
+        AudioCommand c = { AUDIO_CMD_MUSIC, { 1, 0, 0 } };
+        for (int i = 0; i < AUDIO_COMMAND_QUEUE_SIZE; i++) {
+            queue.push(c);
+        }
+        CHECK_FALSE(queue.push(c));
+
+        CHECK(queue.pop(&command));
+        CHECK(queue.push(c));
+    }
+    SUBCASE("wraps around") {
+        int popped = 0;
+        bool inOrder = true;
+        for (int i = 0; i < AUDIO_COMMAND_QUEUE_SIZE * 3; i++) {
+            AudioCommand c = { AUDIO_CMD_SFX, { i, 0, 0 } };
+            queue.push(c);
+            if (i % 3 == 2) {
+                while (queue.pop(&command)) {
+                    inOrder &= command.args[0] == popped++;
+                }
+            }
+        }
+        CHECK(inOrder);
+        CHECK_EQ(popped, AUDIO_COMMAND_QUEUE_SIZE * 3);
+    }
+}
+
+TEST_CASE("threaded rendering defers commands to the renderer") {
+    PicoRam picoRam;
+    picoRam.Reset();
+    Audio* audio = new Audio(&picoRam);
+    audioState_t* audioState = audio->getAudioState();
+    audio->setThreadedRendering(true);
+    int16_t buffer[16];
+
+    SUBCASE("sfx is applied at the next block") {
+        audio->api_sfx(3, 1, 0);
+        CHECK_EQ(audioState->_sfxChannels[1].sfxId, -1);
+        CHECK_EQ(audio->getCurrentSfxId(1), -1);
+
+        audio->FillMonoAudioBuffer(buffer, 0, 16);
+        CHECK_EQ(audioState->_sfxChannels[1].sfxId, 3);
+        CHECK_EQ(audio->getCurrentSfxId(1), 3);
+        CHECK_EQ(audio->getCurrentNoteNumber(1), 0);
+    }
+    SUBCASE("music and reset keep their order") {
+        audio->api_music(2, 0, 0);
+        audio->resetAudioState();
+        audio->api_sfx(4, 0, 0);
+
+        audio->FillMonoAudioBuffer(buffer, 0, 16);
+        CHECK_EQ(audio->getCurrentMusic(), -1);
+        CHECK_EQ(audio->getCurrentSfxId(0), 4);
+    }
+    SUBCASE("a reset waits for room in a full queue") {
+        for (int i = 0; i < AUDIO_COMMAND_QUEUE_SIZE; i++) {
+            audio->api_sfx(4, 0, 0);
+        }
+
+        std::thread renderer([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            audio->FillMonoAudioBuffer(buffer, 0, 16);
+        });
+        audio->resetAudioState();
+        renderer.join();
+
+        CHECK_EQ(audio->getCurrentSfxId(0), 4);
+        audio->FillMonoAudioBuffer(buffer, 0, 16);
+        CHECK_EQ(audio->getCurrentSfxId(0), -1);
+    }
+    SUBCASE("a stop is dropped only once the renderer stops draining") {
+        for (int i = 0; i < AUDIO_COMMAND_QUEUE_SIZE; i++) {
+            audio->api_sfx(4, 0, 0);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        audio->api_sfx(-1, 0, 0);
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(AUDIO_COMMAND_WAIT_MS));
+    }
+
+    delete audio;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "doctest.h"
+#include "../source/cart.h"
+#include "../source/cartCache.h"
+#include "../source/filehelpers.h"
+
+TEST_CASE("cart cache") {
+    setCartCacheDirectory(".");
+
+    SUBCASE("hash depends on every byte") {
+        unsigned char a[] = { 1, 2, 3, 4 };
+        unsigned char b[] = { 1, 2, 3, 5 };
+
+        CHECK(hashCartContents(a, 4) == hashCartContents(a, 4));
+        CHECK(hashCartContents(a, 4) != hashCartContents(b, 4));
+    }
+    SUBCASE("entries round trip") {
+        CartRomData* rom = new CartRomData;
+        memset(rom->data, 0x5a, sizeof(rom->data));
+        writeCartCache(1234, *rom, "print('hi')\n", "label");
+
+        memset(rom->data, 0, sizeof(rom->data));
+        std::string lua;
+        std::string label;
+        REQUIRE(readCartCache(1234, rom, &lua, &label));
+        CHECK_EQ(rom->data[0], 0x5a);
+        CHECK_EQ(rom->data[sizeof(rom->data) - 1], 0x5a);
+        CHECK_EQ(lua, "print('hi')\n");
+        CHECK_EQ(label, "label");
+
+        CHECK_FALSE(readCartCache(4321, rom, &lua, &label));
+
+        remove("./00000000000004d2.f8c");
+        delete rom;
+    }
+    SUBCASE("header padding is written as zeros") {
+        CartRomData* rom = new CartRomData;
+        memset(rom->data, 0, sizeof(rom->data));
+        REQUIRE(writeCartCache(1234, *rom, "", ""));
+
+        std::vector<char> contents = get_file_as_buffer("./00000000000004d2.f8c");
+        REQUIRE(contents.size() == 32 + sizeof(rom->data));
+        //magic, version, hash, rom size and lengths take 28 of the 32 bytes
+        for (int i = 28; i < 32; i++) {
+            CHECK_EQ(contents[i], 0);
+        }
+        CHECK(get_file_as_buffer("./00000000000004d2.f8c.tmp").empty());
+
+        remove("./00000000000004d2.f8c");
+        delete rom;
+    }
+    SUBCASE("entries with lengths past the end of the file are rejected") {
+        CartRomData* rom = new CartRomData;
+        memset(rom->data, 0, sizeof(rom->data));
+        REQUIRE(writeCartCache(1234, *rom, "print('hi')\n", "label"));
+
+        //luaLength sits right after magic, version, hash and rom size
+        FILE* file = fopen("./00000000000004d2.f8c", "r+b");
+        REQUIRE(file != NULL);
+        uint32_t hugeLength = 0xfffffff0;
+        fseek(file, 20, SEEK_SET);
+        fwrite(&hugeLength, sizeof(hugeLength), 1, file);
+        fclose(file);
+
+        std::string lua;
+        std::string label;
+        CHECK_FALSE(readCartCache(1234, rom, &lua, &label));
+        CHECK(lua.empty());
+        CHECK(lua.capacity() < 0x10000);
+
+        remove("./00000000000004d2.f8c");
+        delete rom;
+    }
+    SUBCASE("writing over an existing entry replaces it") {
+        CartRomData* rom = new CartRomData;
+        memset(rom->data, 0, sizeof(rom->data));
+        REQUIRE(writeCartCache(1234, *rom, "a = 1\n", ""));
+        REQUIRE(writeCartCache(1234, *rom, "a = 2\n", ""));
+
+        std::string lua;
+        std::string label;
+        REQUIRE(readCartCache(1234, rom, &lua, &label));
+        CHECK_EQ(lua, "a = 2\n");
+
+        remove("./00000000000004d2.f8c");
+        delete rom;
+    }
+    SUBCASE("second load of a cart comes from the cache") {
+        std::vector<char> contents = get_file_as_buffer("carts/cartparsetest.p8.png");
+        uint64_t hash = hashCartContents((const unsigned char*)contents.data(), contents.size());
+        char path[32];
+        snprintf(path, sizeof(path), "./%016llx.f8c", (unsigned long long)hash);
+        remove(path);
+
+        Cart* parsed = new Cart("cartparsetest.p8.png", "carts");
+        Cart* cached = new Cart("cartparsetest.p8.png", "carts");
+
+        CHECK(get_first_four_chars(path) == "F8CC");
+        CHECK_EQ(cached->LoadError, "");
+        CHECK_EQ(cached->LuaString, parsed->LuaString);
+        CHECK_EQ(memcmp(cached->CartRom.data, parsed->CartRom.data, sizeof(CartRomData)), 0);
+
+        remove(path);
+        delete parsed;
+        delete cached;
+    }
+
+    setCartCacheDirectory("");
+}
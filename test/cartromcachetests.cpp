@@ -0,0 +1,72 @@
+#include <string.h>
+
+#include "doctest.h"
+#include "../source/cartRomCache.h"
+
+static void fillRom(CartRomData* rom, uint8_t value) {
+    memset(rom->data, value, sizeof(rom->data));
+}
+
+TEST_CASE("cart rom cache") {
+    CartRomCache cache(2 * sizeof(CartRomData));
+    CartRomData* rom = new CartRomData;
+
+    SUBCASE("misses before anything is cached") {
+        CHECK_EQ(cache.get("carts/a.p8", 10), nullptr);
+        CHECK_EQ(cache.getMisses(), 1);
+    }
+    SUBCASE("returns the cached rom") {
+        fillRom(rom, 7);
+        cache.put("carts/a.p8", 10, *rom);
+        fillRom(rom, 0);
+
+        const CartRomData* cached = cache.get("carts/a.p8", 10);
+        REQUIRE(cached != nullptr);
+        CHECK_EQ(cached->data[0], 7);
+        CHECK_EQ(cached->data[sizeof(cached->data) - 1], 7);
+        CHECK_EQ(cache.getHits(), 1);
+    }
+    SUBCASE("a changed mtime drops the entry") {
+        fillRom(rom, 7);
+        cache.put("carts/a.p8", 10, *rom);
+
+        CHECK_EQ(cache.get("carts/a.p8", 11), nullptr);
+        CHECK_EQ(cache.getEntryCount(), 0);
+    }
+    SUBCASE("putting the same path replaces it") {
+        fillRom(rom, 1);
+        cache.put("carts/a.p8", 10, *rom);
+        fillRom(rom, 2);
+        cache.put("carts/a.p8", 12, *rom);
+
+        CHECK_EQ(cache.getEntryCount(), 1);
+        REQUIRE(cache.get("carts/a.p8", 12) != nullptr);
+        CHECK_EQ(cache.get("carts/a.p8", 12)->data[0], 2);
+    }
+    SUBCASE("evicts the least recently used over budget") {
+        fillRom(rom, 1);
+        cache.put("carts/a.p8", 10, *rom);
+        fillRom(rom, 2);
+        cache.put("carts/b.p8", 10, *rom);
+        //a is now the most recent
+        cache.get("carts/a.p8", 10);
+        fillRom(rom, 3);
+        cache.put("carts/c.p8", 10, *rom);
+
+        CHECK_EQ(cache.getEntryCount(), 2);
+        CHECK(cache.get("carts/a.p8", 10) != nullptr);
+        CHECK_EQ(cache.get("carts/b.p8", 10), nullptr);
+        CHECK(cache.get("carts/c.p8", 10) != nullptr);
+    }
+    SUBCASE("zero budget disables it") {
+        fillRom(rom, 1);
+        cache.put("carts/a.p8", 10, *rom);
+        cache.setBudget(0);
+
+        CHECK_EQ(cache.getEntryCount(), 0);
+        cache.put("carts/b.p8", 10, *rom);
+        CHECK_EQ(cache.getEntryCount(), 0);
+    }
+
+    delete rom;
+}
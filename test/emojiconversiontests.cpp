@@ -0,0 +1,26 @@
+#include "doctest.h"
+#include "../source/emojiconversion.h"
+
+TEST_CASE("utf8_to_pico8") {
+    SUBCASE("plain ascii is unchanged") {
+        CHECK_EQ(charset::utf8_to_pico8("print(\"hi\")\n"), "print(\"hi\")\n");
+    }
+    SUBCASE("glyphs become single pico 8 characters") {
+        CHECK_EQ(charset::utf8_to_pico8("btn(⬅️)"), "btn(\x8b)");
+        CHECK_EQ(charset::utf8_to_pico8("♥"), "\x87");
+        CHECK_EQ(charset::utf8_to_pico8("あ"), "\x9a");
+    }
+    SUBCASE("every character round trips") {
+        std::string all;
+        for (int i = 0; i < 256; i++) {
+            all += (char)i;
+        }
+        CHECK_EQ(charset::utf8_to_pico8(charset::pico8_to_utf8(all)), all);
+    }
+    SUBCASE("incomplete glyphs pass through as bytes") {
+        //⬅ without the variation selector
+        CHECK_EQ(charset::utf8_to_pico8("\xe2\xac\x85x"), "\xe2\xac\x85x");
+        //cut off at the end of the string
+        CHECK_EQ(charset::utf8_to_pico8("a\xe2\x99"), "a\xe2\x99");
+    }
+}
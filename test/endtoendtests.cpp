@@ -832,6 +832,25 @@ TEST_CASE("Loading and running carts") {
 
         vm->CloseCart();
     }
+    SUBCASE("primitives with extreme coordinates test cart"){
+        vm->LoadCart("extremecoordstest.p8", false);
+
+        SUBCASE("No error reported"){
+            CHECK(vm->GetBiosError() == "");
+        }
+        SUBCASE("only the full screen fill and diagonal are drawn"){
+            vm->UpdateAndDraw();
+
+            uint8_t* fb = vm->GetPicoInteralFb();
+            for (int y = 0; y < 128; y++) {
+                for (int x = 0; x < 128; x++) {
+                    CHECK_EQ(getPixelNibble(x, y, fb), x == y ? 2 : 1);
+                }
+            }
+        }
+
+        vm->CloseCart();
+    }
     
     delete vm;
     delete host;
@@ -0,0 +1,178 @@
+#include <string.h>
+#include <vector>
+
+#include "doctest.h"
+#include "../source/frameConverter.h"
+#include "../source/nibblehelpers.h"
+
+static Color testColor(int i) {
+    Color col;
+    col.Red = (uint8_t)(i * 37 + 11);
+    col.Green = (uint8_t)(i * 59 + 3);
+    col.Blue = (uint8_t)(i * 83 + 101);
+    col.Alpha = 255;
+    return col;
+}
+
+static uint32_t referencePixel(FramePixelFormat format, Color col) {
+    switch (format) {
+        case FRAME_FORMAT_RGB565:
+            return ((col.Red & 0xf8) << 8) | ((col.Green & 0xfc) << 3) | (col.Blue >> 3);
+        case FRAME_FORMAT_XRGB8888:
+            return ((uint32_t)col.Alpha << 24) | (col.Red << 16) | (col.Green << 8) | col.Blue;
+        case FRAME_FORMAT_RGBA8888:
+            return ((uint32_t)col.Red << 24) | (col.Green << 16) | (col.Blue << 8) | col.Alpha;
+        default:
+            return ((uint32_t)col.Alpha << 24) | (col.Blue << 16) | (col.Green << 8) | col.Red;
+    }
+}
+
+static uint32_t readPixel(FramePixelFormat format, const uint8_t* buffer, int pitch, int x, int y) {
+    if (format == FRAME_FORMAT_RGB565) {
+        uint16_t px;
+        memcpy(&px, buffer + y * pitch + x * 2, 2);
+        return px;
+    }
+
+    uint32_t px;
+    memcpy(&px, buffer + y * pitch + x * 4, 4);
+    return px;
+}
+
+//compares every output pixel against a getPixelNibble based conversion
+static void checkConversion(
+    FramePixelFormat format,
+    const uint8_t* picoFb,
+    const uint8_t* screenPaletteMap,
+    const Color* paletteColors,
+    int scale,
+    int srcX, int srcY, int srcW, int srcH)
+{
+    FrameConverter converter(format);
+    int bpp = converter.getBytesPerPixel();
+    int pitch = srcW * scale * bpp;
+    std::vector<uint8_t> out(pitch * srcH * scale, 0);
+
+    converter.convert(picoFb, screenPaletteMap, nullptr, paletteColors, out.data(), pitch, scale, nullptr, srcX, srcY, srcW, srcH);
+
+    int mismatches = 0;
+    for (int y = 0; y < srcH * scale; y++) {
+        for (int x = 0; x < srcW * scale; x++) {
+            uint8_t c = getPixelNibble(srcX + x / scale, srcY + y / scale, picoFb);
+            uint32_t expected = referencePixel(format, paletteColors[screenPaletteMap[c]]);
+            if (readPixel(format, out.data(), pitch, x, y) != expected) {
+                mismatches++;
+            }
+        }
+    }
+
+    CHECK_EQ(mismatches, 0);
+}
+
+TEST_CASE("frame converter matches per pixel conversion") {
+    uint8_t picoFb[128 * 64];
+    for (int i = 0; i < (int)sizeof(picoFb); i++) {
+        picoFb[i] = (uint8_t)((i * 131) ^ (i >> 3));
+    }
+
+    Color paletteColors[144];
+    for (int i = 0; i < 144; i++) {
+        paletteColors[i] = testColor(i);
+    }
+
+    //include a couple of secret palette entries
+    uint8_t screenPaletteMap[16];
+    for (int i = 0; i < 16; i++) {
+        screenPaletteMap[i] = (uint8_t)i;
+    }
+    screenPaletteMap[3] = 130;
+    screenPaletteMap[9] = 1;
+
+    FramePixelFormat formats[] = { FRAME_FORMAT_RGB565, FRAME_FORMAT_XRGB8888, FRAME_FORMAT_ABGR8888, FRAME_FORMAT_RGBA8888 };
+
+    for (FramePixelFormat format : formats) {
+        //full screen at scales 1-5
+        for (int scale = 1; scale <= 5; scale++) {
+            checkConversion(format, picoFb, screenPaletteMap, paletteColors, scale, 0, 0, 128, 128);
+        }
+        //odd crops, leaving a tail after the vector loops
+        checkConversion(format, picoFb, screenPaletteMap, paletteColors, 1, 5, 3, 117, 120);
+        checkConversion(format, picoFb, screenPaletteMap, paletteColors, 2, 3, 1, 121, 125);
+        checkConversion(format, picoFb, screenPaletteMap, paletteColors, 3, 7, 2, 115, 60);
+        checkConversion(format, picoFb, screenPaletteMap, paletteColors, 4, 1, 9, 126, 40);
+    }
+}
+
+TEST_CASE("frame converter skips clean rows") {
+    uint8_t picoFb[128 * 64];
+    memset(picoFb, 0x11, sizeof(picoFb));
+
+    Color paletteColors[144];
+    for (int i = 0; i < 144; i++) {
+        paletteColors[i] = testColor(i);
+    }
+    uint8_t screenPaletteMap[16];
+    for (int i = 0; i < 16; i++) {
+        screenPaletteMap[i] = (uint8_t)i;
+    }
+
+    FrameConverter converter(FRAME_FORMAT_RGB565);
+    uint16_t out[128 * 128];
+    memset(out, 0, sizeof(out));
+
+    ScreenDirtyState_t dirty;
+    resetScreenDirtyState(&dirty);
+    dirty.rows[0] = 1u << 7;
+
+    converter.convert(picoFb, screenPaletteMap, nullptr, paletteColors, out, 128 * 2, 1, &dirty);
+
+    CHECK_EQ(out[7 * 128], referencePixel(FRAME_FORMAT_RGB565, paletteColors[1]));
+    CHECK_EQ(out[6 * 128], 0);
+    CHECK_EQ(out[8 * 128], 0);
+}
+
+TEST_CASE("frame converter uses the secondary palette on marked lines") {
+    uint8_t picoFb[128 * 64];
+    memset(picoFb, 0x22, sizeof(picoFb));
+
+    Color paletteColors[144];
+    for (int i = 0; i < 144; i++) {
+        paletteColors[i] = testColor(i);
+    }
+    uint8_t screenPaletteMap[16];
+    for (int i = 0; i < 16; i++) {
+        screenPaletteMap[i] = (uint8_t)i;
+    }
+
+    AltScreenPalette_t alt;
+    memset(&alt, 0, sizeof(alt));
+    alt.enabled = true;
+    for (int i = 0; i < 16; i++) {
+        alt.paletteMap[i] = (uint8_t)(15 - i);
+    }
+    alt.paletteMap[2] = 131;
+    //lines 3 and 100
+    alt.lineBitfield[0] = 1 << 3;
+    alt.lineBitfield[12] = 1 << 4;
+
+    FrameConverter converter(FRAME_FORMAT_XRGB8888);
+    uint32_t out[128 * 128];
+
+    SUBCASE("marked lines use the secondary map") {
+        converter.convert(picoFb, screenPaletteMap, &alt, paletteColors, out, 128 * 4);
+
+        uint32_t normal = referencePixel(FRAME_FORMAT_XRGB8888, paletteColors[2]);
+        uint32_t secondary = referencePixel(FRAME_FORMAT_XRGB8888, paletteColors[131]);
+        CHECK_EQ(out[2 * 128], normal);
+        CHECK_EQ(out[3 * 128 + 127], secondary);
+        CHECK_EQ(out[4 * 128], normal);
+        CHECK_EQ(out[100 * 128 + 5], secondary);
+        CHECK_EQ(out[101 * 128], normal);
+    }
+    SUBCASE("disabled secondary palette is ignored") {
+        alt.enabled = false;
+        converter.convert(picoFb, screenPaletteMap, &alt, paletteColors, out, 128 * 4);
+
+        CHECK_EQ(out[3 * 128], referencePixel(FRAME_FORMAT_XRGB8888, paletteColors[2]));
+    }
+}
@@ -1,14 +1,45 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include <string.h>
 
 #include "doctest.h"
 #include "../source/graphics.h"
 #include "../source/fontdata.h"
 #include "../source/PicoRam.h"
+#include "../source/nibblehelpers.h"
 
 #include "testHelpers.h"
 
+//draws a sprite one pixel at a time, the way pico 8 describes spr/sspr,
+//to check the blitter against
+static void referenceSpr(PicoRam* ram, int sx, int sy, int sw, int sh, int x, int y, bool flip_x, bool flip_y) {
+    auto &drawState = ram->drawState;
+    uint8_t writeMask = ram->hwState.colorBitmask & 15;
+    uint8_t readMask = ram->hwState.colorBitmask >> 4;
+
+    for (int j = 0; j < sh; j++) {
+        for (int i = 0; i < sw; i++) {
+            int dx = x - drawState.camera_x + i;
+            int dy = y - drawState.camera_y + j;
+            if (dx < drawState.clip_xb || dx >= drawState.clip_xe || dy < drawState.clip_yb || dy >= drawState.clip_ye) {
+                continue;
+            }
+            int px = flip_x ? sx + sw - 1 - i : sx + i;
+            int py = flip_y ? sy + sh - 1 - j : sy + j;
+            if (px < 0 || px > 127 || py < 0 || py > 127) {
+                continue;
+            }
+            uint8_t mapped = drawState.drawPaletteMap[getPixelNibble(px, py, ram->spriteSheetData)];
+            if (mapped >> 4) {
+                continue;
+            }
+            uint8_t dst = getPixelNibble(dx, dy, ram->screenBuffer);
+            setPixelNibble(dx, dy, (dst & ~writeMask) | (mapped & writeMask & readMask), ram->screenBuffer);
+        }
+    }
+}
+
 TEST_CASE("graphics class behaves as expected") {
     //general setup
     std::string fontdata = get_font_data();
@@ -1015,6 +1046,78 @@ TEST_CASE("graphics class behaves as expected") {
 
         checkPoints(graphics, expectedPoints);
     }
+    SUBCASE("spr(...) and sspr(...) match drawing pixel by pixel") {
+        PicoRam expected;
+        uint32_t seed = 12345;
+        auto next = [&seed](int n) {
+            seed = seed * 1103515245 + 12345;
+            return (int)((seed >> 8) % n);
+        };
+
+        for (int run = 0; run < 400; run++) {
+            for (int i = 0; i < 0x2000; i++) {
+                picoRam.spriteSheetData[i] = next(256);
+                picoRam.screenBuffer[i] = next(256);
+            }
+            graphics->pal();
+            graphics->palt();
+            for (int c = 0; c < 16; c++) {
+                picoRam.drawState.drawPaletteMap[c] = next(16) | (next(4) == 0 ? 0x10 : 0);
+            }
+            picoRam.hwState.colorBitmask = next(3) == 0 ? next(256) : 0xff;
+            graphics->clip(next(40), next(40), next(140), next(140));
+            graphics->camera(next(64) - 32, next(64) - 32);
+
+            int sx, sy, sw, sh;
+            int x = next(180) - 40;
+            int y = next(180) - 40;
+            bool flip_x = false;
+            bool flip_y = next(2);
+            expected = picoRam;
+            if (next(2)) {
+                int n = next(256);
+                int w = next(3) + 1;
+                int h = next(3) + 1;
+                flip_x = next(2);
+                sx = (n % 16) * 8;
+                sy = (n / 16) * 8;
+                sw = w * 8;
+                sh = h * 8;
+                graphics->spr(n, x, y, w, h, flip_x, flip_y);
+            }
+            else {
+                sx = next(160) - 16;
+                sy = next(160) - 16;
+                sw = next(40);
+                sh = next(40);
+                flip_x = next(2);
+                graphics->sspr(sx, sy, sw, sh, x, y, sw, sh, flip_x, flip_y);
+            }
+            referenceSpr(&expected, sx, sy, sw, sh, x, y, flip_x, flip_y);
+
+            bool same = memcmp(expected.screenBuffer, picoRam.screenBuffer, sizeof(picoRam.screenBuffer)) == 0;
+            CHECK(same);
+            if (!same) {
+                break;
+            }
+        }
+
+        graphics->pal();
+        graphics->palt();
+        graphics->clip();
+        graphics->camera();
+        picoRam.hwState.colorBitmask = 0xff;
+    }
+    SUBCASE("spr(...) picks up pal changes made by poking ram") {
+        graphics->cls();
+        graphics->sset(0, 0, 3);
+        graphics->spr(0, 10, 10, 1.0, 1.0, false, false);
+        picoRam.drawState.drawPaletteMap[3] = 9;
+        graphics->spr(0, 20, 10, 1.0, 1.0, false, false);
+
+        CHECK_EQ(graphics->pget(10, 10), 3);
+        CHECK_EQ(graphics->pget(20, 10), 9);
+    }
     /*//TODO: come back and make SSPR stretch exactly how pico 8 does
     SUBCASE("sspr(...) draws unevenly stretched sprite") {
         graphics->cls();
@@ -1629,6 +1732,74 @@ TEST_CASE("graphics class behaves as expected") {
 
         CHECK_EQ(251, result);
     }
+    SUBCASE("map(...) matches drawing each cell with spr"){
+        PicoRam expected;
+        uint32_t seed = 777;
+        auto next = [&seed](int n) {
+            seed = seed * 1103515245 + 12345;
+            return (int)((seed >> 8) % n);
+        };
+
+        for (int run = 0; run < 300; run++) {
+            picoRam.Reset();
+            for (int i = 0; i < 0x1000; i++) {
+                picoRam.spriteSheetData[i] = next(256);
+                picoRam.mapData[i] = next(4) == 0 ? 0 : next(256);
+                picoRam.screenBuffer[i * 2] = next(256);
+            }
+            for (int i = 0; i < 256; i++) {
+                picoRam.spriteFlags[i] = next(256);
+            }
+            for (int i = 0; i < 0x8000; i++) {
+                picoRam.userData[i] = next(256);
+            }
+            if (next(4) == 0) {
+                picoRam.hwState.mapMemMapping = 0x80 + next(0x80);
+            }
+            if (next(4) == 0) {
+                picoRam.hwState.widthOfTheMap = next(256);
+            }
+            graphics->pal();
+            graphics->palt();
+            for (int c = 0; c < 16; c++) {
+                picoRam.drawState.drawPaletteMap[c] = next(16) | (next(4) == 0 ? 0x10 : 0);
+            }
+            picoRam.hwState.colorBitmask = next(3) == 0 ? next(256) : 0xff;
+            graphics->clip(next(40), next(40), next(140), next(140));
+            graphics->camera(next(64) - 32, next(64) - 32);
+
+            int celx = next(300) - 20;
+            int cely = next(300) - 20;
+            int sx = next(200) - 60;
+            int sy = next(200) - 60;
+            int celw = next(24);
+            int celh = next(24);
+            uint8_t layer = next(2) ? 0 : next(256);
+
+            expected = picoRam;
+            for (int y = 0; y < celh; y++) {
+                for (int x = 0; x < celw; x++) {
+                    uint8_t cell = graphics->mget(celx + x, cely + y);
+                    if (cell && (layer == 0 || (picoRam.spriteFlags[cell] & layer))) {
+                        referenceSpr(&expected, (cell % 16) * 8, (cell / 16) * 8, 8, 8, sx + x * 8, sy + y * 8, false, false);
+                    }
+                }
+            }
+            graphics->map(celx, cely, sx, sy, celw, celh, layer);
+
+            bool same = memcmp(expected.screenBuffer, picoRam.screenBuffer, sizeof(picoRam.screenBuffer)) == 0;
+            CHECK(same);
+            if (!same) {
+                break;
+            }
+        }
+
+        picoRam.Reset();
+        graphics->pal();
+        graphics->palt();
+        graphics->clip();
+        graphics->camera();
+    }
     SUBCASE("map with no layer argument draws map cell sprite"){
         for(int i = 0; i < 128; i++) {
             for (int j = 0; j < 32; j++)
@@ -2002,6 +2173,69 @@ TEST_CASE("graphics class behaves as expected") {
 
         checkPoints(graphics, expectedPoints);
     }
+    SUBCASE("fill pattern rectfill matches drawing pixel by pixel"){
+        PicoRam expected;
+        expected.Reset();
+        Graphics expectedGraphics(fontdata, &expected);
+        uint32_t seed = 4242;
+        auto next = [&seed](int n) {
+            seed = seed * 1103515245 + 12345;
+            return (int)((seed >> 8) % n);
+        };
+
+        for (int run = 0; run < 300; run++) {
+            for (int i = 0; i < 0x2000; i++) {
+                picoRam.screenBuffer[i] = next(256);
+            }
+            graphics->pal();
+            for (int c = 0; c < 16; c++) {
+                picoRam.drawState.drawPaletteMap[c] = next(16);
+            }
+            picoRam.drawState.fillPattern[0] = next(256);
+            picoRam.drawState.fillPattern[1] = next(256);
+            picoRam.drawState.fillPatternTransparencyBit = next(2);
+            picoRam.hwState.colorBitmask = next(2) ? next(256) : 0xff;
+            graphics->clip(next(40), next(40), next(140), next(140));
+            graphics->camera(next(64) - 32, next(64) - 32);
+
+            int x1 = next(180) - 40;
+            int y1 = next(180) - 40;
+            int x2 = next(180) - 40;
+            int y2 = next(180) - 40;
+            uint8_t col = next(256);
+
+            expected = picoRam;
+            expected.drawState.camera_x = 0;
+            expected.drawState.camera_y = 0;
+            auto &clip = picoRam.drawState;
+            int cx1 = std::min(x1, x2) - clip.camera_x;
+            int cx2 = std::max(x1, x2) - clip.camera_x;
+            int cy1 = std::min(y1, y2) - clip.camera_y;
+            int cy2 = std::max(y1, y2) - clip.camera_y;
+            if (!(cx2 < clip.clip_xb || cx1 >= clip.clip_xe)) {
+                int minx = std::max(std::min(cx1, clip.clip_xe - 1), (int)clip.clip_xb);
+                int maxx = std::max(std::min(cx2, clip.clip_xe - 1), (int)clip.clip_xb);
+                for (int y = cy1; y <= cy2; y++) {
+                    for (int x = minx; x <= maxx; x++) {
+                        expectedGraphics.pset(x, y, col);
+                    }
+                }
+            }
+            graphics->rectfill(x1, y1, x2, y2, col);
+
+            bool same = memcmp(expected.screenBuffer, picoRam.screenBuffer, sizeof(picoRam.screenBuffer)) == 0;
+            CHECK(same);
+            if (!same) {
+                break;
+            }
+        }
+
+        graphics->pal();
+        graphics->clip();
+        graphics->camera();
+        graphics->fillp(0);
+        picoRam.hwState.colorBitmask = 0xff;
+    }
     SUBCASE("fill pattern oriented correctly"){
         //311 = 0b0000000100110111
         //0000
@@ -2426,6 +2660,220 @@ TEST_CASE("graphics class behaves as expected") {
         checkPoints(graphics, expectedPoints);
     }
 
+    SUBCASE("pset() marks only its row dirty") {
+        graphics->clearScreenDirtyState();
+        graphics->pset(10, 37, 8);
+
+        ScreenDirtyState_t* dirty = graphics->GetScreenDirtyState();
+        CHECK(isScreenRowDirty(dirty, 37) == true);
+        CHECK(isScreenRowDirty(dirty, 36) == false);
+        CHECK(isScreenRowDirty(dirty, 38) == false);
+        CHECK(dirty->paletteChanged == false);
+    }
+    SUBCASE("clipped draws don't mark rows dirty") {
+        graphics->clearScreenDirtyState();
+        graphics->pset(10, 200, 8);
+        graphics->rectfill(-20, -20, -5, -5, 8);
+        //on screen, but the source is past the sprite sheet
+        graphics->sspr(200, 0, 8, 8, 10, 10, 8, 8, false, false);
+
+        CHECK(isScreenDirty(graphics->GetScreenDirtyState()) == false);
+    }
+    SUBCASE("rectfill() marks its row span dirty") {
+        graphics->clearScreenDirtyState();
+        graphics->rectfill(0, 64, 127, 95, 3);
+
+        ScreenDirtyState_t* dirty = graphics->GetScreenDirtyState();
+        CHECK(isScreenRowDirty(dirty, 63) == false);
+        CHECK(isScreenRowDirty(dirty, 64) == true);
+        CHECK(isScreenRowDirty(dirty, 95) == true);
+        CHECK(isScreenRowDirty(dirty, 96) == false);
+    }
+    SUBCASE("screen pal() marks every row dirty") {
+        graphics->clearScreenDirtyState();
+        graphics->pal(1, 2, 1);
+
+        ScreenDirtyState_t* dirty = graphics->GetScreenDirtyState();
+        CHECK(dirty->paletteChanged == true);
+        CHECK(isScreenRowDirty(dirty, 0) == true);
+        CHECK(isScreenRowDirty(dirty, 127) == true);
+    }
+    SUBCASE("writes to screen memory mark the rows they cover") {
+        graphics->clearScreenDirtyState();
+        graphics->markMemoryDirty(0x6000 + 64 * 20, 64 * 2);
+
+        ScreenDirtyState_t* dirty = graphics->GetScreenDirtyState();
+        CHECK(isScreenRowDirty(dirty, 19) == false);
+        CHECK(isScreenRowDirty(dirty, 20) == true);
+        CHECK(isScreenRowDirty(dirty, 21) == true);
+        CHECK(isScreenRowDirty(dirty, 22) == false);
+    }
+    SUBCASE("writes to sprite memory don't dirty the screen") {
+        graphics->clearScreenDirtyState();
+        graphics->markMemoryDirty(0x0000, 0x2000);
+
+        CHECK(isScreenDirty(graphics->GetScreenDirtyState()) == false);
+    }
+
+    SUBCASE("presented buffer is the frame buffer in the default draw mode") {
+        CHECK_EQ(graphics->GetPresentedFrameBuffer(), graphics->GetP8FrameBuffer());
+    }
+    SUBCASE("presented buffer stretches in draw modes 1-3") {
+        graphics->pset(1, 2, 5);
+
+        picoRam.drawState.drawMode = 1;
+        uint8_t* presented = graphics->GetPresentedFrameBuffer();
+        CHECK_EQ(getPixelNibble(2, 2, presented), 5);
+        CHECK_EQ(getPixelNibble(3, 2, presented), 5);
+        CHECK_EQ(getPixelNibble(1, 2, presented), 0);
+
+        picoRam.drawState.drawMode = 2;
+        presented = graphics->GetPresentedFrameBuffer();
+        CHECK_EQ(getPixelNibble(1, 4, presented), 5);
+        CHECK_EQ(getPixelNibble(1, 5, presented), 5);
+        CHECK_EQ(getPixelNibble(1, 2, presented), 0);
+
+        picoRam.drawState.drawMode = 3;
+        presented = graphics->GetPresentedFrameBuffer();
+        CHECK_EQ(getPixelNibble(3, 5, presented), 5);
+    }
+    SUBCASE("presented buffer mirrors in draw modes 5-7") {
+        graphics->pset(1, 2, 5);
+
+        picoRam.drawState.drawMode = 5;
+        uint8_t* presented = graphics->GetPresentedFrameBuffer();
+        CHECK_EQ(getPixelNibble(1, 2, presented), 5);
+        CHECK_EQ(getPixelNibble(126, 2, presented), 5);
+
+        picoRam.drawState.drawMode = 6;
+        presented = graphics->GetPresentedFrameBuffer();
+        CHECK_EQ(getPixelNibble(1, 2, presented), 5);
+        CHECK_EQ(getPixelNibble(1, 125, presented), 5);
+
+        picoRam.drawState.drawMode = 7;
+        presented = graphics->GetPresentedFrameBuffer();
+        CHECK_EQ(getPixelNibble(126, 125, presented), 5);
+    }
+    SUBCASE("presented buffer flips in draw modes 129-131") {
+        graphics->pset(1, 2, 5);
+
+        picoRam.drawState.drawMode = 129;
+        CHECK_EQ(getPixelNibble(126, 2, graphics->GetPresentedFrameBuffer()), 5);
+
+        picoRam.drawState.drawMode = 130;
+        CHECK_EQ(getPixelNibble(1, 125, graphics->GetPresentedFrameBuffer()), 5);
+
+        picoRam.drawState.drawMode = 131;
+        CHECK_EQ(getPixelNibble(126, 125, graphics->GetPresentedFrameBuffer()), 5);
+    }
+    SUBCASE("presented buffer rotates in draw modes 133-135") {
+        graphics->pset(1, 2, 5);
+        graphics->pset(2, 2, 6);
+
+        picoRam.drawState.drawMode = 133;
+        uint8_t* presented = graphics->GetPresentedFrameBuffer();
+        CHECK_EQ(getPixelNibble(125, 1, presented), 5);
+        CHECK_EQ(getPixelNibble(125, 2, presented), 6);
+
+        picoRam.drawState.drawMode = 134;
+        CHECK_EQ(getPixelNibble(126, 125, graphics->GetPresentedFrameBuffer()), 5);
+
+        picoRam.drawState.drawMode = 135;
+        presented = graphics->GetPresentedFrameBuffer();
+        CHECK_EQ(getPixelNibble(2, 126, presented), 5);
+        CHECK_EQ(getPixelNibble(2, 125, presented), 6);
+    }
+
+    SUBCASE("presenting snapshots the secondary palette when 0x5f5f bit 4 is set") {
+        picoRam.hwState.alternatePaletteFlag = 0x10;
+        picoRam.hwState.alternatePaletteMap[1] = 0x83;
+        picoRam.hwState.alternatePaletteMap[2] = 0x7f;
+        picoRam.hwState.alternatePaletteScreenLineBitfield[1] = 0x01;
+
+        graphics->GetPresentedFrameBuffer();
+        AltScreenPalette_t* alt = graphics->GetAltScreenPalette();
+
+        CHECK(alt->enabled == true);
+        CHECK_EQ(alt->paletteMap[1], 0x83);
+        //only the regular and secret color ranges are kept
+        CHECK_EQ(alt->paletteMap[2], 0x0f);
+        CHECK(isAltPaletteLine(alt, 8) == true);
+        CHECK(isAltPaletteLine(alt, 9) == false);
+    }
+    SUBCASE("secondary palette is off by default") {
+        graphics->GetPresentedFrameBuffer();
+
+        CHECK(graphics->GetAltScreenPalette()->enabled == false);
+    }
+    SUBCASE("primitives far outside the clip rect draw nothing") {
+        graphics->cls();
+        graphics->clearScreenDirtyState();
+
+        graphics->rectfill(128, 0, 10000, 127, 8);
+        graphics->rectfill(0, -10000, 127, -1, 8);
+        graphics->rect(-32000, 128, 32000, 20000, 8);
+        graphics->line(-32000, -5, 32000, -5, 8);
+        graphics->line(128, 0, 128, 127, 8);
+        graphics->circ(-20000, 64, 10000, 8);
+        graphics->circfill(64, 30000, 20000, 8);
+        graphics->oval(200, 200, 30000, 30000, 8);
+        graphics->ovalfill(-30000, -30000, -1, 64, 8);
+        graphics->tline(200, 50, 300, 50, 0, 0);
+
+        graphics->camera(30000, 30000);
+        graphics->circfill(64, 64, 4, 8);
+        graphics->camera(0, 0);
+
+        CHECK(isScreenDirty(graphics->GetScreenDirtyState()) == false);
+        for (int i = 0; i < 0x2000; i++) {
+            CHECK_EQ(picoRam.screenBuffer[i], 0);
+        }
+    }
+    SUBCASE("primitives draw nothing with an empty clip rect") {
+        graphics->cls();
+        graphics->clearScreenDirtyState();
+
+        graphics->clip(130, 0, 10, 10);
+        graphics->rectfill(0, 2, 200, 2, 7);
+        graphics->line(0, 4, 200, 4, 8);
+        graphics->circfill(64, 6, 100, 9);
+        graphics->clip(0, 130, 10, 10);
+        graphics->rectfill(0, 0, 127, 127, 7);
+        graphics->line(2, 0, 2, 200, 8);
+        graphics->clip(0, 0, 128, 128);
+
+        CHECK(isScreenDirty(graphics->GetScreenDirtyState()) == false);
+        for (int i = 0; i < 0x2000; i++) {
+            CHECK_EQ(picoRam.screenBuffer[i], 0);
+        }
+    }
+    SUBCASE("huge rectfill fills only the clip rect") {
+        graphics->cls();
+        graphics->clip(10, 20, 30, 40);
+        graphics->rectfill(-10000, -10000, 10000, 10000, 5);
+        graphics->clip(0, 0, 128, 128);
+
+        for (int y = 0; y < 128; y++) {
+            for (int x = 0; x < 128; x++) {
+                bool inside = x >= 10 && x < 40 && y >= 20 && y < 60;
+                CHECK_EQ(graphics->pget(x, y), inside ? 5 : 0);
+            }
+        }
+    }
+    SUBCASE("circfill with camera offset matches drawing at the origin") {
+        graphics->cls();
+        graphics->circfill(64, 64, 20, 3);
+        uint8_t expected[0x2000];
+        memcpy(expected, picoRam.screenBuffer, sizeof(expected));
+
+        graphics->cls();
+        graphics->camera(30000, -30000);
+        graphics->circfill(30064, -29936, 20, 3);
+        graphics->camera(0, 0);
+
+        CHECK(memcmp(expected, picoRam.screenBuffer, sizeof(expected)) == 0);
+    }
+
     //general teardown
     delete graphics;
 }
\ No newline at end of file
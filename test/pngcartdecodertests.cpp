@@ -0,0 +1,64 @@
+#include <vector>
+
+#include "doctest.h"
+#include "lodepng.h"
+#include "../source/pngCartDecoder.h"
+#include "../source/filehelpers.h"
+
+static std::vector<uint8_t> extractWithLodepng(const std::vector<char>& png) {
+    std::vector<unsigned char> image;
+    unsigned width, height;
+    lodepng::decode(image, width, height, reinterpret_cast<const unsigned char*>(png.data()), png.size());
+
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < image.size(); i += 4) {
+        data.push_back((image[i + 3] & 3) << 6 | (image[i] & 3) << 4 | (image[i + 1] & 3) << 2 | (image[i + 2] & 3));
+    }
+    return data;
+}
+
+TEST_CASE("png cart decoding") {
+    SUBCASE("extractPngCartBytes packs the low bits as argb") {
+        std::vector<uint8_t> pixels;
+        for (int i = 0; i < 256; i++) {
+            //r g b a, with the high bits set to make sure they are ignored
+            pixels.push_back(0xfc | ((i >> 4) & 3));
+            pixels.push_back(0xa8 | ((i >> 2) & 3));
+            pixels.push_back(0x54 | (i & 3));
+            pixels.push_back(0xfc | ((i >> 6) & 3));
+        }
+        uint8_t out[256];
+        extractPngCartBytes(pixels.data(), 256, out);
+
+        bool allMatch = true;
+        for (int i = 0; i < 256; i++) {
+            allMatch = allMatch && out[i] == i;
+        }
+        CHECK(allMatch);
+    }
+    SUBCASE("streaming decode matches lodepng") {
+        const char* carts[] = {"carts/cartparsetest.p8.png", "carts/test_legacypng_cart.p8.png"};
+        for (const char* cart : carts) {
+            auto png = get_file_as_buffer(cart);
+            std::vector<uint8_t> data(PNG_CART_DATA_SIZE);
+
+            CHECK(decodePngCartData(reinterpret_cast<const unsigned char*>(png.data()), png.size(), data.data()));
+            CHECK(data == extractWithLodepng(png));
+        }
+    }
+    SUBCASE("corrupt data is rejected") {
+        auto png = get_file_as_buffer("carts/cartparsetest.p8.png");
+        png[png.size() / 2] ^= 0x55;
+        std::vector<uint8_t> data(PNG_CART_DATA_SIZE);
+
+        CHECK_FALSE(decodePngCartData(reinterpret_cast<const unsigned char*>(png.data()), png.size(), data.data()));
+    }
+    SUBCASE("other png formats are left to lodepng") {
+        std::vector<unsigned char> rgb(PNG_CART_WIDTH * PNG_CART_HEIGHT * 3, 0x01);
+        std::vector<unsigned char> png;
+        lodepng::encode(png, rgb, PNG_CART_WIDTH, PNG_CART_HEIGHT, LCT_RGB);
+        std::vector<uint8_t> data(PNG_CART_DATA_SIZE);
+
+        CHECK_FALSE(decodePngCartData(png.data(), png.size(), data.data()));
+    }
+}
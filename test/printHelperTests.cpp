@@ -9,6 +9,7 @@
 #include "../source/printHelper.h"
 #include "../source/Audio.h"
 #include "../source/graphics.h"
+#include "../source/nibblehelpers.h"
 #include "stubhost.h"
 
 #include "../source/fontdata.h"
@@ -77,6 +78,20 @@ TEST_CASE("Print helper functions") {
 
         CHECK(memory->drawState.text_y == 116);
     }
+    SUBCASE("print({str}) at the bottom scrolls the screen mapped by 0x5f55") {
+        graphics->cls();
+        memory->hwState.screenDataMemMapping = 0;
+        memory->spriteSheetData[COMBINED_IDX(0, 20)] = 0x11;
+        memory->drawState.text_x = 0;
+        memory->drawState.text_y = 127;
+        graphics->clearScreenDirtyState();
+
+        print("t");
+
+        //6 rows up before drawing, 5 more after
+        CHECK(memory->spriteSheetData[COMBINED_IDX(0, 9)] == 0x11);
+        CHECK(isScreenRowDirty(graphics->GetScreenDirtyState(), 0) == true);
+    }
     SUBCASE("print({str}, {x}, {y}) updates text location ") {
         graphics->cls();
         memory->drawState.text_x = 3;
@@ -18,6 +18,8 @@ static uint8_t stubCurrKDown;
 static uint8_t stubCurrKHeld;
 static bool stubCurrKBdown = false;
 static std::string stubCurrKBkey = "";
+static int stubQuitFrame = 0;
+static int stubFramesDrawn = 0;
 
 
 
@@ -50,12 +52,21 @@ void StubHost::stubInput(uint8_t kdown, uint8_t kheld) {
     stubCurrKHeld = kheld;
 }
 
+void StubHost::stubQuitAfterFrames(int frameCount) {
+    stubQuitFrame = frameCount;
+    stubFramesDrawn = 0;
+}
+
+int StubHost::stubDrawnFrames() {
+    return stubFramesDrawn;
+}
+
 InputState_t Host::scanInput(){
     return InputState_t {stubCurrKDown, stubCurrKHeld, 0, 0, 0, stubCurrKBdown, stubCurrKBkey};
 }
 
 bool Host::shouldQuit() {
-    return false;
+    return stubQuitFrame > 0 && stubFramesDrawn >= stubQuitFrame;
 }
 
 void Host::waitForTargetFps(){
@@ -64,7 +75,7 @@ void Host::waitForTargetFps(){
 
 
 void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t screenMode){
-    
+    stubFramesDrawn++;
 }
 
 bool Host::shouldFillAudioBuff(){
@@ -131,6 +142,10 @@ std::string Host::getCartDirectory() {
     return "carts";
 }
 
+std::string Host::getCartCacheDirectory() {
+    return "";
+}
+
 
 void Host::setUpPaletteColors(){
     _paletteColors[0] = COLOR_00;
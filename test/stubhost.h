@@ -6,4 +6,8 @@ class StubHost : public Host {
     public:
     StubHost();      
     void stubInput(uint8_t kdown, uint8_t kheld);
+    //makes shouldQuit() return true once drawFrame has been called frameCount times.
+    //0 (the default) never quits. lets the bench runner stop carts that loop on flip()
+    void stubQuitAfterFrames(int frameCount);
+    int stubDrawnFrames();
 };
\ No newline at end of file
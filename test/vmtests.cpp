@@ -401,6 +401,19 @@ TEST_CASE("Vm memory functions") {
         CHECK_EQ(graphics->fget(0), 0);
         CHECK_EQ(graphics->mget(0, 0), 1);
     }
+    SUBCASE("reload from another cart is served from the rom cache") {
+        vm->LoadCart("cartparsetest.p8.png");
+        vm->vm_memset(0, 0, 0x4300);
+
+        vm->vm_reload(0, 0, 0x4300, "cartparsetest.p8.png");
+        vm->vm_memset(0, 0, 0x4300);
+        vm->vm_reload(0, 0, 0x4300, "cartparsetest.p8.png");
+
+        CHECK_EQ(vm->getCartRomCache()->getEntryCount(), 1);
+        CHECK_EQ(vm->getCartRomCache()->getHits(), 1);
+        CHECK_EQ(graphics->sget(0, 0), 15);
+        CHECK_EQ(graphics->mget(0, 0), 1);
+    }
     SUBCASE("memset sets memory") {
         vm->vm_memset(0x3000, 13, 4);
 
@@ -725,3 +738,231 @@ TEST_CASE("Vm memory functions") {
 
     delete memory;
 }
+
+TEST_CASE("Vm cpu usage") {
+    StubHost* stubHost = new StubHost();
+    Vm* vm = new Vm(stubHost);
+
+    SUBCASE("cycle estimate is deterministic between identical frames"){
+        vm->setCpuCycleEstimate(true);
+        vm->LoadCart("cpuusagetest.p8", false);
+
+        vm->UpdateAndDraw();
+        float firstFrame = vm->getPrevFrameCpuUsage();
+        vm->UpdateAndDraw();
+        float secondFrame = vm->getPrevFrameCpuUsage();
+
+        CHECK(firstFrame > 0);
+        CHECK_EQ(firstFrame, secondFrame);
+    }
+    SUBCASE("stat(1) reports usage to the cart"){
+        vm->setCpuCycleEstimate(true);
+        vm->LoadCart("cpuusagetest.p8", false);
+
+        vm->UpdateAndDraw();
+
+        bool cpuReported = vm->ExecuteLua(
+            "function cpuTest()\n"
+            " return cpu > 0 and cpu < 1\n"
+            "end\n",
+            "cpuTest");
+
+        CHECK(cpuReported);
+    }
+    SUBCASE("each vm counts only its own lua instructions"){
+        vm->setCpuCycleEstimate(true);
+        vm->LoadCart("cpuusagetest.p8", false);
+
+        vm->UpdateAndDraw();
+        float usage = vm->getCpuUsage();
+
+        StubHost* otherHost = new StubHost();
+        Vm* other = new Vm(otherHost);
+        other->setCpuCycleEstimate(true);
+        other->LoadCart("cpuusagetest.p8", false);
+
+        CHECK_EQ(usage, vm->getCpuUsage());
+
+        other->CloseCart();
+        delete other;
+        delete otherHost;
+    }
+    SUBCASE("wall time mode reports a non negative usage"){
+        vm->LoadCart("cpuusagetest.p8", false);
+
+        vm->UpdateAndDraw();
+
+        CHECK(vm->getPrevFrameCpuUsage() >= 0);
+    }
+
+    vm->CloseCart();
+
+    delete vm;
+    delete stubHost;
+}
+
+TEST_CASE("Vm lua memory usage") {
+    StubHost* stubHost = new StubHost();
+    Vm* vm = new Vm(stubHost);
+
+    SUBCASE("loaded cart reports lua memory in use"){
+        vm->LoadCart("cartparsetest.p8", false);
+
+        CHECK(vm->getLuaMemoryUsage() > 0);
+        CHECK(vm->getLuaMemoryUsage() < PICO_LUA_MEMORY_LIMIT);
+    }
+    SUBCASE("closing cart releases all lua memory"){
+        vm->LoadCart("cartparsetest.p8", false);
+        vm->CloseCart();
+
+        CHECK_EQ(0, vm->getLuaMemoryUsage());
+    }
+    SUBCASE("closing cart resets the lua arena"){
+        vm->LoadCart("cartparsetest.p8", false);
+        size_t resetsBefore = vm->getLuaAllocatorStats().resets;
+        vm->CloseCart();
+
+        CHECK_EQ(resetsBefore + 1, vm->getLuaAllocatorStats().resets);
+        CHECK_EQ(0, vm->getLuaAllocatorStats().largeBlockCount);
+    }
+    SUBCASE("reloading a cart reuses arena chunks"){
+        vm->LoadCart("cartparsetest.p8", false);
+        vm->CloseCart();
+        size_t chunksAfterFirstLoad = vm->getLuaAllocatorStats().chunkCount;
+
+        vm->LoadCart("cartparsetest.p8", false);
+        vm->CloseCart();
+
+        CHECK(chunksAfterFirstLoad > 0);
+        CHECK_EQ(chunksAfterFirstLoad, vm->getLuaAllocatorStats().chunkCount);
+    }
+    SUBCASE("stat(0) reports usage in KiB"){
+        vm->LoadCart("cartparsetest.p8", false);
+
+        bool kibReported = vm->ExecuteLua(
+            "function memTest()\n"
+            " return stat(0) > 1 and stat(0) < 2048\n"
+            "end\n",
+            "memTest");
+
+        CHECK(kibReported);
+    }
+    SUBCASE("exceeding the memory limit errors out of the cart"){
+        vm->setLuaMemoryLimit(1024 * 1024);
+        vm->LoadCart("memhogtest.p8", false);
+
+        for (int i = 0; i < 20 && vm->GetBiosError() == ""; i++) {
+            vm->UpdateAndDraw();
+        }
+
+        CHECK(vm->GetBiosError() != "");
+        CHECK(vm->getLuaMemoryUsage() <= 1024 * 1024);
+    }
+
+    vm->CloseCart();
+
+    delete vm;
+    delete stubHost;
+}
+
+TEST_CASE("Vm table helpers") {
+    StubHost* stubHost = new StubHost();
+    Vm* vm = new Vm(stubHost);
+    vm->LoadCart("cartparsetest.p8", false);
+
+    SUBCASE("add appends and inserts"){
+        bool result = vm->ExecuteLua(
+            "function addTest()\n"
+            " local t={1,2}\n"
+            " local r=add(t,3)\n"
+            " add(t,0,1)\n"
+            " add(t,9,99)\n"
+            " return r==3 and #t==5 and t[1]==0 and t[4]==3 and t[5]==9 and add(nil,1)==nil\n"
+            "end\n",
+            "addTest");
+
+        CHECK(result);
+    }
+    SUBCASE("del removes the first match and shifts down"){
+        bool result = vm->ExecuteLua(
+            "function delTest()\n"
+            " local t={1,2,3,2}\n"
+            " local r=del(t,2)\n"
+            " local missing=del(t,7)\n"
+            " return r==2 and missing==nil and #t==3 and t[2]==3 and t[3]==2\n"
+            "end\n",
+            "delTest");
+
+        CHECK(result);
+    }
+    SUBCASE("deli removes by index, defaulting to the last"){
+        bool result = vm->ExecuteLua(
+            "function deliTest()\n"
+            " local t={1,2,3,4}\n"
+            " local a=deli(t,1)\n"
+            " local b=deli(t)\n"
+            " return a==1 and b==4 and #t==2 and t[1]==2 and t[2]==3\n"
+            "end\n",
+            "deliTest");
+
+        CHECK(result);
+    }
+    SUBCASE("count skips nils and counts matches"){
+        bool result = vm->ExecuteLua(
+            "function countTest()\n"
+            " local t={1,2,2,3}\n"
+            " t[2]=nil\n"
+            " return count(t)==3 and count(t,2)==1 and count({})==0\n"
+            "end\n",
+            "countTest");
+
+        CHECK(result);
+    }
+    SUBCASE("all keeps going after deleting the current value"){
+        bool result = vm->ExecuteLua(
+            "function allDelTest()\n"
+            " local t={1,2,3,4,5}\n"
+            " local seen={}\n"
+            " for v in all(t) do\n"
+            "  add(seen,v)\n"
+            "  if (v==2 or v==3) del(t,v)\n"
+            " end\n"
+            " for v in all(nil) do return false end\n"
+            " return #seen==5 and seen[3]==3 and seen[4]==4 and #t==3\n"
+            "end\n",
+            "allDelTest");
+
+        CHECK(result);
+    }
+    SUBCASE("foreach visits values added during the loop"){
+        bool result = vm->ExecuteLua(
+            "function foreachTest()\n"
+            " local t={1,2}\n"
+            " local sum=0\n"
+            " foreach(t,function(v) sum+=v if (v==1) add(t,10) end)\n"
+            " return sum==13\n"
+            "end\n",
+            "foreachTest");
+
+        CHECK(result);
+    }
+    SUBCASE("foreach callbacks can yield"){
+        bool result = vm->ExecuteLua(
+            "function foreachYieldTest()\n"
+            " local seen=0\n"
+            " local co=cocreate(function() foreach({1,2,3},function(v) seen+=v yield() end) end)\n"
+            " coresume(co)\n"
+            " local first=seen\n"
+            " while (costatus(co)!='dead') coresume(co)\n"
+            " return first==1 and seen==6\n"
+            "end\n",
+            "foreachYieldTest");
+
+        CHECK(result);
+    }
+
+    vm->CloseCart();
+
+    delete vm;
+    delete stubHost;
+}